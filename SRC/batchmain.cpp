@@ -0,0 +1,480 @@
+#include <QtCore/QBuffer>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtGui/QGuiApplication>
+#include <QtGui/QImage>
+#include <QtDataVisualization/q3dcamera.h>
+#include <QtDataVisualization/q3dscene.h>
+
+#include <cstdio>
+
+#include "parametersweep.h"
+#include "scatter.h"
+#include "videostreamwriter.h"
+
+// Wsadowe renderowanie wykresów bez interfejsu użytkownika. Program budowany jest z tych samych plików co
+// aplikacja okienkowa, z batchmain.cpp zamiast main.cpp. Domyślnie używa platformy offscreen i programowego
+// OpenGL, więc działa na serwerach bez karty graficznej; inną platformę można wybrać opcją -platform.
+//
+//   vfv-batch --field sin --segments 40,40,40 --camera 30,20,120 -o sin.png
+//   vfv-batch --job zadania.json --size 1920x1080
+//   vfv-batch --field sin --plane 0,0,1,0 --sweep plane-d=-10:10 --frames 120 -o przekroj.y4m
+//   vfv-batch --field file --data pomiar.vfv --segments 60,60,60 -o pomiar.png
+//
+// Plik zadań to tablica obiektów JSON, których klucze są nazwami opcji (bez "--"); wartości podane w wierszu
+// poleceń są domyślne dla wszystkich zadań. Dla każdego obrazu wypisywany jest wiersz z czasami etapów.
+// Zadanie z opcją --sweep zapisuje animację zmiany jednego parametru do pliku .y4m lub surowego RGB24 (.rgb).
+
+using namespace QtDataVisualization;
+
+using JobOptions = QHash<QString, QString>;
+
+namespace {
+
+struct OptionSpec
+{
+    const char *name;
+    const char *description;
+    const char *valueName;
+    const char *defaultValue;
+};
+
+// opcje pojedynczego zadania, które można podać zarówno w wierszu poleceń, jak i w pliku zadań
+const OptionSpec jobOptionSpecs[] = {
+    {"output", "Plik PNG, do którego zapisywany jest wykres, a dla animacji plik .y4m lub .rgb.", "plik", ""},
+    {"field", "Pole: linear, product, sin, tan, custom lub file.", "pole", "linear"},
+    {"p", "Składowa x pola custom.", "wyrażenie", "a*x"},
+    {"q", "Składowa y pola custom.", "wyrażenie", "b*y"},
+    {"r", "Składowa z pola custom.", "wyrażenie", "c*z"},
+    {"data", "Plik pola wektorowego (.vfv) dla pola file.", "plik", ""},
+    {"x", "Przedział osi x, puste - -10:10, a dla pola file - obszar danych.", "min:max", ""},
+    {"y", "Przedział osi y, puste - -10:10, a dla pola file - obszar danych.", "min:max", ""},
+    {"z", "Przedział osi z, puste - -10:10, a dla pola file - obszar danych.", "min:max", ""},
+    {"segments", "Liczba podprzedziałów osi x, y, z.", "nx,ny,nz", "10,10,10"},
+    {"a", "Stała a.", "liczba", "1"},
+    {"b", "Stała b.", "liczba", "1"},
+    {"c", "Stała c.", "liczba", "1"},
+    {"plane", "Płaszczyzna odcinająca Ax + By + Cz + D = 0, puste - bez odcinania.", "A,B,C,D", ""},
+    {"camera", "Obrót kamery w poziomie i w pionie (stopnie) oraz przybliżenie (%).", "h,v,zoom", "0,0,100"},
+    {"size", "Rozmiar obrazu w pikselach.", "WxH", "1280x960"},
+    {"msaa", "Liczba próbek wygładzania krawędzi.", "liczba", "8"},
+    {"backend", "Tryb renderowania: 0 - osobne obiekty, 1 - seria punktów, 2 - połączona siatka.", "tryb", "0"},
+    {"length-mode", "Długość strzałek: 0 - względem siatki, 1 - stała, 2 - według arrow-length.", "tryb", "0"},
+    {"arrow-length", "Długość strzałek w trybie 2.", "liczba", "50"},
+    {"theme", "Motyw: 0 - Qt, 1 - Ebony.", "motyw", "0"},
+    {"sweep", "Animacja zmiany parametru: a, b, c, plane-a, plane-b, plane-c, plane-d, arrow-length, x-min, x-max, "
+              "y-min, y-max, z-min, z-max, camera-h, camera-v lub camera-zoom.", "nazwa=od:do", ""},
+    {"frames", "Liczba klatek animacji.", "liczba", "60"},
+    {"fps", "Liczba klatek na sekundę zapisywana w pliku Y4M.", "liczba", "30"},
+};
+
+const char *const fieldNames[] = {"linear", "product", "sin", "tan", "custom", "file"};
+
+bool parseNumbers(const QString &text, const QString &separator, int count, QVector<float> &values) {
+    const QStringList parts = text.split(separator);
+    if (parts.size() != count) {
+        return false;
+    }
+    values.clear();
+    for (const QString &part : parts) {
+        bool ok = false;
+        values.append(part.trimmed().toFloat(&ok));
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// kolejność wywołań omija poprawianie przedziału w setXFirst/setXSecond, gdy nowy przedział
+// leży całkowicie poza poprzednim
+void setAxisRange(Scatter &scatter, void (Scatter::*setFirst)(const QString&),
+                  void (Scatter::*setSecond)(const QString&), float first, float second) {
+    (scatter.*setSecond)(QString::number(second));
+    (scatter.*setFirst)(QString::number(first));
+    (scatter.*setSecond)(QString::number(second));
+}
+
+bool applyJob(Scatter &scatter, Q3DScatter *graph, const JobOptions &job, QString &error) {
+    int field = -1;
+    for (int i = 0; i < 6; i++) {
+        if (job.value("field") == QLatin1String(fieldNames[i])) {
+            field = i;
+        }
+    }
+    if (field < 0) {
+        error = QStringLiteral("nieznane pole %1").arg(job.value("field"));
+        return false;
+    }
+    scatter.functionboxItemChanged(field);
+    if (field == 4) {
+        QString expressionError;
+        auto connection = QObject::connect(&scatter, &Scatter::expressionError,
+                                           [&expressionError](const QString &message) {
+                                               if (!message.isEmpty()) {
+                                                   expressionError = message;
+                                               }
+                                           });
+        scatter.setCustomP(job.value("p"));
+        scatter.setCustomQ(job.value("q"));
+        scatter.setCustomR(job.value("r"));
+        QObject::disconnect(connection);
+        if (!expressionError.isEmpty()) {
+            error = expressionError;
+            return false;
+        }
+    }
+    if (field == 5) {
+        QString fileError;
+        auto connection = QObject::connect(&scatter, &Scatter::fieldFileChanged,
+                                           [&fileError](const QString &message) { fileError = message; });
+        const bool loaded = !job.value("data").isEmpty() && scatter.loadFieldFile(job.value("data"));
+        QObject::disconnect(connection);
+        if (!loaded) {
+            error = job.value("data").isEmpty() ? QStringLiteral("pole file wymaga opcji --data") : fileError;
+            return false;
+        }
+    }
+
+    QVector<float> values;
+    const char *const axes[] = {"x", "y", "z"};
+    void (Scatter::*firstSetters[])(const QString&) = {&Scatter::setXFirst, &Scatter::setYFirst, &Scatter::setZFirst};
+    void (Scatter::*secondSetters[])(const QString&) = {&Scatter::setXSecond, &Scatter::setYSecond,
+                                                         &Scatter::setZSecond};
+    for (int axis = 0; axis < 3; axis++) {
+        QString range = job.value(axes[axis]);
+        if (range.isEmpty()) {
+            // dla pola z pliku loadFieldFile ustawił już przedział na obszar danych
+            if (field == 5) {
+                continue;
+            }
+            range = QStringLiteral("-10:10");
+        }
+        if (!parseNumbers(range, QStringLiteral(":"), 2, values) || values[0] >= values[1]) {
+            error = QStringLiteral("niepoprawny przedział osi %1: %2").arg(axes[axis], range);
+            return false;
+        }
+        setAxisRange(scatter, firstSetters[axis], secondSetters[axis], values[0], values[1]);
+    }
+
+    if (!parseNumbers(job.value("segments"), QStringLiteral(","), 3, values)) {
+        error = QStringLiteral("niepoprawna liczba podprzedziałów: %1").arg(job.value("segments"));
+        return false;
+    }
+    scatter.setXRange(QString::number(static_cast<int>(values[0])));
+    scatter.setYRange(QString::number(static_cast<int>(values[1])));
+    scatter.setZRange(QString::number(static_cast<int>(values[2])));
+
+    scatter.setA(job.value("a"));
+    scatter.setB(job.value("b"));
+    scatter.setC(job.value("c"));
+
+    const QString plane = job.value("plane");
+    scatter.setCutByPlain(!plane.isEmpty());
+    if (!plane.isEmpty()) {
+        if (!parseNumbers(plane, QStringLiteral(","), 4, values)) {
+            error = QStringLiteral("niepoprawna płaszczyzna: %1").arg(plane);
+            return false;
+        }
+        scatter.setPlainA(QString::number(values[0]));
+        scatter.setPlainB(QString::number(values[1]));
+        scatter.setPlainC(QString::number(values[2]));
+        scatter.setPlainD(QString::number(values[3]));
+    }
+
+    scatter.lengthboxItemChanged(job.value("length-mode").toInt());
+    scatter.setArrowsLength(job.value("arrow-length").toInt());
+    scatter.renderBackendChanged(job.value("backend").toInt());
+    scatter.themeboxItemChanged(job.value("theme").toInt());
+
+    if (!parseNumbers(job.value("camera"), QStringLiteral(","), 3, values)) {
+        error = QStringLiteral("niepoprawne ustawienie kamery: %1").arg(job.value("camera"));
+        return false;
+    }
+    graph->scene()->activeCamera()->setCameraPosition(values[0], values[1], values[2]);
+    return true;
+}
+
+const char *const sweepParameters[] = {"a", "b", "c", "plane-a", "plane-b", "plane-c", "plane-d", "arrow-length",
+                                       "x-min", "x-max", "y-min", "y-max", "z-min", "z-max",
+                                       "camera-h", "camera-v", "camera-zoom"};
+
+// ustawia wartość parametru animacji; pozostałe parametry pozostają takie, jak ustawiło je applyJob
+void applySweepValue(Scatter &scatter, Q3DScatter *graph, const JobOptions &job, const QString &name, float value) {
+    QVector<float> values;
+    if (name == QLatin1String("a")) {
+        scatter.setA(QString::number(value));
+    } else if (name == QLatin1String("b")) {
+        scatter.setB(QString::number(value));
+    } else if (name == QLatin1String("c")) {
+        scatter.setC(QString::number(value));
+    } else if (name.startsWith(QLatin1String("plane-"))) {
+        void (Scatter::*setters[])(const QString&) = {&Scatter::setPlainA, &Scatter::setPlainB, &Scatter::setPlainC,
+                                                      &Scatter::setPlainD};
+        (scatter.*setters[name.at(6).unicode() - 'a'])(QString::number(value));
+    } else if (name == QLatin1String("arrow-length")) {
+        scatter.setArrowsLength(qRound(value));
+    } else if (name.startsWith(QLatin1String("camera-"))) {
+        parseNumbers(job.value("camera"), QStringLiteral(","), 3, values);
+        values[name == QLatin1String("camera-h") ? 0 : name == QLatin1String("camera-v") ? 1 : 2] = value;
+        graph->scene()->activeCamera()->setCameraPosition(values[0], values[1], values[2]);
+    } else {
+        // x-min, x-max, y-min, ... - drugi koniec przedziału pozostaje taki, jak ustawiło go applyJob
+        const QString axis = name.left(1);
+        const QValue3DAxis *graphAxis = axis == QLatin1String("x") ? graph->axisX()
+                                        : axis == QLatin1String("y") ? graph->axisY() : graph->axisZ();
+        values = {graphAxis->min(), graphAxis->max()};
+        values[name.endsWith(QLatin1String("min")) ? 0 : 1] = value;
+        void (Scatter::*firstSetter)(const QString&) = axis == QLatin1String("x") ? &Scatter::setXFirst
+                                                      : axis == QLatin1String("y") ? &Scatter::setYFirst
+                                                                                   : &Scatter::setZFirst;
+        void (Scatter::*secondSetter)(const QString&) = axis == QLatin1String("x") ? &Scatter::setXSecond
+                                                       : axis == QLatin1String("y") ? &Scatter::setYSecond
+                                                                                    : &Scatter::setZSecond;
+        setAxisRange(scatter, firstSetter, secondSetter, values[0], values[1]);
+    }
+}
+
+bool runSweepJob(Scatter &scatter, Q3DScatter *graph, const JobOptions &job, const QSize &size, int index,
+                 QString &error) {
+    const QString sweep = job.value("sweep");
+    const QString name = sweep.section(QLatin1Char('='), 0, 0).trimmed();
+    QVector<float> range;
+    bool known = false;
+    for (const char *parameter : sweepParameters) {
+        known = known || name == QLatin1String(parameter);
+    }
+    const int frameCount = job.value("frames").toInt();
+    const int fps = job.value("fps").toInt();
+    bool formatKnown = false;
+    const VideoFormat format = VideoStreamWriter::formatForFile(job.value("output"), &formatKnown);
+    if (!known) {
+        error = QStringLiteral("nieznany parametr animacji %1").arg(name);
+    } else if (!parseNumbers(sweep.section(QLatin1Char('='), 1), QStringLiteral(":"), 2, range)) {
+        error = QStringLiteral("niepoprawny zakres animacji: %1").arg(sweep);
+    } else if (name.startsWith(QLatin1String("plane-")) && job.value("plane").isEmpty()) {
+        error = QStringLiteral("animacja %1 wymaga płaszczyzny odcinającej (--plane)").arg(name);
+    } else if (frameCount < 1 || fps < 1) {
+        error = QStringLiteral("niepoprawna liczba klatek %1 lub klatek na sekundę %2")
+                .arg(job.value("frames"), job.value("fps"));
+    } else if (!formatKnown) {
+        error = QStringLiteral("animację można zapisać tylko do pliku .y4m lub .rgb: %1").arg(job.value("output"));
+    }
+    if (!error.isEmpty()) {
+        return false;
+    }
+
+    QFile file(job.value("output"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = QStringLiteral("%1: %2").arg(job.value("output"), file.errorString());
+        return false;
+    }
+    VideoStreamWriter writer(&file);
+    if (!writer.begin(format, size.width(), size.height(), fps)) {
+        error = writer.errorString();
+        return false;
+    }
+
+    SweepOptions options;
+    options.frameCount = frameCount;
+    options.size = size;
+    options.samples = job.value("msaa").toInt();
+    options.fieldChanges = !name.startsWith(QLatin1String("camera-"));
+    ParameterSweep sweeper(&scatter, graph);
+    const SweepResult result = sweeper.run(options, [&](int frame) {
+        const float t = frameCount > 1 ? static_cast<float>(frame) / (frameCount - 1) : 0.0f;
+        applySweepValue(scatter, graph, job, name, range[0] + t * (range[1] - range[0]));
+    }, writer);
+    file.close();
+    if (!result.ok) {
+        error = result.error;
+        return false;
+    }
+    std::printf("job=%d output=%s sweep=%s frames=%d size=%dx%d format=%s sampled=%d rescaled=%d reused=%d "
+                "computeMs=%.3f uploadMs=%.3f renderMs=%.3f writeMs=%.3f stallMs=%.3f totalMs=%.3f fps=%.2f "
+                "bytes=%lld\n",
+                index, qPrintable(job.value("output")), qPrintable(sweep), result.frames, size.width(), size.height(),
+                format == VideoFormat::Y4m ? "y4m" : "rgb24", result.sampledFrames, result.rescaledFrames,
+                result.reusedFrames, result.computeTimeNs / 1.0e6, result.uploadTimeNs / 1.0e6,
+                result.renderTimeNs / 1.0e6, result.writeTimeNs / 1.0e6, result.stallTimeNs / 1.0e6,
+                result.totalTimeNs / 1.0e6, result.framesPerSecond(), result.bytes);
+    std::fflush(stdout);
+    return true;
+}
+
+bool runJob(Scatter &scatter, Q3DScatter *graph, const PipelineStats &stats, const JobOptions &job, int index) {
+    QElapsedTimer total;
+    total.start();
+
+    QString error;
+    QVector<float> size;
+    if (job.value("output").isEmpty()) {
+        error = QStringLiteral("brak pliku wyjściowego (--output)");
+    } else if (!parseNumbers(job.value("size"), QStringLiteral("x"), 2, size) || size[0] < 1 || size[1] < 1) {
+        error = QStringLiteral("niepoprawny rozmiar obrazu: %1").arg(job.value("size"));
+    } else {
+        applyJob(scatter, graph, job, error);
+    }
+    if (!error.isEmpty()) {
+        std::fprintf(stderr, "job=%d error: %s\n", index, qPrintable(error));
+        return false;
+    }
+    const qint64 setupNs = total.nsecsElapsed();
+
+    if (!job.value("sweep").isEmpty()) {
+        const QSize frameSize(static_cast<int>(size[0]), static_cast<int>(size[1]));
+        if (!runSweepJob(scatter, graph, job, frameSize, index, error)) {
+            std::fprintf(stderr, "job=%d error: %s\n", index, qPrintable(error));
+            return false;
+        }
+        return true;
+    }
+
+    // zmiany parametrów zaplanowały regenerację, którą wykonuje się od razu w tym wątku
+    scatter.generateAndRenderVectors();
+
+    QElapsedTimer timer;
+    timer.start();
+    const QImage image = graph->renderToImage(job.value("msaa").toInt(),
+                                              QSize(static_cast<int>(size[0]), static_cast<int>(size[1])));
+    const qint64 renderNs = timer.nsecsElapsed();
+
+    timer.restart();
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    const bool encoded = !image.isNull() && image.save(&buffer, "png");
+    const qint64 encodeNs = timer.nsecsElapsed();
+
+    timer.restart();
+    QFile file(job.value("output"));
+    const bool written = encoded && file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+                         && file.write(png) == png.size();
+    file.close();
+    const qint64 writeNs = timer.nsecsElapsed();
+
+    if (!written) {
+        std::fprintf(stderr, "job=%d error: %s %s\n", index,
+                     image.isNull() ? "nie udało się wyrenderować wykresu" : "nie udało się zapisać pliku",
+                     qPrintable(job.value("output")));
+        return false;
+    }
+    std::printf("job=%d output=%s glyphs=%d triangles=%lld setupMs=%.3f sampleMs=%.3f glyphMs=%.3f "
+                "uploadMs=%.3f renderMs=%.3f encodeMs=%.3f writeMs=%.3f totalMs=%.3f bytes=%d\n",
+                index, qPrintable(job.value("output")), stats.emittedCount, stats.triangleCount,
+                setupNs / 1.0e6, stats.sampleTimeNs / 1.0e6, stats.glyphTimeNs / 1.0e6, stats.renderTimeNs / 1.0e6,
+                renderNs / 1.0e6, encodeNs / 1.0e6, writeNs / 1.0e6, total.nsecsElapsed() / 1.0e6, png.size());
+    std::fflush(stdout);
+    return true;
+}
+
+bool readJobFile(const QString &path, const JobOptions &defaults, QVector<JobOptions> &jobs, QString &error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QStringLiteral("nie można otworzyć pliku zadań %1").arg(path);
+        return false;
+    }
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!document.isArray()) {
+        error = parseError.error != QJsonParseError::NoError
+                ? QStringLiteral("%1: %2").arg(path, parseError.errorString())
+                : QStringLiteral("%1: oczekiwano tablicy zadań").arg(path);
+        return false;
+    }
+    for (const QJsonValue &value : document.array()) {
+        const QJsonObject object = value.toObject();
+        JobOptions job = defaults;
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            if (!defaults.contains(it.key())) {
+                error = QStringLiteral("%1: nieznana opcja %2").arg(path, it.key());
+                return false;
+            }
+            job.insert(it.key(), it.value().toVariant().toString());
+        }
+        jobs.append(job);
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    // platforma i OpenGL wybierane są przed utworzeniem aplikacji; zmienne środowiskowe mają pierwszeństwo
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    if (!qEnvironmentVariableIsSet("LIBGL_ALWAYS_SOFTWARE")) {
+        qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+    }
+    QCoreApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("vfv-batch"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Wsadowe renderowanie wykresów pola wektorowego do plików PNG "
+                                                    "i animacji Y4M."));
+    parser.addHelpOption();
+    QCommandLineOption jobOption(QStringList{"j", "job"}, QStringLiteral("Plik JSON z tablicą zadań."),
+                                 QStringLiteral("plik"));
+    QCommandLineOption threadsOption(QStringLiteral("threads"),
+                                     QStringLiteral("Liczba wątków próbkujących pole, 0 - tyle ile rdzeni."),
+                                     QStringLiteral("liczba"));
+    parser.addOption(jobOption);
+    parser.addOption(threadsOption);
+    for (const OptionSpec &spec : jobOptionSpecs) {
+        QStringList names{QString::fromLatin1(spec.name)};
+        if (QLatin1String(spec.name) == QLatin1String("output")) {
+            names.prepend(QStringLiteral("o"));
+        }
+        parser.addOption(QCommandLineOption(names, QString::fromUtf8(spec.description),
+                                            QString::fromUtf8(spec.valueName), QString::fromLatin1(spec.defaultValue)));
+    }
+    parser.process(app);
+
+    JobOptions defaults;
+    for (const OptionSpec &spec : jobOptionSpecs) {
+        defaults.insert(QString::fromLatin1(spec.name), parser.value(QString::fromLatin1(spec.name)));
+    }
+    QVector<JobOptions> jobs;
+    if (parser.isSet(jobOption)) {
+        QString error;
+        if (!readJobFile(parser.value(jobOption), defaults, jobs, error)) {
+            std::fprintf(stderr, "%s\n", qPrintable(error));
+            return 2;
+        }
+    } else {
+        jobs.append(defaults);
+    }
+
+    Q3DScatter *graph = new Q3DScatter();
+    if (!graph->hasContext()) {
+        std::fprintf(stderr, "Couldn't initialize the OpenGL context (platform %s).\n",
+                     qPrintable(QGuiApplication::platformName()));
+        delete graph;
+        return 2;
+    }
+    Scatter scatter(graph);
+    if (parser.isSet(threadsOption)) {
+        scatter.setThreadCount(parser.value(threadsOption).toInt());
+    }
+    PipelineStats stats;
+    QObject::connect(&scatter, &Scatter::statisticsChanged, [&stats](const PipelineStats &latest) { stats = latest; });
+
+    QElapsedTimer timer;
+    timer.start();
+    int failed = 0;
+    for (int i = 0; i < jobs.size(); i++) {
+        if (!runJob(scatter, graph, stats, jobs[i], i + 1)) {
+            failed++;
+        }
+    }
+    std::printf("jobs=%d failed=%d totalMs=%.3f platform=%s\n", jobs.size(), failed, timer.nsecsElapsed() / 1.0e6,
+                qPrintable(QGuiApplication::platformName()));
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#include "colorpalette.h"
+#include <QtCore/QtGlobal>
+
+ColorPalette::ColorPalette(int binCount) {
+    binCount = qBound(2, binCount, 256);
+    m_colors.reserve(binCount);
+    m_textures.reserve(binCount);
+    for (int bin = 0; bin < binCount; bin++) {
+        // kolor środka przedziału, tak jak w pierwotnym przejściu od niebieskiego do czerwonego
+        int out = (bin * 256 + 128) / binCount;
+        QColor color(out, 0, 255 - out);
+        QImage img = QImage(2, 2, QImage::Format_RGB32);
+        img.fill(color);
+        m_colors.append(color);
+        m_textures.append(img);
+    }
+
+    // kilka tekseli na przedział, żeby filtrowanie i mipmapy nie mieszały kolorów sąsiednich przedziałów
+    // przy próbkowaniu w środku przedziału
+    constexpr int texelsPerBin = 4;
+    m_strip = QImage(binCount * texelsPerBin, 2, QImage::Format_RGB32);
+    for (int bin = 0; bin < binCount; bin++) {
+        const QRgb rgb = m_colors[bin].rgb();
+        for (int x = bin * texelsPerBin; x < (bin + 1) * texelsPerBin; x++) {
+            m_strip.setPixel(x, 0, rgb);
+            m_strip.setPixel(x, 1, rgb);
+        }
+    }
+}
+
+qint64 ColorPalette::textureBytes() const {
+    return m_textures.first().sizeInBytes();
+}
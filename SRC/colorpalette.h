@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QtCore/QVector>
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+
+/**
+ * @brief ColorPalette - skwantowana tablica kolorów strzałek (od niebieskiego do czerwonego)
+ * wraz z teksturami współdzielonymi przez wszystkie strzałki z tego samego przedziału
+ */
+
+class ColorPalette
+{
+public:
+    /**
+     * @brief ColorPalette - konstruktor, od razu przygotowuje kolory i tekstury wszystkich przedziałów
+     * @param binCount - liczba przedziałów kolorów, od 2 do 256
+     */
+
+    explicit ColorPalette(int binCount = 16);
+
+    /**
+     * @brief binCount - zwraca liczbę przedziałów kolorów
+     */
+
+    int binCount() const { return m_colors.size(); }
+
+    /**
+     * @brief binOf - wyznacza przedział dla znormalizowanej długości wektora
+     * @param value - długość wektora przeskalowana do zakresu 0 - 255
+     * @return indeks przedziału
+     */
+
+    int binOf(unsigned char value) const { return value * binCount() / 256; }
+
+    /**
+     * @brief color - kolor przedziału
+     * @param bin - indeks przedziału
+     */
+
+    const QColor &color(int bin) const { return m_colors[bin]; }
+
+    /**
+     * @brief texture - tekstura 2x2 wypełniona kolorem przedziału. QImage jest współdzielony niejawnie,
+     * więc przekazanie go do wielu obiektów nie kopiuje pikseli.
+     * @param bin - indeks przedziału
+     */
+
+    const QImage &texture(int bin) const { return m_textures[bin]; }
+
+    /**
+     * @brief textureBytes - rozmiar pojedynczej tekstury w bajtach
+     */
+
+    qint64 textureBytes() const;
+
+    /**
+     * @brief strip - tekstura ze wszystkimi kolorami palety ułożonymi kolejno w poziomie, dla siatek, w których
+     * kolor wierzchołka wybierany jest współrzędną tekstury (stripCoordinate)
+     */
+
+    const QImage &strip() const { return m_strip; }
+
+    /**
+     * @brief stripCoordinate - współrzędna U środka przedziału w teksturze strip
+     * @param bin - indeks przedziału
+     */
+
+    float stripCoordinate(int bin) const { return (bin + 0.5f) / binCount(); }
+
+private:
+    QVector<QColor> m_colors;
+
+    QVector<QImage> m_textures;
+
+    QImage m_strip;
+};
@@ -0,0 +1,129 @@
+#include "exportqueue.h"
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtGui/QImageWriter>
+
+static ExportResult writeTarget(const QImage &frame, const ExportTarget &target, qint64 captureTimeNs) {
+    ExportResult result;
+    result.fileName = target.fileName;
+    result.captureTimeNs = captureTimeNs;
+
+    QElapsedTimer timer;
+    timer.start();
+    const QImage image = frame.size() == target.size
+                         ? frame
+                         : frame.scaled(target.size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    result.scaleTimeNs = timer.nsecsElapsed();
+
+    // QSaveFile podmienia plik dopiero po udanym zapisie, więc przerwany zapis nie zostawia uszkodzonego obrazu
+    timer.restart();
+    QSaveFile file(target.fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.error = file.errorString();
+        return result;
+    }
+    QImageWriter writer(&file, target.format);
+    writer.setQuality(target.quality);
+    if (!writer.write(image)) {
+        result.error = writer.errorString();
+        file.cancelWriting();
+        return result;
+    }
+    result.bytes = file.pos();
+    if (!file.commit()) {
+        result.error = file.errorString();
+        return result;
+    }
+    result.encodeTimeNs = timer.nsecsElapsed();
+    result.ok = true;
+    return result;
+}
+
+ExportQueue::ExportQueue(Capture capture, int threadCount, QObject *parent)
+        : QObject(parent),
+          m_capture(std::move(capture)) {
+    m_pool.setMaxThreadCount(threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount() / 2));
+}
+
+ExportQueue::~ExportQueue() {
+    m_pool.waitForDone();
+}
+
+QByteArray ExportQueue::formatForFile(const QString &fileName) {
+    QByteArray format = QFileInfo(fileName).suffix().toLower().toLatin1();
+    if (format == "jpeg") {
+        format = "jpg";
+    }
+    return QImageWriter::supportedImageFormats().contains(format) ? format : QByteArray();
+}
+
+void ExportQueue::enqueue(const QVector<ExportTarget> &targets) {
+    if (targets.isEmpty()) {
+        return;
+    }
+    m_pending.enqueue(targets);
+    m_total += targets.size();
+    Q_EMIT progressChanged(m_finished, m_total);
+    if (!m_captureScheduled) {
+        m_captureScheduled = true;
+        QTimer::singleShot(0, this, &ExportQueue::captureNext);
+    }
+}
+
+void ExportQueue::captureNext() {
+    m_captureScheduled = false;
+    if (m_pending.isEmpty()) {
+        return;
+    }
+    const QVector<ExportTarget> targets = m_pending.dequeue();
+
+    QSize captureSize;
+    for (const ExportTarget &target : targets) {
+        if (target.size.width() * target.size.height() > captureSize.width() * captureSize.height()) {
+            captureSize = target.size;
+        }
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const QImage frame = m_capture(captureSize);
+    const qint64 captureTimeNs = timer.nsecsElapsed();
+
+    for (const ExportTarget &target : targets) {
+        if (frame.isNull()) {
+            ExportResult result;
+            result.fileName = target.fileName;
+            result.captureTimeNs = captureTimeNs;
+            result.error = tr("Nie udało się przechwycić klatki wykresu");
+            finishTarget(result);
+            continue;
+        }
+        // QImage jest współdzielony niejawnie, więc wątki zapisujące nie kopiują pikseli klatki
+        auto watcher = new QFutureWatcher<ExportResult>(this);
+        connect(watcher, &QFutureWatcher<ExportResult>::finished, this, [this, watcher]() {
+            finishTarget(watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(&m_pool, writeTarget, frame, target, captureTimeNs));
+    }
+
+    // kolejne zlecenie dopiero w następnym przebiegu pętli zdarzeń, żeby interfejs reagował między klatkami
+    if (!m_pending.isEmpty()) {
+        m_captureScheduled = true;
+        QTimer::singleShot(0, this, &ExportQueue::captureNext);
+    }
+}
+
+void ExportQueue::finishTarget(const ExportResult &result) {
+    m_finished++;
+    Q_EMIT targetFinished(result);
+    Q_EMIT progressChanged(m_finished, m_total);
+    if (m_finished == m_total) {
+        m_finished = 0;
+        m_total = 0;
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMetaType>
+#include <QtCore/QObject>
+#include <QtCore/QQueue>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+
+#include <functional>
+
+/**
+ * @brief ExportTarget - jeden plik zapisywany z przechwyconej klatki wykresu
+ */
+
+struct ExportTarget
+{
+    QString fileName;    ///< ścieżka pliku
+    QByteArray format;   ///< format obsługiwany przez QImageWriter, np. "png" lub "jpg"
+    QSize size;          ///< rozmiar obrazu w pikselach
+    int quality = -1;    ///< jakość lub stopień kompresji przekazywany do QImageWriter, -1 - domyślny
+};
+
+/**
+ * @brief ExportResult - wynik zapisu jednego pliku, publikowany przez ExportQueue::targetFinished
+ */
+
+struct ExportResult
+{
+    QString fileName;
+    bool ok = false;
+    QString error;            ///< opis błędu, pusty gdy zapis się powiódł
+    qint64 captureTimeNs = 0; ///< czas przechwycenia klatki w wątku GUI, wspólny dla plików jednego zlecenia
+    qint64 scaleTimeNs = 0;   ///< czas skalowania klatki do rozmiaru pliku w wątku zapisującym
+    qint64 encodeTimeNs = 0;  ///< czas kodowania i zapisu pliku w wątku zapisującym
+    qint64 bytes = 0;         ///< rozmiar zapisanego pliku
+};
+
+Q_DECLARE_METATYPE(ExportResult)
+
+/**
+ * @brief ExportQueue - kolejka zapisu wykresu do plików. W wątku GUI wykonywane jest tylko przechwycenie klatki,
+ * po jednym zleceniu na przebieg pętli zdarzeń; skalowanie, kodowanie i zapis plików odbywają się w osobnej puli
+ * wątków, więc interfejs nie zatrzymuje się na czas kompresji. Zlecenie może zawierać kilka plików w różnych
+ * rozmiarach i formatach: klatka przechwytywana jest raz, w największym z rozmiarów, i zmniejszana dla pozostałych.
+ */
+
+class ExportQueue : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief Capture - funkcja przechwytująca klatkę wykresu w podanym rozmiarze, wywoływana w wątku GUI
+     */
+
+    using Capture = std::function<QImage(const QSize&)>;
+
+    /**
+     * @brief ExportQueue - tworzy kolejkę
+     * @param capture - funkcja przechwytująca klatkę
+     * @param threadCount - liczba wątków zapisujących, 0 - połowa rdzeni procesora
+     */
+
+    explicit ExportQueue(Capture capture, int threadCount = 0, QObject *parent = nullptr);
+
+    /**
+     * @brief destruktor - czeka na zapis plików, których kodowanie już się rozpoczęło; zlecenia oczekujące na
+     * przechwycenie klatki są porzucane
+     */
+
+    ~ExportQueue() override;
+
+    /**
+     * @brief enqueue - dopisuje zlecenie zapisu; klatka zostanie przechwycona w najbliższym przebiegu pętli zdarzeń
+     * @param targets - pliki do zapisania z tej samej klatki, o jednakowych proporcjach
+     */
+
+    void enqueue(const QVector<ExportTarget>& targets);
+
+    /**
+     * @brief isBusy - czy są pliki oczekujące na przechwycenie lub zapis
+     */
+
+    bool isBusy() const { return m_finished < m_total; }
+
+    /**
+     * @brief formatForFile - format QImageWriter odpowiadający rozszerzeniu pliku, pusty gdy nie jest obsługiwany
+     */
+
+    static QByteArray formatForFile(const QString& fileName);
+
+Q_SIGNALS:
+
+    /**
+     * @brief progressChanged - sygnał wysyłany po dopisaniu zlecenia i po zapisaniu każdego pliku
+     * @param finished - liczba zapisanych plików (również z błędem)
+     * @param total - liczba plików zleconych od chwili, gdy kolejka była pusta; oba liczniki zerowane są
+     * po zapisaniu ostatniego pliku
+     */
+
+    void progressChanged(int finished, int total);
+
+    /**
+     * @brief targetFinished - sygnał wysyłany w wątku GUI po zapisaniu każdego pliku
+     */
+
+    void targetFinished(const ExportResult& result);
+
+private:
+
+    /**
+     * @brief captureNext - przechwytuje klatkę pierwszego oczekującego zlecenia i przekazuje pliki do zapisu
+     */
+
+    void captureNext();
+
+    /**
+     * @brief finishTarget - aktualizuje liczniki po zapisaniu pliku
+     */
+
+    void finishTarget(const ExportResult& result);
+
+    Capture m_capture;
+
+    /**
+     * @brief m_pool - wątki skalujące, kodujące i zapisujące pliki; oddzielone od puli globalnej, żeby zapis
+     * nie opóźniał QtConcurrent::run generowania strzałek
+     */
+
+    QThreadPool m_pool;
+
+    /**
+     * @brief m_pending - zlecenia oczekujące na przechwycenie klatki
+     */
+
+    QQueue<QVector<ExportTarget>> m_pending;
+
+    /**
+     * @brief m_captureScheduled - czy przechwycenie zaplanowano już w pętli zdarzeń
+     */
+
+    bool m_captureScheduled = false;
+
+    int m_finished = 0;
+    int m_total = 0;
+};
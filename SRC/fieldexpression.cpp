@@ -0,0 +1,595 @@
+#include "fieldexpression.h"
+#include "fieldkernels.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <locale>
+#include <map>
+#include <random>
+#include <sstream>
+#include <tuple>
+
+using Op = FieldExpression::Op;
+
+namespace {
+
+bool isLeaf(Op op) {
+    return op <= Op::ParamC;
+}
+
+bool isBinary(Op op) {
+    return op >= Op::Add && op <= Op::Pow;
+}
+
+float applyUnary(Op op, float v) {
+    switch (op) {
+    case Op::Neg: return -v;
+    case Op::Sin: return std::sin(v);
+    case Op::Cos: return std::cos(v);
+    case Op::Tan: return std::tan(v);
+    case Op::Asin: return std::asin(v);
+    case Op::Acos: return std::acos(v);
+    case Op::Atan: return std::atan(v);
+    case Op::Sinh: return std::sinh(v);
+    case Op::Cosh: return std::cosh(v);
+    case Op::Tanh: return std::tanh(v);
+    case Op::Exp: return std::exp(v);
+    case Op::Log: return std::log(v);
+    case Op::Sqrt: return std::sqrt(v);
+    case Op::Abs: return std::fabs(v);
+    default: return v;
+    }
+}
+
+float applyBinary(Op op, float l, float r) {
+    switch (op) {
+    case Op::Add: return l + r;
+    case Op::Sub: return l - r;
+    case Op::Mul: return l * r;
+    case Op::Div: return l / r;
+    case Op::Pow: return std::pow(l, r);
+    default: return l;
+    }
+}
+
+struct FunctionName
+{
+    const char *name;
+    Op op;
+};
+
+const FunctionName functionNames[] = {
+    {"sin", Op::Sin}, {"cos", Op::Cos}, {"tan", Op::Tan}, {"tg", Op::Tan},
+    {"asin", Op::Asin}, {"acos", Op::Acos}, {"atan", Op::Atan},
+    {"sinh", Op::Sinh}, {"cosh", Op::Cosh}, {"tanh", Op::Tanh},
+    {"exp", Op::Exp}, {"log", Op::Log}, {"ln", Op::Log}, {"sqrt", Op::Sqrt}, {"abs", Op::Abs},
+};
+
+}
+
+/**
+ * @brief ExpressionCompiler - parser wyrażeń budujący wspólny graf trzech składowych i generator kodu bajtowego
+ */
+
+class ExpressionCompiler
+{
+public:
+    struct Node
+    {
+        Op op;
+        int lhs;
+        int rhs;
+        float value;
+        unsigned char parameters; ///< maska stałych a, b, c, od których zależy węzeł
+    };
+
+    std::shared_ptr<const FieldExpression> compile(const std::string sources[3], std::string *error) {
+        int outputs[3];
+        for (int component = 0; component < 3; component++) {
+            m_text = sources[component];
+            m_pos = 0;
+            m_error.clear();
+            int root = parseExpression();
+            skipSpaces();
+            if (m_error.empty() && m_pos < m_text.size()) {
+                fail("unexpected '" + std::string(1, m_text[m_pos]) + "'");
+            }
+            if (!m_error.empty()) {
+                if (error) {
+                    static const char *names[3] = {"P", "Q", "R"};
+                    *error = std::string(names[component]) + ": " + m_error + " (position "
+                             + std::to_string(m_errorPos + 1) + ")";
+                }
+                return nullptr;
+            }
+            outputs[component] = root;
+            m_dependence[component] = dependence(root);
+        }
+
+        std::shared_ptr<FieldExpression> expression(new FieldExpression);
+        for (int component = 0; component < 3; component++) {
+            expression->m_source[component] = sources[component];
+            expression->m_dependence[component] = m_dependence[component];
+        }
+        generate(outputs, *expression);
+        return expression;
+    }
+
+private:
+    // ---- graf wyrażeń ----
+
+    int makeNode(Op op, int lhs = -1, int rhs = -1, float value = 0.0f) {
+        // zwijanie stałych
+        if (!isLeaf(op) && !isBinary(op) && m_nodes[lhs].op == Op::Const) {
+            return constant(applyUnary(op, m_nodes[lhs].value));
+        }
+        if (isBinary(op)) {
+            const bool lhsConst = m_nodes[lhs].op == Op::Const;
+            const bool rhsConst = m_nodes[rhs].op == Op::Const;
+            if (lhsConst && rhsConst) {
+                return constant(applyBinary(op, m_nodes[lhs].value, m_nodes[rhs].value));
+            }
+            // proste tożsamości, które nie zmieniają wyniku zmiennoprzecinkowego
+            if ((op == Op::Add && lhsConst && m_nodes[lhs].value == 0.0f) ||
+                (op == Op::Mul && lhsConst && m_nodes[lhs].value == 1.0f)) {
+                return rhs;
+            }
+            if (((op == Op::Add || op == Op::Sub) && rhsConst && m_nodes[rhs].value == 0.0f) ||
+                ((op == Op::Mul || op == Op::Div || op == Op::Pow) && rhsConst && m_nodes[rhs].value == 1.0f)) {
+                return lhs;
+            }
+            if (op == Op::Pow && rhsConst && m_nodes[rhs].value == 2.0f) {
+                return makeNode(Op::Mul, lhs, lhs);
+            }
+            // czynnik a, b lub c wyciągany jest przed iloczyn z wyrażeniem od stałych niezależnym: (a*E)*R -> a*(E*R),
+            // dzięki czemu składowa pozostaje iloczynem stałej i bazy, którą można przeskalować (parameterDependence)
+            int factor, rest;
+            if (op == Op::Mul && m_nodes[rhs].parameters == 0 && splitParameterFactor(lhs, factor, rest)) {
+                return makeNode(Op::Mul, factor, makeNode(Op::Mul, rest, rhs));
+            }
+            if (op == Op::Mul && m_nodes[lhs].parameters == 0 && splitParameterFactor(rhs, factor, rest)) {
+                return makeNode(Op::Mul, factor, makeNode(Op::Mul, lhs, rest));
+            }
+            // działania przemienne zapisywane w jednej kolejności, aby a*x i x*a były tym samym węzłem
+            if ((op == Op::Add || op == Op::Mul) && lhs > rhs) {
+                std::swap(lhs, rhs);
+            }
+        }
+        // -(a*E) -> a*(-E), zmiana znaku jest dokładna
+        int factor, rest;
+        if (op == Op::Neg && splitParameterFactor(lhs, factor, rest)) {
+            return makeNode(Op::Mul, factor, makeNode(Op::Neg, rest));
+        }
+
+        // eliminacja wspólnych podwyrażeń - identyczny węzeł tworzony jest tylko raz
+        std::uint32_t bits = 0;
+        if (op == Op::Const) {
+            std::memcpy(&bits, &value, sizeof(bits));
+        }
+        const auto key = std::make_tuple(static_cast<int>(op), lhs, rhs, bits);
+        const auto found = m_nodeIndex.find(key);
+        if (found != m_nodeIndex.end()) {
+            return found->second;
+        }
+        unsigned char parameters = parameterBit(op);
+        if (lhs >= 0) {
+            parameters |= m_nodes[lhs].parameters;
+        }
+        if (rhs >= 0) {
+            parameters |= m_nodes[rhs].parameters;
+        }
+        m_nodes.push_back(Node{op, lhs, rhs, value, parameters});
+        const int index = static_cast<int>(m_nodes.size()) - 1;
+        m_nodeIndex.emplace(key, index);
+        return index;
+    }
+
+    int constant(float value) {
+        return makeNode(Op::Const, -1, -1, value);
+    }
+
+    static unsigned char parameterBit(Op op) {
+        switch (op) {
+        case Op::ParamA: return 1;
+        case Op::ParamB: return 2;
+        case Op::ParamC: return 4;
+        default: return 0;
+        }
+    }
+
+    // rozkłada węzeł p*E, gdzie p to a, b lub c, a E od stałych nie zależy
+    bool splitParameterFactor(int node, int &factor, int &rest) const {
+        const Node &n = m_nodes[node];
+        if (n.op != Op::Mul) {
+            return false;
+        }
+        if (parameterBit(m_nodes[n.lhs].op) && m_nodes[n.rhs].parameters == 0) {
+            factor = n.lhs;
+            rest = n.rhs;
+            return true;
+        }
+        if (parameterBit(m_nodes[n.rhs].op) && m_nodes[n.lhs].parameters == 0) {
+            factor = n.rhs;
+            rest = n.lhs;
+            return true;
+        }
+        return false;
+    }
+
+    ParameterDependence dependence(int root) const {
+        ParameterDependence result{m_nodes[root].parameters, -1};
+        int factor = root, rest;
+        if (parameterBit(m_nodes[root].op) || splitParameterFactor(root, factor, rest)) {
+            result.scale = static_cast<signed char>(static_cast<int>(m_nodes[factor].op) - static_cast<int>(Op::ParamA));
+        }
+        return result;
+    }
+
+    // ---- parser ----
+
+    void fail(const std::string &message) {
+        if (m_error.empty()) {
+            m_error = message;
+            m_errorPos = m_pos;
+        }
+    }
+
+    void skipSpaces() {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+            m_pos++;
+        }
+    }
+
+    bool accept(char c) {
+        skipSpaces();
+        if (m_pos < m_text.size() && m_text[m_pos] == c) {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+
+    // expression := term (('+' | '-') term)*
+    int parseExpression() {
+        int node = parseTerm();
+        while (m_error.empty()) {
+            if (accept('+')) {
+                node = makeNode(Op::Add, node, parseTerm());
+            } else if (accept('-')) {
+                node = makeNode(Op::Sub, node, parseTerm());
+            } else {
+                break;
+            }
+        }
+        return node;
+    }
+
+    // term := unary (('*' | '/') unary)*
+    int parseTerm() {
+        int node = parseUnary();
+        while (m_error.empty()) {
+            if (accept('*')) {
+                node = makeNode(Op::Mul, node, parseUnary());
+            } else if (accept('/')) {
+                node = makeNode(Op::Div, node, parseUnary());
+            } else {
+                break;
+            }
+        }
+        return node;
+    }
+
+    // unary := ('-' | '+') unary | power
+    int parseUnary() {
+        if (accept('-')) {
+            return makeNode(Op::Neg, parseUnary());
+        }
+        if (accept('+')) {
+            return parseUnary();
+        }
+        return parsePower();
+    }
+
+    // power := primary ('^' unary)?
+    int parsePower() {
+        int node = parsePrimary();
+        if (m_error.empty() && accept('^')) {
+            node = makeNode(Op::Pow, node, parseUnary());
+        }
+        return node;
+    }
+
+    // primary := number | name | name '(' expression ')' | '(' expression ')'
+    int parsePrimary() {
+        if (!m_error.empty()) {
+            return constant(0.0f);
+        }
+        skipSpaces();
+        if (m_pos >= m_text.size()) {
+            fail("unexpected end of expression");
+            return constant(0.0f);
+        }
+        const char c = m_text[m_pos];
+        if (accept('(')) {
+            int node = parseExpression();
+            if (!accept(')')) {
+                fail("missing ')'");
+            }
+            return node;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            return parseNumber();
+        }
+        if (std::isalpha(static_cast<unsigned char>(c))) {
+            const size_t start = m_pos;
+            while (m_pos < m_text.size() && std::isalnum(static_cast<unsigned char>(m_text[m_pos]))) {
+                m_pos++;
+            }
+            const std::string name = m_text.substr(start, m_pos - start);
+            if (name == "x") return makeNode(Op::X);
+            if (name == "y") return makeNode(Op::Y);
+            if (name == "z") return makeNode(Op::Z);
+            if (name == "a") return makeNode(Op::ParamA);
+            if (name == "b") return makeNode(Op::ParamB);
+            if (name == "c") return makeNode(Op::ParamC);
+            if (name == "pi") return constant(3.14159265358979323846f);
+            if (name == "e") return constant(2.71828182845904523536f);
+            for (const FunctionName &function : functionNames) {
+                if (name == function.name) {
+                    if (!accept('(')) {
+                        fail("expected '(' after " + name);
+                        return constant(0.0f);
+                    }
+                    int argument = parseExpression();
+                    if (!accept(')')) {
+                        fail("missing ')'");
+                    }
+                    return makeNode(function.op, argument);
+                }
+            }
+            m_pos = start;
+            fail("unknown name '" + name + "'");
+            return constant(0.0f);
+        }
+        fail("unexpected '" + std::string(1, c) + "'");
+        return constant(0.0f);
+    }
+
+    int parseNumber() {
+        // liczby czytane zawsze z kropką dziesiętną, niezależnie od ustawień regionalnych
+        const size_t start = m_pos;
+        while (m_pos < m_text.size() && (std::isdigit(static_cast<unsigned char>(m_text[m_pos])) || m_text[m_pos] == '.')) {
+            m_pos++;
+        }
+        if (m_pos < m_text.size() && (m_text[m_pos] == 'e' || m_text[m_pos] == 'E')) {
+            size_t exponent = m_pos + 1;
+            if (exponent < m_text.size() && (m_text[exponent] == '+' || m_text[exponent] == '-')) {
+                exponent++;
+            }
+            if (exponent < m_text.size() && std::isdigit(static_cast<unsigned char>(m_text[exponent]))) {
+                m_pos = exponent;
+                while (m_pos < m_text.size() && std::isdigit(static_cast<unsigned char>(m_text[m_pos]))) {
+                    m_pos++;
+                }
+            }
+        }
+        std::istringstream stream(m_text.substr(start, m_pos - start));
+        stream.imbue(std::locale::classic());
+        double value = 0.0;
+        stream >> value;
+        if (stream.fail() || !stream.eof()) {
+            m_pos = start;
+            fail("invalid number");
+        }
+        return constant(static_cast<float>(value));
+    }
+
+    // ---- generator kodu ----
+
+    void generate(const int outputs[3], FieldExpression &expression) {
+        const int nodeCount = static_cast<int>(m_nodes.size());
+
+        // węzły potrzebne do wyznaczenia wyjść i liczba ich użyć; węzły tworzone są po swoich
+        // argumentach, więc kolejność tablicy jest kolejnością topologiczną
+        std::vector<int> uses(nodeCount, 0);
+        std::vector<bool> needed(nodeCount, false);
+        for (int component = 0; component < 3; component++) {
+            needed[outputs[component]] = true;
+        }
+        for (int node = nodeCount - 1; node >= 0; node--) {
+            if (!needed[node]) {
+                continue;
+            }
+            if (m_nodes[node].lhs >= 0) {
+                needed[m_nodes[node].lhs] = true;
+                uses[m_nodes[node].lhs]++;
+            }
+            if (m_nodes[node].rhs >= 0) {
+                needed[m_nodes[node].rhs] = true;
+                uses[m_nodes[node].rhs]++;
+            }
+        }
+        for (int component = 0; component < 3; component++) {
+            // wyjścia nie mogą zostać nadpisane przed końcem programu
+            uses[outputs[component]] += nodeCount;
+        }
+
+        std::vector<int> registers(nodeCount, -1);
+        std::vector<int> freeRegisters;
+        int registerCount = 0;
+        auto release = [&](int node) {
+            if (node >= 0 && --uses[node] == 0) {
+                freeRegisters.push_back(registers[node]);
+            }
+        };
+
+        for (int node = 0; node < nodeCount; node++) {
+            if (!needed[node]) {
+                continue;
+            }
+            const Node &n = m_nodes[node];
+            // argumenty zwalniane przed przydziałem wyniku - instrukcje działają element po elemencie,
+            // więc wynik może trafić do rejestru argumentu
+            release(n.lhs);
+            release(n.rhs);
+            int reg;
+            if (!freeRegisters.empty()) {
+                reg = freeRegisters.back();
+                freeRegisters.pop_back();
+            } else {
+                reg = registerCount++;
+            }
+            registers[node] = reg;
+
+            FieldExpression::Instruction instruction;
+            instruction.op = n.op;
+            instruction.dst = static_cast<unsigned short>(reg);
+            instruction.lhs = static_cast<unsigned short>(n.lhs >= 0 ? registers[n.lhs] : 0);
+            instruction.rhs = static_cast<unsigned short>(n.rhs >= 0 ? registers[n.rhs] : 0);
+            instruction.value = n.value;
+            expression.m_code.push_back(instruction);
+        }
+
+        expression.m_registerCount = registerCount;
+        for (int component = 0; component < 3; component++) {
+            expression.m_outputs[component] = registers[outputs[component]];
+        }
+    }
+
+    std::vector<Node> m_nodes;
+    ParameterDependence m_dependence[3] = {};
+    std::map<std::tuple<int, int, int, std::uint32_t>, int> m_nodeIndex;
+
+    std::string m_text;
+    size_t m_pos = 0;
+    std::string m_error;
+    size_t m_errorPos = 0;
+};
+
+std::shared_ptr<const FieldExpression> FieldExpression::compile(const std::string &p, const std::string &q,
+                                                                const std::string &r, std::string *error) {
+    const std::string sources[3] = {p, q, r};
+    ExpressionCompiler compiler;
+    return compiler.compile(sources, error);
+}
+
+void FieldExpression::evaluate(const float *x, const float *y, const float *z,
+                               float *vx, float *vy, float *vz, int count,
+                               float a, float b, float c) const {
+    thread_local std::vector<float> storage;
+    storage.resize(static_cast<size_t>(std::max(m_registerCount, 1)) * blockSize);
+    float *registers = storage.data();
+    float *outputs[3] = {vx, vy, vz};
+
+    for (int start = 0; start < count; start += blockSize) {
+        const int n = std::min(blockSize, count - start);
+        for (const Instruction &instruction : m_code) {
+            float *d = registers + instruction.dst * blockSize;
+            const float *l = registers + instruction.lhs * blockSize;
+            const float *r = registers + instruction.rhs * blockSize;
+            switch (instruction.op) {
+            case Op::Const: std::fill(d, d + n, instruction.value); break;
+            case Op::X: std::memcpy(d, x + start, n * sizeof(float)); break;
+            case Op::Y: std::memcpy(d, y + start, n * sizeof(float)); break;
+            case Op::Z: std::memcpy(d, z + start, n * sizeof(float)); break;
+            case Op::ParamA: std::fill(d, d + n, a); break;
+            case Op::ParamB: std::fill(d, d + n, b); break;
+            case Op::ParamC: std::fill(d, d + n, c); break;
+            case Op::Add: for (int i = 0; i < n; i++) d[i] = l[i] + r[i]; break;
+            case Op::Sub: for (int i = 0; i < n; i++) d[i] = l[i] - r[i]; break;
+            case Op::Mul: for (int i = 0; i < n; i++) d[i] = l[i] * r[i]; break;
+            case Op::Div: for (int i = 0; i < n; i++) d[i] = l[i] / r[i]; break;
+            case Op::Pow: for (int i = 0; i < n; i++) d[i] = std::pow(l[i], r[i]); break;
+            case Op::Neg: for (int i = 0; i < n; i++) d[i] = -l[i]; break;
+            case Op::Sin: for (int i = 0; i < n; i++) d[i] = std::sin(l[i]); break;
+            case Op::Cos: for (int i = 0; i < n; i++) d[i] = std::cos(l[i]); break;
+            case Op::Tan: for (int i = 0; i < n; i++) d[i] = std::tan(l[i]); break;
+            case Op::Asin: for (int i = 0; i < n; i++) d[i] = std::asin(l[i]); break;
+            case Op::Acos: for (int i = 0; i < n; i++) d[i] = std::acos(l[i]); break;
+            case Op::Atan: for (int i = 0; i < n; i++) d[i] = std::atan(l[i]); break;
+            case Op::Sinh: for (int i = 0; i < n; i++) d[i] = std::sinh(l[i]); break;
+            case Op::Cosh: for (int i = 0; i < n; i++) d[i] = std::cosh(l[i]); break;
+            case Op::Tanh: for (int i = 0; i < n; i++) d[i] = std::tanh(l[i]); break;
+            case Op::Exp: for (int i = 0; i < n; i++) d[i] = std::exp(l[i]); break;
+            case Op::Log: for (int i = 0; i < n; i++) d[i] = std::log(l[i]); break;
+            case Op::Sqrt: for (int i = 0; i < n; i++) d[i] = std::sqrt(l[i]); break;
+            case Op::Abs: for (int i = 0; i < n; i++) d[i] = std::fabs(l[i]); break;
+            }
+        }
+        for (int component = 0; component < 3; component++) {
+            std::memcpy(outputs[component] + start, registers + m_outputs[component] * blockSize, n * sizeof(float));
+        }
+    }
+}
+
+std::string benchmarkExpressions(int pointCount) {
+    struct Case
+    {
+        const char *name;
+        FieldKind kind;
+        const char *p;
+        const char *q;
+        const char *r;
+    };
+    static const Case cases[] = {
+        {"linear", FieldKind::Linear, "a*x", "b*y", "c*z"},
+        {"product", FieldKind::Product, "a*y*z", "b*x*z", "c*x*y"},
+        {"sin", FieldKind::Sin, "sin(a*x)", "b*sin(y)", "c*sin(z)"},
+        {"tan", FieldKind::Tan, "a*tan(x)", "b*tan(y)", "c*tan(z)"},
+    };
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::vector<float> x(pointCount), y(pointCount), z(pointCount);
+    for (int i = 0; i < pointCount; i++) {
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+        z[i] = distribution(generator);
+    }
+    std::vector<float> vx(pointCount), vy(pointCount), vz(pointCount);
+
+    auto measure = [&](const std::function<void()> &run) {
+        int runs = 0;
+        const auto start = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::steady_clock::duration::zero();
+        do {
+            run();
+            runs++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed < std::chrono::milliseconds(200));
+        return static_cast<double>(runs) * pointCount / std::chrono::duration<double>(elapsed).count() / 1.0e6;
+    };
+
+    std::string report = "field    VM Mpoints/s  scalar lambda  best kernel (" + std::string(isaName(supportedIsa()))
+                         + ")  instructions\n";
+    char line[160];
+    for (const Case &test : cases) {
+        std::string error;
+        auto expression = FieldExpression::compile(test.p, test.q, test.r, &error);
+        if (!expression) {
+            report += std::string(test.name) + ": " + error + "\n";
+            continue;
+        }
+        const double vm = measure([&]() {
+            expression->evaluate(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+        });
+        const BatchKernel scalar = batchKernel(test.kind, KernelIsa::Scalar);
+        const double builtin = measure([&]() {
+            scalar(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+        });
+        const BatchKernel best = batchKernel(test.kind);
+        const double simd = measure([&]() {
+            best(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+        });
+        std::snprintf(line, sizeof(line), "%-8s %13.1f  %13.1f  %16.1f  %12d\n",
+                      test.name, vm, builtin, simd, expression->instructionCount());
+        report += line;
+    }
+    return report;
+}
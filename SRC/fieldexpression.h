@@ -0,0 +1,136 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fieldkernels.h"
+
+/**
+ * @brief FieldExpression - pole wektorowe F(x,y,z) = (P, Q, R) podane przez użytkownika jako trzy wyrażenia.
+ *
+ * Wyrażenia parsowane są do wspólnego grafu (DAG), w którym identyczne podwyrażenia wszystkich trzech składowych
+ * występują tylko raz, a podwyrażenia stałe są od razu wyliczane. Graf tłumaczony jest na kod bajtowy maszyny
+ * rejestrowej, której rejestr przechowuje wartości dla całego bloku punktów - jedna instrukcja jest dekodowana
+ * raz na blok, a nie raz na punkt.
+ *
+ * Dostępne są zmienne x, y, z, stałe a, b, c, pi, e, operatory + - * / ^ oraz funkcje
+ * sin, cos, tan, asin, acos, atan, sinh, cosh, tanh, exp, log, sqrt, abs.
+ *
+ * Iloczyn stałej a, b lub c z wyrażeniami od stałych niezależnymi liczony jest tak, jakby stała była ostatnim
+ * czynnikiem (a*x*y = a*(x*y)), dzięki czemu takie składowe można przy zmianie stałej tylko przeskalować.
+ */
+
+class FieldExpression
+{
+public:
+    /**
+     * @brief blockSize - liczba punktów przetwarzanych przez jedną instrukcję
+     */
+
+    static constexpr int blockSize = 256;
+
+    /**
+     * @brief compile - kompiluje trzy składowe pola
+     * @param p, q, r - wyrażenia składowych x, y, z
+     * @param error - opis błędu, jeśli kompilacja się nie powiodła
+     * @return skompilowane pole lub nullptr w przypadku błędu
+     */
+
+    static std::shared_ptr<const FieldExpression> compile(const std::string& p, const std::string& q,
+                                                          const std::string& r, std::string *error);
+
+    /**
+     * @brief evaluate - wyznacza wektory pola dla count punktów, ma tę samą postać co BatchKernel.
+     * Może być wywoływana jednocześnie z wielu wątków.
+     */
+
+    void evaluate(const float *x, const float *y, const float *z,
+                  float *vx, float *vy, float *vz, int count,
+                  float a, float b, float c) const;
+
+    /**
+     * @brief instructionCount - liczba instrukcji kodu bajtowego
+     */
+
+    int instructionCount() const { return static_cast<int>(m_code.size()); }
+
+    /**
+     * @brief registerCount - liczba rejestrów blokowych używanych przez kod
+     */
+
+    int registerCount() const { return m_registerCount; }
+
+    /**
+     * @brief parameterDependence - zależność składowej od stałych a, b, c wykryta podczas kompilacji
+     * @param component - 0 - P, 1 - Q, 2 - R
+     */
+
+    ParameterDependence parameterDependence(int component) const { return m_dependence[component]; }
+
+    /**
+     * @brief source - tekst wyrażeń, z których skompilowano pole
+     */
+
+    const std::string& source(int component) const { return m_source[component]; }
+
+    /**
+     * @brief Op - operacje grafu wyrażeń i instrukcje kodu bajtowego
+     */
+
+    enum class Op : unsigned char
+    {
+        Const, X, Y, Z, ParamA, ParamB, ParamC,
+        Add, Sub, Mul, Div, Pow, Neg,
+        Sin, Cos, Tan, Asin, Acos, Atan, Sinh, Cosh, Tanh, Exp, Log, Sqrt, Abs
+    };
+
+    /**
+     * @brief Instruction - instrukcja maszyny rejestrowej: dst = op(lhs, rhs)
+     */
+
+    struct Instruction
+    {
+        Op op;
+        unsigned short dst;
+        unsigned short lhs;
+        unsigned short rhs;
+        float value;
+    };
+
+    /**
+     * @brief code - kod bajtowy, wykorzystywany również przez generator kodu natywnego
+     */
+
+    const std::vector<Instruction>& code() const { return m_code; }
+
+    /**
+     * @brief outputRegister - rejestr, w którym po wykonaniu kodu znajduje się dana składowa
+     * @param component - 0 - P, 1 - Q, 2 - R
+     */
+
+    int outputRegister(int component) const { return m_outputs[component]; }
+
+private:
+    FieldExpression() = default;
+
+    std::vector<Instruction> m_code;
+
+    int m_registerCount = 0;
+
+    int m_outputs[3] = {0, 0, 0};
+
+    std::string m_source[3];
+
+    ParameterDependence m_dependence[3] = {};
+
+    friend class ExpressionCompiler;
+};
+
+/**
+ * @brief benchmarkExpressions - porównuje przepustowość maszyny wirtualnej z wbudowanymi jądrami pól
+ * @param pointCount - liczba punktów w jednym przebiegu
+ * @return tabela wyników w postaci tekstu
+ */
+
+std::string benchmarkExpressions(int pointCount);
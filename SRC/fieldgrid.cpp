@@ -0,0 +1,167 @@
+#include "fieldgrid.h"
+#include "workstealingpool.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+void FieldGrid::clear() {
+    resize(0, 0, 0);
+    minMagnitude = 0.0f;
+    maxMagnitude = 0.0f;
+    visibleCount = 0;
+    invalidCount = 0;
+    histogram.clear();
+    layerVisibleCounts.clear();
+}
+
+bool FieldGrid::resize(int nx, int ny, int nz) {
+    const qint64 nodes = nodeCount(nx, ny, nz);
+    const bool fits = nodes >= 0 && nodes <= maxNodeCount;
+    countX = fits ? nx : 0;
+    countY = fits ? ny : 0;
+    countZ = fits ? nz : 0;
+    const int count = fits ? static_cast<int>(nodes) : 0;
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    vx.resize(count);
+    vy.resize(count);
+    vz.resize(count);
+    magnitudes.resize(count);
+    clipped.resize(count);
+    return fits;
+}
+
+namespace {
+
+struct LayerStatistics
+{
+    float min = std::numeric_limits<float>::max();
+    float max = 0.0f;
+    int visible = 0;
+    int invalid = 0;
+};
+
+void forEachLayer(WorkStealingPool *pool, int layerCount, const std::function<void(int)> &body) {
+    if (pool) {
+        pool->parallelFor(0, layerCount, 1, [&body](int first, int last) {
+            for (int layer = first; layer < last; layer++) {
+                body(layer);
+            }
+        });
+    } else {
+        for (int layer = 0; layer < layerCount; layer++) {
+            body(layer);
+        }
+    }
+}
+
+}
+
+void FieldGrid::updateStatistics(WorkStealingPool *pool) {
+    const int layerCount = countX;
+    const int layer = layerSize();
+    const float *mags = magnitudes.constData();
+    const unsigned char *clip = clipped.constData();
+
+    // pierwszy przebieg - zakres długości i liczba widocznych węzłów w każdej warstwie
+    QVector<LayerStatistics> layers(layerCount);
+    LayerStatistics *layerStats = layers.data();
+    forEachLayer(pool, layerCount, [mags, clip, layer, layerStats](int l) {
+        LayerStatistics stats;
+        for (int i = l * layer; i < (l + 1) * layer; i++) {
+            if (clip[i]) {
+                stats.invalid += clip[i] & invalidSample ? 1 : 0;
+                continue;
+            }
+            if (mags[i] > stats.max) {
+                stats.max = mags[i];
+            }
+            if (mags[i] < stats.min) {
+                stats.min = mags[i];
+            }
+            stats.visible++;
+        }
+        layerStats[l] = stats;
+    });
+
+    LayerStatistics total;
+    layerVisibleCounts.resize(layerCount);
+    for (int l = 0; l < layerCount; l++) {
+        total.min = std::fmin(total.min, layers[l].min);
+        total.max = std::fmax(total.max, layers[l].max);
+        total.visible += layers[l].visible;
+        total.invalid += layers[l].invalid;
+        layerVisibleCounts[l] = layers[l].visible;
+    }
+    minMagnitude = total.visible > 0 ? total.min : 0.0f;
+    maxMagnitude = total.max;
+    visibleCount = total.visible;
+    invalidCount = total.invalid;
+
+    // drugi przebieg - histogram znormalizowanych długości, zliczany osobno dla każdej warstwy
+    QVector<int> layerHistograms(layerCount * histogramBins, 0);
+    int *histograms = layerHistograms.data();
+    forEachLayer(pool, layerCount, [this, clip, layer, histograms](int l) {
+        int *bins = histograms + l * histogramBins;
+        for (int i = l * layer; i < (l + 1) * layer; i++) {
+            if (!clip[i]) {
+                bins[normalized(i)]++;
+            }
+        }
+    });
+
+    histogram.fill(0, histogramBins);
+    for (int l = 0; l < layerCount; l++) {
+        for (int bin = 0; bin < histogramBins; bin++) {
+            histogram[bin] += layerHistograms[l * histogramBins + bin];
+        }
+    }
+}
+
+void FieldGrid::updateStatisticsSinglePass() {
+    const int layer = layerSize();
+    float min = std::numeric_limits<float>::max();
+    float max = 0.0f;
+    int visible = 0;
+    int invalid = 0;
+    layerVisibleCounts.fill(0, countX);
+    for (int i = 0; i < size(); i++) {
+        if (clipped[i]) {
+            invalid += clipped[i] & invalidSample ? 1 : 0;
+            continue;
+        }
+        min = magnitudes[i] < min ? magnitudes[i] : min;
+        max = magnitudes[i] > max ? magnitudes[i] : max;
+        visible++;
+        layerVisibleCounts[i / layer]++;
+    }
+    minMagnitude = visible > 0 ? min : 0.0f;
+    maxMagnitude = max;
+    visibleCount = visible;
+    invalidCount = invalid;
+
+    histogram.fill(0, histogramBins);
+    for (int i = 0; i < size(); i++) {
+        if (!clipped[i]) {
+            histogram[normalized(i)]++;
+        }
+    }
+}
+
+unsigned char FieldGrid::normalized(int index) const {
+    // rzutowanie NaN lub nieskończoności na unsigned char jest niezdefiniowane, więc takie węzły dostają 0
+    if (maxMagnitude <= minMagnitude || sampleFlag(magnitudes[index])) {
+        return 0;
+    }
+    return static_cast<unsigned char>(std::abs((magnitudes[index] - minMagnitude) * 255 / (maxMagnitude - minMagnitude)));
+}
+
+bool sameStatistics(const FieldGrid &first, const FieldGrid &second) {
+    return std::memcmp(&first.minMagnitude, &second.minMagnitude, sizeof(float)) == 0
+           && std::memcmp(&first.maxMagnitude, &second.maxMagnitude, sizeof(float)) == 0
+           && first.visibleCount == second.visibleCount
+           && first.invalidCount == second.invalidCount
+           && first.histogram == second.histogram
+           && first.layerVisibleCounts == second.layerVisibleCounts;
+}
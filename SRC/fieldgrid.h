@@ -0,0 +1,178 @@
+#pragma once
+
+#include <QtCore/QVector>
+
+#include <cmath>
+
+class WorkStealingPool;
+
+/**
+ * @brief FieldGrid - próbki pola wektorowego w węzłach siatki, przechowywane jako struktura tablic.
+ * Wypełniana jednym przebiegiem próbkowania, z niej korzystają normalizacja, kolorowanie i budowanie strzałek.
+ * Węzeł (ix, iy, iz) ma indeks (ix * countY + iy) * countZ + iz, więc każda warstwa X to ciągły fragment tablic.
+ */
+
+struct FieldGrid
+{
+    /**
+     * @brief histogramBins - liczba przedziałów histogramu znormalizowanych długości
+     */
+
+    static constexpr int histogramBins = 256;
+
+    /**
+     * @brief maxNodeCount - największa liczba węzłów siatki. QVector w Qt 5 mieści co najwyżej około 2 GB,
+     * a tablica strzałek ma jedną strzałkę (44 bajty) na węzeł, więc większa siatka nie zmieściłaby się w pamięci.
+     */
+
+    static constexpr qint64 maxNodeCount = 32 * 1024 * 1024;
+
+    /**
+     * @brief nodeCount - liczba węzłów siatki o podanych wymiarach, bez przepełnienia typu int
+     */
+
+    static qint64 nodeCount(int nx, int ny, int nz) { return static_cast<qint64>(nx) * ny * nz; }
+
+    /**
+     * @brief clippedByPlane, invalidSample - znaczniki w tablicy clipped: węzeł nad płaszczyzną odcinającą
+     * oraz węzeł, w którym wektor pola lub jego długość nie jest skończona (np. 1/x w węźle x = 0, NaN z pliku)
+     */
+
+    static constexpr unsigned char clippedByPlane = 1;
+    static constexpr unsigned char invalidSample = 2;
+
+    /**
+     * @brief sampleFlag - znacznik invalidSample dla węzła o podanym kwadracie długości, 0 - próbka poprawna.
+     * Kwadrat długości jest nieskończony lub NaN zawsze, gdy którakolwiek składowa nie jest skończona.
+     */
+
+    static unsigned char sampleFlag(float magnitude) { return std::isfinite(magnitude) ? 0 : invalidSample; }
+
+    /**
+     * @brief countX, countY, countZ - liczba węzłów wzdłuż osi
+     */
+
+    int countX = 0;
+    int countY = 0;
+    int countZ = 0;
+
+    /**
+     * @brief x, y, z - współrzędne kolejnych węzłów siatki
+     */
+
+    QVector<float> x, y, z;
+
+    /**
+     * @brief vx, vy, vz - składowe wektora pola w kolejnych węzłach
+     */
+
+    QVector<float> vx, vy, vz;
+
+    /**
+     * @brief magnitudes - kwadrat długości wektora w kolejnych węzłach
+     */
+
+    QVector<float> magnitudes;
+
+    /**
+     * @brief clipped - znaczniki clippedByPlane i invalidSample; węzeł z dowolnym znacznikiem nie jest wyświetlany
+     * ani uwzględniany w statystykach
+     */
+
+    QVector<unsigned char> clipped;
+
+    /**
+     * @brief stepX, stepY, stepZ - odległości między sąsiednimi węzłami wzdłuż osi
+     */
+
+    float stepX = 0.0f;
+    float stepY = 0.0f;
+    float stepZ = 0.0f;
+
+    /**
+     * @brief minMagnitude, maxMagnitude - zakres magnitudes wśród węzłów, które nie zostały odcięte ani odrzucone
+     */
+
+    float minMagnitude = 0.0f;
+    float maxMagnitude = 0.0f;
+
+    /**
+     * @brief visibleCount - liczba węzłów, które nie zostały odcięte ani odrzucone
+     */
+
+    int visibleCount = 0;
+
+    /**
+     * @brief invalidCount - liczba węzłów odrzuconych z powodu nieskończonej lub nieokreślonej wartości pola
+     */
+
+    int invalidCount = 0;
+
+    /**
+     * @brief histogram - liczba widocznych węzłów dla każdej wartości normalized()
+     */
+
+    QVector<int> histogram;
+
+    /**
+     * @brief layerVisibleCounts - liczba widocznych węzłów w kolejnych warstwach X
+     */
+
+    QVector<int> layerVisibleCounts;
+
+    /**
+     * @brief size - liczba wszystkich węzłów siatki
+     */
+
+    int size() const { return x.size(); }
+
+    /**
+     * @brief layerSize - liczba węzłów w jednej warstwie X
+     */
+
+    int layerSize() const { return countY * countZ; }
+
+    /**
+     * @brief clear - usuwa wszystkie próbki
+     */
+
+    void clear();
+
+    /**
+     * @brief resize - ustawia wymiary siatki i przydziela pamięć na wszystkie węzły
+     * @return false i pusta siatka, gdy liczba węzłów przekracza maxNodeCount
+     */
+
+    bool resize(int nx, int ny, int nz);
+
+    /**
+     * @brief updateStatistics - wyznacza minMagnitude, maxMagnitude, visibleCount, invalidCount, histogram
+     * i layerVisibleCounts.
+     * Warstwy X przetwarzane są równolegle, a wyniki częściowe łączone w stałej kolejności,
+     * dzięki czemu wynik jest identyczny z jednym przebiegiem po wszystkich węzłach (updateStatisticsSinglePass).
+     * @param pool - pula wątków, nullptr - warstwy przetwarzane po kolei
+     */
+
+    void updateStatistics(WorkStealingPool *pool = nullptr);
+
+    /**
+     * @brief updateStatisticsSinglePass - wyznacza te same statystyki co updateStatistics jednym przebiegiem
+     * po wszystkich węzłach, bez wyników częściowych dla warstw; wzorzec, z którym porównywany jest wynik
+     * redukcji równoległej (FieldParameters::validate)
+     */
+
+    void updateStatisticsSinglePass();
+
+    /**
+     * @brief normalized - przelicza kwadrat długości wektora na zakres 0 - 255 według minMagnitude i maxMagnitude
+     * @param index - indeks węzła
+     */
+
+    unsigned char normalized(int index) const;
+};
+
+/**
+ * @brief sameStatistics - porównuje statystyki dwóch siatek bit po bicie
+ */
+
+bool sameStatistics(const FieldGrid& first, const FieldGrid& second);
@@ -0,0 +1,535 @@
+#include "fieldkernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VFV_X86_KERNELS 1
+#include <immintrin.h>
+#define VFV_TARGET_SSE2 __attribute__((target("sse2")))
+#define VFV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+// Stałe redukcji argumentu (pi/2 rozbite na trzy części, metoda Cody'ego-Waite'a)
+// i współczynniki wielomianów sin/cos na przedziale [-pi/4, pi/4], jak w bibliotece Cephes.
+constexpr float twoOverPi = 0.636619772367581343f;
+constexpr float pio2A = 1.5703125f;
+constexpr float pio2B = 4.837512969970703125e-4f;
+constexpr float pio2C = 7.54978995489188216e-8f;
+constexpr float sinC1 = -1.6666654611e-1f;
+constexpr float sinC2 = 8.3321608736e-3f;
+constexpr float sinC3 = -1.9515295891e-4f;
+constexpr float cosC1 = 4.166664568298827e-2f;
+constexpr float cosC2 = -1.388731625493765e-3f;
+constexpr float cosC3 = 2.443315711809948e-5f;
+
+// powyżej tej wartości trzyczęściowa redukcja traci dokładność - takie punkty liczone są skalarnie
+constexpr float maxReducedArgument = 16384.0f;
+
+// skalarne wersje jąder oraz końcówki tablic w wersjach SIMD
+constexpr BatchKernel linearScalar = evaluateField<LinearField>;
+constexpr BatchKernel productScalar = evaluateField<ProductField>;
+constexpr BatchKernel sinScalar = evaluateField<SinField>;
+constexpr BatchKernel tanScalar = evaluateField<TanField>;
+
+#ifdef VFV_X86_KERNELS
+
+// Wynik jąder sin i tan w punkcie nie zależy od tego, z którymi punktami trafił do jednego wektora: punkty spoza
+// zakresu redukcji poprawiane są skalarnie pojedynczo, a końcówka tablicy krótsza niż wektor liczona jest tym samym
+// blokiem po uzupełnieniu zerami. Dzięki temu próbkowanie wybranych węzłów daje te same wartości co całych warstw.
+
+struct PaddedTail
+{
+    float in[3][8] = {};
+    float out[3][8];
+
+    PaddedTail(const float *x, const float *y, const float *z, int count) {
+        std::copy(x, x + count, in[0]);
+        std::copy(y, y + count, in[1]);
+        std::copy(z, z + count, in[2]);
+    }
+
+    void store(float *vx, float *vy, float *vz, int count) const {
+        std::copy(out[0], out[0] + count, vx);
+        std::copy(out[1], out[1] + count, vy);
+        std::copy(out[2], out[2] + count, vz);
+    }
+};
+
+// ---- SSE2, 4 punkty na raz ----
+
+struct Reduced128
+{
+    __m128 sin;   // sin(r)
+    __m128 cos;   // cos(r)
+    __m128i quadrant;
+};
+
+VFV_TARGET_SSE2 inline Reduced128 reduce128(__m128 v) {
+    const __m128i j = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(twoOverPi)));
+    const __m128 fj = _mm_cvtepi32_ps(j);
+    __m128 r = _mm_sub_ps(v, _mm_mul_ps(fj, _mm_set1_ps(pio2A)));
+    r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(pio2B)));
+    r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(pio2C)));
+    const __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(sinC3)), _mm_set1_ps(sinC2));
+    s = _mm_add_ps(_mm_mul_ps(s, r2), _mm_set1_ps(sinC1));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, r2), r), r);
+
+    __m128 c = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(cosC3)), _mm_set1_ps(cosC2));
+    c = _mm_add_ps(_mm_mul_ps(c, r2), _mm_set1_ps(cosC1));
+    c = _mm_mul_ps(_mm_mul_ps(c, r2), r2);
+    c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+    return Reduced128{s, c, _mm_and_si128(j, _mm_set1_epi32(3))};
+}
+
+// maska punktów, których argument przekracza maxReducedArgument
+VFV_TARGET_SSE2 inline int outOfRange128(__m128 v) {
+    const __m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+    return _mm_movemask_ps(_mm_cmpgt_ps(magnitude, _mm_set1_ps(maxReducedArgument)));
+}
+
+VFV_TARGET_SSE2 inline __m128 sin128(__m128 v) {
+    const Reduced128 red = reduce128(v);
+    const __m128 odd = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(red.quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    const __m128 result = _mm_or_ps(_mm_and_ps(odd, red.cos), _mm_andnot_ps(odd, red.sin));
+    const __m128 sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(red.quadrant, _mm_set1_epi32(2)), 30));
+    return _mm_xor_ps(result, sign);
+}
+
+VFV_TARGET_SSE2 inline __m128 tan128(__m128 v) {
+    const Reduced128 red = reduce128(v);
+    const __m128 odd = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(red.quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    const __m128 even = _mm_div_ps(red.sin, red.cos);
+    const __m128 oddResult = _mm_xor_ps(_mm_div_ps(red.cos, red.sin), _mm_set1_ps(-0.0f));
+    return _mm_or_ps(_mm_and_ps(odd, oddResult), _mm_andnot_ps(odd, even));
+}
+
+VFV_TARGET_SSE2 void linearSse2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                int count, float a, float b, float c) {
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b), vc = _mm_set1_ps(c);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(vx + i, _mm_mul_ps(va, _mm_loadu_ps(x + i)));
+        _mm_storeu_ps(vy + i, _mm_mul_ps(vb, _mm_loadu_ps(y + i)));
+        _mm_storeu_ps(vz + i, _mm_mul_ps(vc, _mm_loadu_ps(z + i)));
+    }
+    linearScalar(x + i, y + i, z + i, vx + i, vy + i, vz + i, count - i, a, b, c);
+}
+
+VFV_TARGET_SSE2 void productSse2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                 int count, float a, float b, float c) {
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b), vc = _mm_set1_ps(c);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        _mm_storeu_ps(vx + i, _mm_mul_ps(va, _mm_mul_ps(py, pz)));
+        _mm_storeu_ps(vy + i, _mm_mul_ps(vb, _mm_mul_ps(px, pz)));
+        _mm_storeu_ps(vz + i, _mm_mul_ps(vc, _mm_mul_ps(px, py)));
+    }
+    productScalar(x + i, y + i, z + i, vx + i, vy + i, vz + i, count - i, a, b, c);
+}
+
+VFV_TARGET_SSE2 inline void sinBlock128(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                        float a, float b, float c) {
+    const __m128 ax = _mm_mul_ps(_mm_set1_ps(a), _mm_loadu_ps(x)), py = _mm_loadu_ps(y), pz = _mm_loadu_ps(z);
+    _mm_storeu_ps(vx, sin128(ax));
+    _mm_storeu_ps(vy, _mm_mul_ps(_mm_set1_ps(b), sin128(py)));
+    _mm_storeu_ps(vz, _mm_mul_ps(_mm_set1_ps(c), sin128(pz)));
+    const int outside = outOfRange128(ax) | outOfRange128(py) | outOfRange128(pz);
+    for (int k = 0; outside && k < 4; k++) {
+        if (outside & (1 << k)) {
+            sinScalar(x + k, y + k, z + k, vx + k, vy + k, vz + k, 1, a, b, c);
+        }
+    }
+}
+
+VFV_TARGET_SSE2 void sinSse2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                             int count, float a, float b, float c) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        sinBlock128(x + i, y + i, z + i, vx + i, vy + i, vz + i, a, b, c);
+    }
+    if (i < count) {
+        PaddedTail tail(x + i, y + i, z + i, count - i);
+        sinBlock128(tail.in[0], tail.in[1], tail.in[2], tail.out[0], tail.out[1], tail.out[2], a, b, c);
+        tail.store(vx + i, vy + i, vz + i, count - i);
+    }
+}
+
+VFV_TARGET_SSE2 inline void tanBlock128(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                        float a, float b, float c) {
+    const __m128 px = _mm_loadu_ps(x), py = _mm_loadu_ps(y), pz = _mm_loadu_ps(z);
+    _mm_storeu_ps(vx, _mm_mul_ps(_mm_set1_ps(a), tan128(px)));
+    _mm_storeu_ps(vy, _mm_mul_ps(_mm_set1_ps(b), tan128(py)));
+    _mm_storeu_ps(vz, _mm_mul_ps(_mm_set1_ps(c), tan128(pz)));
+    const int outside = outOfRange128(px) | outOfRange128(py) | outOfRange128(pz);
+    for (int k = 0; outside && k < 4; k++) {
+        if (outside & (1 << k)) {
+            tanScalar(x + k, y + k, z + k, vx + k, vy + k, vz + k, 1, a, b, c);
+        }
+    }
+}
+
+VFV_TARGET_SSE2 void tanSse2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                             int count, float a, float b, float c) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        tanBlock128(x + i, y + i, z + i, vx + i, vy + i, vz + i, a, b, c);
+    }
+    if (i < count) {
+        PaddedTail tail(x + i, y + i, z + i, count - i);
+        tanBlock128(tail.in[0], tail.in[1], tail.in[2], tail.out[0], tail.out[1], tail.out[2], a, b, c);
+        tail.store(vx + i, vy + i, vz + i, count - i);
+    }
+}
+
+// ---- AVX2, 8 punktów na raz ----
+
+struct Reduced256
+{
+    __m256 sin;
+    __m256 cos;
+    __m256i quadrant;
+};
+
+VFV_TARGET_AVX2 inline Reduced256 reduce256(__m256 v) {
+    const __m256i j = _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(twoOverPi)));
+    const __m256 fj = _mm256_cvtepi32_ps(j);
+    __m256 r = _mm256_sub_ps(v, _mm256_mul_ps(fj, _mm256_set1_ps(pio2A)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(fj, _mm256_set1_ps(pio2B)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(fj, _mm256_set1_ps(pio2C)));
+    const __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(sinC3)), _mm256_set1_ps(sinC2));
+    s = _mm256_add_ps(_mm256_mul_ps(s, r2), _mm256_set1_ps(sinC1));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, r2), r), r);
+
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(cosC3)), _mm256_set1_ps(cosC2));
+    c = _mm256_add_ps(_mm256_mul_ps(c, r2), _mm256_set1_ps(cosC1));
+    c = _mm256_mul_ps(_mm256_mul_ps(c, r2), r2);
+    c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+    return Reduced256{s, c, _mm256_and_si256(j, _mm256_set1_epi32(3))};
+}
+
+VFV_TARGET_AVX2 inline int outOfRange256(__m256 v) {
+    const __m256 magnitude = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+    return _mm256_movemask_ps(_mm256_cmp_ps(magnitude, _mm256_set1_ps(maxReducedArgument), _CMP_GT_OQ));
+}
+
+VFV_TARGET_AVX2 inline __m256 sin256(__m256 v) {
+    const Reduced256 red = reduce256(v);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(red.quadrant, one), one));
+    const __m256 result = _mm256_blendv_ps(red.sin, red.cos, odd);
+    const __m256 sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(red.quadrant, _mm256_set1_epi32(2)), 30));
+    return _mm256_xor_ps(result, sign);
+}
+
+VFV_TARGET_AVX2 inline __m256 tan256(__m256 v) {
+    const Reduced256 red = reduce256(v);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(red.quadrant, one), one));
+    const __m256 even = _mm256_div_ps(red.sin, red.cos);
+    const __m256 oddResult = _mm256_xor_ps(_mm256_div_ps(red.cos, red.sin), _mm256_set1_ps(-0.0f));
+    return _mm256_blendv_ps(even, oddResult, odd);
+}
+
+VFV_TARGET_AVX2 void linearAvx2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                int count, float a, float b, float c) {
+    const __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b), vc = _mm256_set1_ps(c);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(vx + i, _mm256_mul_ps(va, _mm256_loadu_ps(x + i)));
+        _mm256_storeu_ps(vy + i, _mm256_mul_ps(vb, _mm256_loadu_ps(y + i)));
+        _mm256_storeu_ps(vz + i, _mm256_mul_ps(vc, _mm256_loadu_ps(z + i)));
+    }
+    linearScalar(x + i, y + i, z + i, vx + i, vy + i, vz + i, count - i, a, b, c);
+}
+
+VFV_TARGET_AVX2 void productAvx2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                 int count, float a, float b, float c) {
+    const __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b), vc = _mm256_set1_ps(c);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        _mm256_storeu_ps(vx + i, _mm256_mul_ps(va, _mm256_mul_ps(py, pz)));
+        _mm256_storeu_ps(vy + i, _mm256_mul_ps(vb, _mm256_mul_ps(px, pz)));
+        _mm256_storeu_ps(vz + i, _mm256_mul_ps(vc, _mm256_mul_ps(px, py)));
+    }
+    productScalar(x + i, y + i, z + i, vx + i, vy + i, vz + i, count - i, a, b, c);
+}
+
+VFV_TARGET_AVX2 inline void sinBlock256(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                        float a, float b, float c) {
+    const __m256 ax = _mm256_mul_ps(_mm256_set1_ps(a), _mm256_loadu_ps(x));
+    const __m256 py = _mm256_loadu_ps(y), pz = _mm256_loadu_ps(z);
+    _mm256_storeu_ps(vx, sin256(ax));
+    _mm256_storeu_ps(vy, _mm256_mul_ps(_mm256_set1_ps(b), sin256(py)));
+    _mm256_storeu_ps(vz, _mm256_mul_ps(_mm256_set1_ps(c), sin256(pz)));
+    const int outside = outOfRange256(ax) | outOfRange256(py) | outOfRange256(pz);
+    for (int k = 0; outside && k < 8; k++) {
+        if (outside & (1 << k)) {
+            sinScalar(x + k, y + k, z + k, vx + k, vy + k, vz + k, 1, a, b, c);
+        }
+    }
+}
+
+VFV_TARGET_AVX2 void sinAvx2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                             int count, float a, float b, float c) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        sinBlock256(x + i, y + i, z + i, vx + i, vy + i, vz + i, a, b, c);
+    }
+    if (i < count) {
+        PaddedTail tail(x + i, y + i, z + i, count - i);
+        sinBlock256(tail.in[0], tail.in[1], tail.in[2], tail.out[0], tail.out[1], tail.out[2], a, b, c);
+        tail.store(vx + i, vy + i, vz + i, count - i);
+    }
+}
+
+VFV_TARGET_AVX2 inline void tanBlock256(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                                        float a, float b, float c) {
+    const __m256 px = _mm256_loadu_ps(x), py = _mm256_loadu_ps(y), pz = _mm256_loadu_ps(z);
+    _mm256_storeu_ps(vx, _mm256_mul_ps(_mm256_set1_ps(a), tan256(px)));
+    _mm256_storeu_ps(vy, _mm256_mul_ps(_mm256_set1_ps(b), tan256(py)));
+    _mm256_storeu_ps(vz, _mm256_mul_ps(_mm256_set1_ps(c), tan256(pz)));
+    const int outside = outOfRange256(px) | outOfRange256(py) | outOfRange256(pz);
+    for (int k = 0; outside && k < 8; k++) {
+        if (outside & (1 << k)) {
+            tanScalar(x + k, y + k, z + k, vx + k, vy + k, vz + k, 1, a, b, c);
+        }
+    }
+}
+
+VFV_TARGET_AVX2 void tanAvx2(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                             int count, float a, float b, float c) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        tanBlock256(x + i, y + i, z + i, vx + i, vy + i, vz + i, a, b, c);
+    }
+    if (i < count) {
+        PaddedTail tail(x + i, y + i, z + i, count - i);
+        tanBlock256(tail.in[0], tail.in[1], tail.in[2], tail.out[0], tail.out[1], tail.out[2], a, b, c);
+        tail.store(vx + i, vy + i, vz + i, count - i);
+    }
+}
+
+#endif
+
+constexpr int fieldKindCount = 4;
+constexpr int isaCount = 3;
+
+const BatchKernel kernelTable[fieldKindCount][isaCount] = {
+#ifdef VFV_X86_KERNELS
+    {linearScalar, linearSse2, linearAvx2},
+    {productScalar, productSse2, productAvx2},
+    {sinScalar, sinSse2, sinAvx2},
+    {tanScalar, tanSse2, tanAvx2},
+#else
+    {linearScalar, linearScalar, linearScalar},
+    {productScalar, productScalar, productScalar},
+    {sinScalar, sinScalar, sinScalar},
+    {tanScalar, tanScalar, tanScalar},
+#endif
+};
+
+}
+
+ParameterDependence parameterDependence(FieldKind kind, int component) {
+    // składowa x pola sin to sin(a*x) - jedyna, której nie da się przeskalować
+    static const ParameterDependence table[fieldKindCount][3] = {
+        {{1, 0}, {2, 1}, {4, 2}},
+        {{1, 0}, {2, 1}, {4, 2}},
+        {{1, -1}, {2, 1}, {4, 2}},
+        {{1, 0}, {2, 1}, {4, 2}},
+    };
+    return table[static_cast<int>(kind)][component];
+}
+
+KernelIsa supportedIsa() {
+#ifdef VFV_X86_KERNELS
+    static const KernelIsa isa = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return KernelIsa::Avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return KernelIsa::Sse2;
+        }
+        return KernelIsa::Scalar;
+    }();
+    return isa;
+#else
+    return KernelIsa::Scalar;
+#endif
+}
+
+const char *isaName(KernelIsa isa) {
+    switch (isa) {
+    case KernelIsa::Avx2:
+        return "AVX2";
+    case KernelIsa::Sse2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
+
+BatchKernel batchKernel(FieldKind kind, KernelIsa isa) {
+    const KernelIsa best = supportedIsa();
+    if (static_cast<int>(isa) > static_cast<int>(best)) {
+        isa = best;
+    }
+    return kernelTable[static_cast<int>(kind)][static_cast<int>(isa)];
+}
+
+BatchKernel batchKernel(FieldKind kind) {
+    return batchKernel(kind, supportedIsa());
+}
+
+std::string benchmarkKernels(int pointCount) {
+    static const char *kindNames[fieldKindCount] = {"linear", "product", "sin", "tan"};
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::vector<float> x(pointCount), y(pointCount), z(pointCount);
+    for (int i = 0; i < pointCount; i++) {
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+        z[i] = distribution(generator);
+    }
+    std::vector<float> vx(pointCount), vy(pointCount), vz(pointCount);
+    std::vector<float> rx(pointCount), ry(pointCount), rz(pointCount);
+
+    std::string report = "kernel   isa      Mpoints/s  max rel. error\n";
+    char line[128];
+    for (int kind = 0; kind < fieldKindCount; kind++) {
+        kernelTable[kind][0](x.data(), y.data(), z.data(), rx.data(), ry.data(), rz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+        for (int isa = 0; isa <= static_cast<int>(supportedIsa()); isa++) {
+            const BatchKernel kernel = kernelTable[kind][isa];
+            int runs = 0;
+            const auto start = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::steady_clock::duration::zero();
+            do {
+                kernel(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+                runs++;
+                elapsed = std::chrono::steady_clock::now() - start;
+            } while (elapsed < std::chrono::milliseconds(200));
+
+            float maxError = 0.0f;
+            for (int i = 0; i < pointCount; i++) {
+                const float reference[3] = {rx[i], ry[i], rz[i]};
+                const float value[3] = {vx[i], vy[i], vz[i]};
+                for (int k = 0; k < 3; k++) {
+                    const float error = std::fabs(value[k] - reference[k]) / std::max(1.0f, std::fabs(reference[k]));
+                    maxError = std::max(maxError, error);
+                }
+            }
+
+            const double seconds = std::chrono::duration<double>(elapsed).count();
+            std::snprintf(line, sizeof(line), "%-8s %-8s %9.1f  %.2e\n", kindNames[kind],
+                          isaName(static_cast<KernelIsa>(isa)),
+                          static_cast<double>(runs) * pointCount / seconds / 1.0e6, static_cast<double>(maxError));
+            report += line;
+        }
+    }
+    return report;
+}
+
+namespace {
+
+// odpowiednik QVector3D, dzięki któremu pomiar nie zależy od Qt
+struct Vector3
+{
+    float x;
+    float y;
+    float z;
+};
+
+using PointFunction = std::function<Vector3(const Vector3 &&, float, float, float)>;
+
+template <typename Field>
+PointFunction pointFunction() {
+    return [](const Vector3 &&vec, float a, float b, float c) {
+        Vector3 result;
+        Field::apply(vec.x, vec.y, vec.z, a, b, c, result.x, result.y, result.z);
+        return result;
+    };
+}
+
+}
+
+std::string benchmarkDispatch(int pointCount) {
+    static const char *kindNames[fieldKindCount] = {"linear", "product", "sin", "tan"};
+    const PointFunction functions[fieldKindCount] = {
+        pointFunction<LinearField>(), pointFunction<ProductField>(), pointFunction<SinField>(), pointFunction<TanField>()
+    };
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::vector<float> x(pointCount), y(pointCount), z(pointCount);
+    for (int i = 0; i < pointCount; i++) {
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+        z[i] = distribution(generator);
+    }
+    std::vector<float> vx(pointCount), vy(pointCount), vz(pointCount), magnitudes(pointCount);
+
+    auto measure = [&](const std::function<void()> &run) {
+        int runs = 0;
+        const auto start = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::steady_clock::duration::zero();
+        do {
+            run();
+            runs++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed < std::chrono::milliseconds(200));
+        return static_cast<double>(runs) * pointCount / std::chrono::duration<double>(elapsed).count() / 1.0e6;
+    };
+    // długość liczona w obu wariantach, tak jak w pętli próbkowania
+    auto computeMagnitudes = [&]() {
+        for (int i = 0; i < pointCount; i++) {
+            magnitudes[i] = vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i];
+        }
+    };
+
+    std::string report = "field    std::function/point  template batch  best kernel (" + std::string(isaName(supportedIsa()))
+                         + ")  Mpoints/s\n";
+    char line[160];
+    for (int kind = 0; kind < fieldKindCount; kind++) {
+        const PointFunction &function = functions[kind];
+        const double perPoint = measure([&]() {
+            for (int i = 0; i < pointCount; i++) {
+                const Vector3 vec = function(Vector3{x[i], y[i], z[i]}, 2.0f, 1.5f, 0.5f);
+                vx[i] = vec.x;
+                vy[i] = vec.y;
+                vz[i] = vec.z;
+            }
+            computeMagnitudes();
+        });
+        const BatchKernel scalar = kernelTable[kind][0];
+        const double batch = measure([&]() {
+            scalar(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+            computeMagnitudes();
+        });
+        const BatchKernel best = batchKernel(static_cast<FieldKind>(kind));
+        const double simd = measure([&]() {
+            best(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+            computeMagnitudes();
+        });
+        std::snprintf(line, sizeof(line), "%-8s %19.1f  %14.1f  %17.1f\n", kindNames[kind], perPoint, batch, simd);
+        report += line;
+    }
+    return report;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+
+/**
+ * @brief FieldKind - wbudowane pola wektorowe, w kolejności listy wyboru funkcji
+ */
+
+enum class FieldKind
+{
+    Linear = 0,   ///< F(x,y,z) = (a*x, b*y, c*z)
+    Product = 1,  ///< F(x,y,z) = (a*y*z, b*x*z, c*x*y)
+    Sin = 2,      ///< F(x,y,z) = (sin(a*x), b*sin(y), c*sin(z))
+    Tan = 3       ///< F(x,y,z) = (a*tan(x), b*tan(y), c*tan(z))
+};
+
+/**
+ * @brief KernelIsa - zestaw instrukcji, dla którego skompilowano jądro obliczeniowe
+ */
+
+enum class KernelIsa
+{
+    Scalar = 0,
+    Sse2 = 1,
+    Avx2 = 2
+};
+
+/**
+ * @brief BatchKernel - wyznacza wektory pola dla count punktów podanych jako struktura tablic
+ */
+
+using BatchKernel = void (*)(const float *x, const float *y, const float *z,
+                             float *vx, float *vy, float *vz, int count,
+                             float a, float b, float c);
+
+/**
+ * @brief ParameterDependence - zależność jednej składowej pola od stałych a, b, c
+ */
+
+struct ParameterDependence
+{
+    unsigned char parameters; ///< maska używanych stałych: 1 - a, 2 - b, 4 - c
+    signed char scale;        ///< 0, 1, 2 - składowa jest iloczynem a, b lub c i wyrażenia od nich niezależnego, -1 - inna zależność
+
+    /**
+     * @brief separable - czy składową można wyznaczyć raz i przy zmianie stałych tylko przeskalować
+     */
+
+    bool separable() const { return parameters == 0 || (scale >= 0 && parameters == 1 << scale); }
+};
+
+/**
+ * @brief parameterDependence - deklaracja zależności składowej wbudowanego pola od stałych a, b, c
+ * @param kind - pole wektorowe
+ * @param component - 0 - x, 1 - y, 2 - z
+ */
+
+ParameterDependence parameterDependence(FieldKind kind, int component);
+
+/**
+ * @brief LinearField, ProductField, SinField, TanField - wbudowane pola jako typy funktorów.
+ * Wywołanie apply jest rozwijane w miejscu użycia, więc pętla evaluateField<Field> nie zawiera żadnego
+ * wywołania pośredniego i może zostać zwektoryzowana przez kompilator. Stała mnoży składową jako ostatnia,
+ * dzięki czemu składowa przeskalowana z bazy (parameterDependence) jest identyczna z wyliczoną od nowa.
+ */
+
+struct LinearField
+{
+    static void apply(float x, float y, float z, float a, float b, float c, float &vx, float &vy, float &vz) {
+        vx = a * x;
+        vy = b * y;
+        vz = c * z;
+    }
+};
+
+struct ProductField
+{
+    static void apply(float x, float y, float z, float a, float b, float c, float &vx, float &vy, float &vz) {
+        vx = a * (y * z);
+        vy = b * (x * z);
+        vz = c * (x * y);
+    }
+};
+
+struct SinField
+{
+    static void apply(float x, float y, float z, float a, float b, float c, float &vx, float &vy, float &vz) {
+        vx = std::sin(a * x);
+        vy = b * std::sin(y);
+        vz = c * std::sin(z);
+    }
+};
+
+struct TanField
+{
+    static void apply(float x, float y, float z, float a, float b, float c, float &vx, float &vy, float &vz) {
+        vx = a * std::tan(x);
+        vy = b * std::tan(y);
+        vz = c * std::tan(z);
+    }
+};
+
+/**
+ * @brief evaluateField - skalarne jądro wsadowe dla pola podanego jako typ funktora, ma postać BatchKernel
+ */
+
+template <typename Field>
+void evaluateField(const float *x, const float *y, const float *z,
+                   float *vx, float *vy, float *vz, int count,
+                   float a, float b, float c) {
+    for (int i = 0; i < count; i++) {
+        Field::apply(x[i], y[i], z[i], a, b, c, vx[i], vy[i], vz[i]);
+    }
+}
+
+/**
+ * @brief supportedIsa - najszerszy zestaw instrukcji obsługiwany przez bieżący procesor
+ */
+
+KernelIsa supportedIsa();
+
+/**
+ * @brief isaName - nazwa zestawu instrukcji do raportów
+ */
+
+const char *isaName(KernelIsa isa);
+
+/**
+ * @brief batchKernel - zwraca jądro dla danego pola i zestawu instrukcji
+ * @param kind - pole wektorowe
+ * @param isa - zestaw instrukcji; jeśli procesor go nie obsługuje, zwracane jest najszersze obsługiwane jądro
+ */
+
+BatchKernel batchKernel(FieldKind kind, KernelIsa isa);
+
+/**
+ * @brief batchKernel - zwraca najszybsze jądro dla danego pola dostępne na bieżącym procesorze
+ */
+
+BatchKernel batchKernel(FieldKind kind);
+
+/**
+ * @brief benchmarkKernels - mierzy przepustowość (punkty na sekundę) każdego jądra dla każdego obsługiwanego zestawu instrukcji
+ * @param pointCount - liczba punktów w jednym przebiegu
+ * @return tabela wyników w postaci tekstu
+ */
+
+std::string benchmarkKernels(int pointCount);
+
+/**
+ * @brief benchmarkDispatch - porównuje wywołanie pola przez std::function dla każdego punktu (jak dawne
+ * Scatter::m_function) z jądrami wsadowymi evaluateField<Field> i najszybszym jądrem SIMD
+ * @param pointCount - liczba punktów w jednym przebiegu
+ * @return tabela wyników w postaci tekstu
+ */
+
+std::string benchmarkDispatch(int pointCount);
@@ -0,0 +1,805 @@
+#include "fieldpipeline.h"
+#include <QtCore/qmath.h>
+#include <QtCore/QElapsedTimer>
+
+#include "sampledfield.h"
+#include "workstealingpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+constexpr float doublePi = static_cast<float>(M_PI) * 2.0f;
+constexpr float radiansToDegrees = 360.0f / doublePi;
+
+static float minimum(float a, float b, float c) {
+    if (a < b) {
+        if (a < c) {
+            return a;
+        }
+    }
+    if (b < c) {
+        return b;
+    } else {
+        return c;
+    }
+}
+
+static QQuaternion arrowRotation(const QVector3D &vec, float xr, float zr) {
+    auto up = QVector3D(0, 1, 0);
+    auto angle = qAcos(static_cast<double>(QVector3D::dotProduct(up, vec) / vec.length()));
+    auto axis = QVector3D::crossProduct(up, vec);
+    auto rot = QQuaternion::fromAxisAndAngle(axis, angle * static_cast<double>(radiansToDegrees));
+    auto roty = QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f,
+                                              (xr >= 0.0f && zr >= 0.0f) || (xr <= 0.0f && zr <= 0.0f)
+                                              ? 90.0f : -90.0f);
+    if (xr == 0.0f) {
+        roty = QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, 180.0f);
+        return roty * rot;
+    } else if (zr == 0.0f) {
+        return rot;
+    }
+    return roty * rot;
+}
+
+bool FieldParameters::isAbovePlain(float x, float y, float z) const {
+    return ((-plainD - (plainA * x) - (plainB * y)) / plainC) < z;
+}
+
+static void forEachSlab(WorkStealingPool *pool, int count, const std::function<void(int, int)> &body) {
+    if (pool) {
+        pool->parallelFor(0, count, 1, body);
+    } else {
+        body(0, count);
+    }
+}
+
+namespace {
+
+// Wykonawcy pola dla całej warstwy węzłów. Szablony próbkowania i budowania strzałek są konkretyzowane
+// osobno dla każdego wykonawcy i wariantu odcinania, a wybór następuje raz na regenerację, nie raz na punkt.
+
+struct KernelEvaluator
+{
+    BatchKernel kernel;
+
+    void operator()(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                    int count, float a, float b, float c) const {
+        kernel(x, y, z, vx, vy, vz, count, a, b, c);
+    }
+};
+
+struct ExpressionEvaluator
+{
+    const FieldExpression *expression;
+
+    void operator()(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                    int count, float a, float b, float c) const {
+        expression->evaluate(x, y, z, vx, vy, vz, count, a, b, c);
+    }
+};
+
+struct SampledEvaluator
+{
+    const SampledField *field;
+
+    void operator()(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                    int count, float a, float b, float c) const {
+        field->evaluate(x, y, z, vx, vy, vz, count, a, b, c);
+    }
+};
+
+struct SampleBuffers
+{
+    float *x;
+    float *y;
+    float *z;
+    float *vx;
+    float *vy;
+    float *vz;
+    float *magnitudes;
+    unsigned char *clipped;
+};
+
+template <typename Evaluator, bool CutByPlain>
+void sampleLayers(const FieldParameters &params, const Evaluator &evaluate, const SampleBuffers &out,
+                  int firstLayer, int lastLayer, int ny, int nz, float stepx, float stepy, float stepz,
+                  const CancelCheck &cancelled) {
+    for (int ix = firstLayer; ix < lastLayer; ix++) {
+        if (cancelled()) {
+            return;
+        }
+        const float xr = params.xRange.first + ix * stepx;
+        const int first = ix * ny * nz;
+        const int last = first + ny * nz;
+        for (int iy = 0; iy < ny; iy++) {
+            const float yr = params.yRange.first + iy * stepy;
+            int i = first + iy * nz;
+            for (int iz = 0; iz < nz; iz++, i++) {
+                out.x[i] = xr;
+                out.y[i] = yr;
+                out.z[i] = params.zRange.first + iz * stepz;
+            }
+        }
+        evaluate(out.x + first, out.y + first, out.z + first, out.vx + first, out.vy + first, out.vz + first,
+                 last - first, params.a, params.b, params.c);
+        for (int i = first; i < last; i++) {
+            out.magnitudes[i] = out.vx[i] * out.vx[i] + out.vy[i] * out.vy[i] + out.vz[i] * out.vz[i];
+            out.clipped[i] = FieldGrid::sampleFlag(out.magnitudes[i]);
+        }
+        if (CutByPlain) {
+            for (int i = first; i < last; i++) {
+                out.clipped[i] |= params.isAbovePlain(out.x[i], out.y[i], out.z[i]) ? FieldGrid::clippedByPlane : 0;
+            }
+        }
+    }
+}
+
+template <typename Evaluator>
+void sampleAllLayers(const FieldParameters &params, const Evaluator &evaluate, const SampleBuffers &out,
+                     int nx, int ny, int nz, float stepx, float stepy, float stepz, const CancelCheck &cancelled) {
+    const auto layers = params.cutByPlain ? sampleLayers<Evaluator, true> : sampleLayers<Evaluator, false>;
+    forEachSlab(params.pool.get(), nx, [&](int firstLayer, int lastLayer) {
+        layers(params, evaluate, out, firstLayer, lastLayer, ny, nz, stepx, stepy, stepz, cancelled);
+    });
+}
+
+// Sposoby wyznaczania skalowania strzałki (lista wyboru długości), również wybierane raz na regenerację.
+
+struct GridScaling
+{
+    float max;
+    float minStep;
+
+    QVector3D operator()(float magnitude) const {
+        return QVector3D(0.05f, magnitude / max * minStep / 10, 0.05f);
+    }
+};
+
+struct FixedScaling
+{
+    QVector3D operator()(float) const {
+        return QVector3D(0.07f, 0.12f, 0.07f);
+    }
+};
+
+struct SliderScaling
+{
+    float max;
+    int arrowLength;
+
+    QVector3D operator()(float magnitude) const {
+        return QVector3D(0.05f, arrowLength / 300.0f * magnitude / max, 0.05f);
+    }
+};
+
+template <typename Scaling>
+void styleGlyphLayers(const FieldParameters &params, const FieldGrid &grid, const QVector<int> &offsets,
+                      Glyph *out, const Scaling &scaling) {
+    const int layer = grid.layerSize();
+    forEachSlab(params.pool.get(), grid.countX, [&](int firstLayer, int lastLayer) {
+        for (int l = firstLayer; l < lastLayer; l++) {
+            Glyph *glyph = out + offsets[l];
+            for (int i = l * layer; i < (l + 1) * layer; i++) {
+                if (grid.clipped[i]) {
+                    continue;
+                }
+                glyph->scaling = scaling(grid.magnitudes[i]);
+                glyph->color = grid.normalized(i);
+                glyph++;
+            }
+        }
+    });
+}
+
+// miejsce strzałek każdej warstwy wynika z liczby widocznych węzłów w warstwach poprzednich
+QVector<int> layerOffsets(const FieldGrid &grid) {
+    QVector<int> offsets(grid.countX + 1, 0);
+    for (int l = 0; l < grid.countX; l++) {
+        offsets[l + 1] = offsets[l] + grid.layerVisibleCounts[l];
+    }
+    return offsets;
+}
+
+}
+
+static bool resizeGrid(const FieldParameters &params, FieldGrid &grid) {
+    if (!grid.resize(params.xSegments + 1, params.ySegments + 1, params.zSegments + 1)) {
+        return false;
+    }
+    grid.stepX = (params.xRange.second - params.xRange.first) / params.xSegments;
+    grid.stepY = (params.yRange.second - params.yRange.first) / params.ySegments;
+    grid.stepZ = (params.zRange.second - params.zRange.first) / params.zSegments;
+    return true;
+}
+
+bool limitGridSize(FieldParameters &params) {
+    int *segments[3] = {&params.xSegments, &params.ySegments, &params.zSegments};
+    auto nodes = [&]() { return FieldGrid::nodeCount(*segments[0] + 1, *segments[1] + 1, *segments[2] + 1); };
+    if (nodes() <= FieldGrid::maxNodeCount) {
+        return false;
+    }
+    // osie dłuższe niż jeden podprzedział zmniejszane są w tej samej proporcji; oś skrócona do jednego
+    // podprzedziału nie może już oddać węzłów, więc proporcja dla pozostałych wyznaczana jest ponownie
+    for (int pass = 0; pass < 3 && nodes() > FieldGrid::maxNodeCount; pass++) {
+        const int longAxes = static_cast<int>(std::count_if(std::begin(segments), std::end(segments),
+                                                            [](const int *count) { return *count > 1; }));
+        const double factor = std::pow(static_cast<double>(FieldGrid::maxNodeCount) / nodes(), 1.0 / longAxes);
+        for (int *count : segments) {
+            if (*count > 1) {
+                *count = static_cast<int>(qMax(1.0, std::floor((*count + 1.0) * factor) - 1.0));
+            }
+        }
+    }
+    // zaokrąglenie w dół może zostawić siatkę minimalnie za dużą tylko przy skrajnych proporcjach
+    while (nodes() > FieldGrid::maxNodeCount) {
+        int *longest = *std::max_element(std::begin(segments), std::end(segments),
+                                         [](const int *a, const int *b) { return *a < *b; });
+        const qint64 others = nodes() / (*longest + 1);
+        *longest = static_cast<int>(qMax<qint64>(1, FieldGrid::maxNodeCount / others - 1));
+    }
+    return true;
+}
+
+static bool sampleNodes(const FieldParameters &params, FieldGrid &grid, const CancelCheck &cancelled) {
+    if (!resizeGrid(params, grid)) {
+        return false;
+    }
+    const int nx = grid.countX;
+    const int ny = grid.countY;
+    const int nz = grid.countZ;
+    const float stepx = grid.stepX;
+    const float stepy = grid.stepY;
+    const float stepz = grid.stepZ;
+
+    const SampleBuffers out = {grid.x.data(), grid.y.data(), grid.z.data(),
+                               grid.vx.data(), grid.vy.data(), grid.vz.data(),
+                               grid.magnitudes.data(), grid.clipped.data()};
+
+    // współrzędne liczone z indeksu węzła, a nie przez sumowanie kroku, więc podział
+    // na warstwy nie zmienia wyniku; każda warstwa X zapisuje tylko swój fragment tablic
+    if (params.sampled) {
+        sampleAllLayers(params, SampledEvaluator{params.sampled.get()}, out, nx, ny, nz, stepx, stepy, stepz,
+                        cancelled);
+    } else if (params.expression && !params.native) {
+        sampleAllLayers(params, ExpressionEvaluator{params.expression.get()}, out, nx, ny, nz, stepx, stepy, stepz, cancelled);
+    } else {
+        sampleAllLayers(params, KernelEvaluator{params.kernel}, out, nx, ny, nz, stepx, stepy, stepz, cancelled);
+    }
+    return !cancelled();
+}
+
+bool sampleField(const FieldParameters &params, FieldGrid &grid, const CancelCheck &cancelled) {
+    if (!sampleNodes(params, grid, cancelled)) {
+        return false;
+    }
+    grid.updateStatistics(params.pool.get());
+    return true;
+}
+
+static ParameterDependence componentDependence(const FieldParameters &params, int component) {
+    if (params.sampled) {
+        // składowe danych z pliku mnożone są przez a, b, c jak w polu liniowym
+        return parameterDependence(FieldKind::Linear, component);
+    }
+    return params.expression ? params.expression->parameterDependence(component)
+                             : parameterDependence(params.kind, component);
+}
+
+bool FieldBasis::matches(const FieldParameters &params) const {
+    return source.xRange == params.xRange && source.yRange == params.yRange && source.zRange == params.zRange
+           && source.xSegments == params.xSegments && source.ySegments == params.ySegments
+           && source.zSegments == params.zSegments
+           && source.kind == params.kind && source.kernel == params.kernel
+           && source.expression == params.expression && source.native == params.native
+           && source.sampled == params.sampled;
+}
+
+// czy odcięcia zapisane w bazie wyznaczono dla innej płaszczyzny niż ta z params
+static bool clippingChanged(const FieldParameters &params, const FieldParameters &source) {
+    if (params.cutByPlain != source.cutByPlain) {
+        return true;
+    }
+    return params.cutByPlain && (source.plainA != params.plainA || source.plainB != params.plainB
+                                 || source.plainC != params.plainC || source.plainD != params.plainD);
+}
+
+// wybiera składowe zapisywane jako baza i stałe, z którymi trzeba je próbkować;
+// nullptr jeśli żadnej składowej nie da się przeskalować
+static std::shared_ptr<FieldBasis> planBasis(const FieldParameters &params, FieldParameters &sampling) {
+    ParameterDependence dependence[3];
+    unsigned char general = 0;
+    for (int component = 0; component < 3; component++) {
+        dependence[component] = componentDependence(params, component);
+        if (!dependence[component].separable()) {
+            general |= dependence[component].parameters;
+        }
+    }
+
+    auto result = std::make_shared<FieldBasis>();
+    result->general = general;
+    const float values[3] = {params.a, params.b, params.c};
+    for (int p = 0; p < 3; p++) {
+        // stała używana przez składową nieskalowalną musi mieć prawdziwą wartość, pozostałe wyznaczane są dla 1
+        result->values[p] = general & (1 << p) ? values[p] : 1.0f;
+    }
+    bool anyCached = false;
+    for (int component = 0; component < 3; component++) {
+        const ParameterDependence &d = dependence[component];
+        result->cached[component] = d.separable() && (d.scale < 0 || !(general & (1 << d.scale)));
+        result->scale[component] = result->cached[component] ? d.scale : -1;
+        anyCached = anyCached || result->cached[component];
+    }
+    if (!anyCached) {
+        return nullptr;
+    }
+
+    sampling = params;
+    sampling.a = result->values[0];
+    sampling.b = result->values[1];
+    sampling.c = result->values[2];
+    sampling.basis.reset();
+    return result;
+}
+
+// uzupełnia bazę, której siatka została już spróbkowana z parametrami sampling
+static void completeBasis(const FieldParameters &params, const FieldParameters &sampling, FieldBasis &basis) {
+    basis.source = sampling;
+    basis.source.pool.reset();
+
+    const bool allCached = basis.cached[0] && basis.cached[1] && basis.cached[2];
+    if (params.expression && !params.native && !allCached) {
+        // przy zmianie stałych maszyna wirtualna liczy tylko składowe nieskalowalne, pozostałe zastępuje zero
+        basis.generalExpression = FieldExpression::compile(basis.cached[0] ? "0" : params.expression->source(0),
+                                                           basis.cached[1] ? "0" : params.expression->source(1),
+                                                           basis.cached[2] ? "0" : params.expression->source(2),
+                                                           nullptr);
+    }
+}
+
+bool sampleBasis(const FieldParameters &params, std::shared_ptr<const FieldBasis> &basis, const CancelCheck &cancelled) {
+    basis.reset();
+    FieldParameters sampling;
+    std::shared_ptr<FieldBasis> result = planBasis(params, sampling);
+    if (!result) {
+        return true;
+    }
+    if (!sampleNodes(sampling, result->grid, cancelled)) {
+        return false;
+    }
+    completeBasis(params, sampling, *result);
+    basis = result;
+    return true;
+}
+
+namespace {
+
+template <typename Evaluator>
+void rescaleAllLayers(const FieldParameters &params, const FieldBasis &basis, const Evaluator &evaluate, bool reevaluate,
+                      bool reclip, FieldGrid &grid, const CancelCheck &cancelled) {
+    const int layer = grid.layerSize();
+    const float values[3] = {params.a, params.b, params.c};
+    const float *coordinates[3] = {grid.x.constData(), grid.y.constData(), grid.z.constData()};
+    float *components[3] = {grid.vx.data(), grid.vy.data(), grid.vz.data()};
+    float *mags = grid.magnitudes.data();
+    // nowe stałe mogą dać wartości nieskończone tam, gdzie baza była skończona (i odwrotnie), więc znacznik
+    // invalidSample wyznaczany jest zawsze, a odcięcie płaszczyzną tylko po jej zmianie
+    unsigned char *clipped = grid.clipped.data();
+
+    forEachSlab(params.pool.get(), grid.countX, [&](int firstLayer, int lastLayer) {
+        std::vector<float> evaluated(reevaluate ? 3 * layer : 0);
+        for (int l = firstLayer; l < lastLayer; l++) {
+            if (cancelled()) {
+                return;
+            }
+            const int first = l * layer;
+            if (reevaluate) {
+                evaluate(coordinates[0] + first, coordinates[1] + first, coordinates[2] + first,
+                         evaluated.data(), evaluated.data() + layer, evaluated.data() + 2 * layer,
+                         layer, params.a, params.b, params.c);
+            }
+            for (int component = 0; component < 3; component++) {
+                float *v = components[component] + first;
+                if (!basis.cached[component]) {
+                    if (reevaluate) {
+                        std::copy(evaluated.data() + component * layer, evaluated.data() + (component + 1) * layer, v);
+                    }
+                } else if (basis.scale[component] >= 0) {
+                    const float factor = values[basis.scale[component]];
+                    for (int i = 0; i < layer; i++) {
+                        v[i] = factor * v[i];
+                    }
+                }
+            }
+            const float *fx = components[0];
+            const float *fy = components[1];
+            const float *fz = components[2];
+            for (int i = first; i < first + layer; i++) {
+                mags[i] = fx[i] * fx[i] + fy[i] * fy[i] + fz[i] * fz[i];
+            }
+            if (reclip) {
+                for (int i = first; i < first + layer; i++) {
+                    const bool above = params.isAbovePlain(coordinates[0][i], coordinates[1][i], coordinates[2][i]);
+                    clipped[i] = (params.cutByPlain && above ? FieldGrid::clippedByPlane : 0)
+                                 | FieldGrid::sampleFlag(mags[i]);
+                }
+            } else {
+                for (int i = first; i < first + layer; i++) {
+                    clipped[i] = (clipped[i] & FieldGrid::clippedByPlane) | FieldGrid::sampleFlag(mags[i]);
+                }
+            }
+        }
+    });
+}
+
+}
+
+bool rescaleField(const FieldParameters &params, const FieldBasis &basis, FieldGrid &grid, const CancelCheck &cancelled) {
+    // współrzędne pozostają współdzielone z bazą (QVector), kopiowane są tylko składowe, długości i znaczniki
+    grid = basis.grid;
+    const bool reclip = clippingChanged(params, basis.source);
+
+    const float values[3] = {params.a, params.b, params.c};
+    bool reevaluate = false;
+    for (int p = 0; p < 3; p++) {
+        if ((basis.general & (1 << p)) && values[p] != basis.values[p]) {
+            reevaluate = true;
+        }
+    }
+
+    if (basis.generalExpression) {
+        rescaleAllLayers(params, basis, ExpressionEvaluator{basis.generalExpression.get()}, reevaluate, reclip, grid,
+                         cancelled);
+    } else if (params.sampled) {
+        rescaleAllLayers(params, basis, SampledEvaluator{params.sampled.get()}, reevaluate, reclip, grid, cancelled);
+    } else if (params.expression && !params.native) {
+        rescaleAllLayers(params, basis, ExpressionEvaluator{params.expression.get()}, reevaluate, reclip, grid,
+                         cancelled);
+    } else {
+        rescaleAllLayers(params, basis, KernelEvaluator{params.kernel}, reevaluate, reclip, grid, cancelled);
+    }
+    if (cancelled()) {
+        return false;
+    }
+    grid.updateStatistics(params.pool.get());
+    return true;
+}
+
+void buildGlyphs(const FieldParameters &params, const FieldGrid &grid, QVector<Glyph> &glyphs) {
+    const QVector<int> offsets = layerOffsets(grid);
+    glyphs.resize(grid.visibleCount);
+    Glyph *out = glyphs.data();
+
+    const int layer = grid.layerSize();
+    forEachSlab(params.pool.get(), grid.countX, [&](int firstLayer, int lastLayer) {
+        for (int l = firstLayer; l < lastLayer; l++) {
+            Glyph *glyph = out + offsets[l];
+            for (int i = l * layer; i < (l + 1) * layer; i++) {
+                if (grid.clipped[i]) {
+                    continue;
+                }
+                glyph->rotation = arrowRotation(QVector3D(grid.vx[i], grid.vy[i], grid.vz[i]), grid.x[i], grid.z[i]);
+                glyph->position = QVector3D(grid.x[i], grid.y[i], grid.z[i]);
+                glyph++;
+            }
+        }
+    });
+    styleGlyphs(params, grid, glyphs);
+}
+
+void styleGlyphs(const FieldParameters &params, const FieldGrid &grid, QVector<Glyph> &glyphs) {
+    Q_ASSERT(glyphs.size() == grid.visibleCount);
+    const QVector<int> offsets = layerOffsets(grid);
+    Glyph *out = glyphs.data();
+    const float max = grid.maxMagnitude;
+    if (params.lengthOption == 0) {
+        styleGlyphLayers(params, grid, offsets, out, GridScaling{max, minimum(grid.stepX, grid.stepY, grid.stepZ)});
+    } else if (params.lengthOption == 1) {
+        styleGlyphLayers(params, grid, offsets, out, FixedScaling{});
+    } else {
+        styleGlyphLayers(params, grid, offsets, out, SliderScaling{max, params.arrowLength});
+    }
+}
+
+static bool sameValues(const QVector<float> &first, const QVector<float> &second) {
+    return first.size() == second.size()
+           && std::memcmp(first.constData(), second.constData(), first.size() * sizeof(float)) == 0;
+}
+
+static void validateGrid(const FieldParameters &params, PreparedGlyphs &result, bool resampled,
+                         const CancelCheck &cancelled) {
+    FieldGrid serial = result.grid;
+    serial.updateStatisticsSinglePass();
+    result.statisticsMatch = sameStatistics(serial, result.grid);
+    if (resampled) {
+        // pole wyznaczone z bazy lub stopniowo musi być identyczne z próbkowanym od nowa w całości
+        FieldGrid sampledGrid;
+        sampleField(params, sampledGrid, cancelled);
+        result.statisticsMatch = result.statisticsMatch && sameStatistics(sampledGrid, result.grid)
+                                 && sameValues(sampledGrid.vx, result.grid.vx)
+                                 && sameValues(sampledGrid.vy, result.grid.vy)
+                                 && sameValues(sampledGrid.vz, result.grid.vz);
+    }
+}
+
+static void completeGlyphs(const FieldParameters &params, PreparedGlyphs &result, const CancelCheck &cancelled) {
+    QElapsedTimer timer;
+    timer.start();
+    buildGlyphs(params, result.grid, result.glyphs);
+    result.glyphTimeNs = timer.nsecsElapsed();
+    result.lengthOption = params.lengthOption;
+    result.arrowLength = params.arrowLength;
+    result.cancelled = cancelled();
+}
+
+PreparedGlyphs prepareGlyphs(const FieldParameters &params, quint64 generation, const CancelCheck &cancelled) {
+    PreparedGlyphs result;
+    result.generation = generation;
+
+    QElapsedTimer timer;
+    timer.start();
+    bool sampled;
+    if (params.basis && params.basis->matches(params)) {
+        // zmieniły się tylko stałe a, b, c, płaszczyzna odcinająca lub styl strzałek - pole wyznaczane z bazy
+        sampled = rescaleField(params, *params.basis, result.grid, cancelled);
+        result.basis = params.basis;
+        result.rescaled = true;
+    } else {
+        std::shared_ptr<const FieldBasis> basis;
+        sampled = sampleBasis(params, basis, cancelled)
+                  && (basis ? rescaleField(params, *basis, result.grid, cancelled)
+                            : sampleField(params, result.grid, cancelled));
+        result.basis = basis;
+    }
+    if (!sampled) {
+        result.cancelled = true;
+        return result;
+    }
+    result.sampleTimeNs = timer.nsecsElapsed();
+
+    if (params.validate) {
+        validateGrid(params, result, result.basis != nullptr, cancelled);
+    }
+    completeGlyphs(params, result, cancelled);
+    return result;
+}
+
+// mniejsze siatki próbkowane są w całości, bo i tak pojawiają się bez zauważalnego opóźnienia
+constexpr qint64 progressiveMinimumNodes = 65536;
+
+// największa liczba węzłów najrzadszego poziomu, którego strzałki mają się pojawić od razu
+constexpr qint64 coarseLevelNodes = 4096;
+
+// liczba nowych węzłów, po której fragment strzałek przekazywany jest do wyświetlenia
+constexpr int nodesPerChunk = 16384;
+
+// węzły fragmentu próbkowane są porcjami, każda porcja przez jeden wątek
+constexpr int nodesPerBlock = 2048;
+
+static qint64 levelNodes(const FieldParameters &params, int stride) {
+    return static_cast<qint64>(params.xSegments / stride + 1) * (params.ySegments / stride + 1)
+           * (params.zSegments / stride + 1);
+}
+
+int progressiveLevelCount(const FieldParameters &params) {
+    if (levelNodes(params, 1) < progressiveMinimumNodes) {
+        return 1;
+    }
+    int levels = 1;
+    while (levelNodes(params, 1 << (levels - 1)) > coarseLevelNodes) {
+        levels++;
+    }
+    return levels;
+}
+
+namespace {
+
+// Próbkowanie wybranych węzłów: współrzędne liczone są tym samym wzorem co w sampleLayers, a jądra pola
+// działają na każdym punkcie niezależnie, więc wynik jest identyczny z próbkowaniem całych warstw.
+
+template <typename Evaluator>
+void sampleNodeList(const FieldParameters &params, const Evaluator &evaluate, const FieldGrid &grid,
+                    const SampleBuffers &out, const QVector<int> &nodes) {
+    const int ny = grid.countY;
+    const int nz = grid.countZ;
+    const int count = nodes.size();
+    const int blockCount = (count + nodesPerBlock - 1) / nodesPerBlock;
+    forEachSlab(params.pool.get(), blockCount, [&](int firstBlock, int lastBlock) {
+        std::vector<float> buffer(6 * nodesPerBlock);
+        float *x = buffer.data();
+        float *y = x + nodesPerBlock;
+        float *z = y + nodesPerBlock;
+        float *vx = z + nodesPerBlock;
+        float *vy = vx + nodesPerBlock;
+        float *vz = vy + nodesPerBlock;
+        for (int block = firstBlock; block < lastBlock; block++) {
+            const int first = block * nodesPerBlock;
+            const int n = qMin(nodesPerBlock, count - first);
+            for (int k = 0; k < n; k++) {
+                const int i = nodes[first + k];
+                x[k] = params.xRange.first + i / (ny * nz) * grid.stepX;
+                y[k] = params.yRange.first + i / nz % ny * grid.stepY;
+                z[k] = params.zRange.first + i % nz * grid.stepZ;
+            }
+            evaluate(x, y, z, vx, vy, vz, n, params.a, params.b, params.c);
+            for (int k = 0; k < n; k++) {
+                const int i = nodes[first + k];
+                out.x[i] = x[k];
+                out.y[i] = y[k];
+                out.z[i] = z[k];
+                out.vx[i] = vx[k];
+                out.vy[i] = vy[k];
+                out.vz[i] = vz[k];
+                out.magnitudes[i] = vx[k] * vx[k] + vy[k] * vy[k] + vz[k] * vz[k];
+                const bool above = params.cutByPlain && params.isAbovePlain(x[k], y[k], z[k]);
+                out.clipped[i] = (above ? FieldGrid::clippedByPlane : 0) | FieldGrid::sampleFlag(out.magnitudes[i]);
+            }
+        }
+    });
+}
+
+// strzałki fragmentu; factors przeliczają składowe zapisane w bazie bez stałej na wartości pola
+template <typename Scaling>
+void appendChunkGlyphs(const FieldGrid &grid, const QVector<int> &nodes, const QVector<float> &magnitudes,
+                       const float factors[3], float minMagnitude, float maxMagnitude, const Scaling &scaling,
+                       QVector<Glyph> &glyphs) {
+    for (int k = 0; k < nodes.size(); k++) {
+        const int i = nodes[k];
+        // długość po przemnożeniu przez stałe może być nieskończona, choć próbka bazy była skończona
+        if (grid.clipped[i] || FieldGrid::sampleFlag(magnitudes[k])) {
+            continue;
+        }
+        const QVector3D vector(factors[0] * grid.vx[i], factors[1] * grid.vy[i], factors[2] * grid.vz[i]);
+        Glyph glyph;
+        glyph.position = QVector3D(grid.x[i], grid.y[i], grid.z[i]);
+        glyph.rotation = arrowRotation(vector, grid.x[i], grid.z[i]);
+        glyph.scaling = scaling(magnitudes[k]);
+        // ten sam wzór co FieldGrid::normalized, dla zakresu długości znanego w chwili budowania fragmentu
+        glyph.color = maxMagnitude > minMagnitude
+                      ? static_cast<unsigned char>((magnitudes[k] - minMagnitude) * 255 / (maxMagnitude - minMagnitude))
+                      : 0;
+        glyphs.append(glyph);
+    }
+}
+
+}
+
+PreparedGlyphs prepareGlyphsProgressively(const FieldParameters &params, quint64 generation,
+                                          const CancelCheck &cancelled, const ChunkSink &publish) {
+    const int levelCount = progressiveLevelCount(params);
+    if (levelCount <= 1 || (params.basis && params.basis->matches(params))) {
+        // mała siatka albo samo przeskalowanie bazy - wynik i tak jest gotowy niemal od razu
+        return prepareGlyphs(params, generation, cancelled);
+    }
+
+    PreparedGlyphs result;
+    result.generation = generation;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // węzły próbkowane są tak samo jak przez sampleBasis, żeby wynik zawierał bazę do przeskalowania
+    FieldParameters sampling;
+    std::shared_ptr<FieldBasis> basis = planBasis(params, sampling);
+    if (!basis) {
+        sampling = params;
+    }
+    float factors[3] = {1.0f, 1.0f, 1.0f};
+    if (basis) {
+        const float values[3] = {params.a, params.b, params.c};
+        for (int component = 0; component < 3; component++) {
+            if (basis->cached[component] && basis->scale[component] >= 0) {
+                factors[component] = values[basis->scale[component]];
+            }
+        }
+    }
+
+    FieldGrid sampled;
+    if (!resizeGrid(sampling, sampled)) {
+        result.cancelled = true;
+        return result;
+    }
+    const SampleBuffers out = {sampled.x.data(), sampled.y.data(), sampled.z.data(),
+                               sampled.vx.data(), sampled.vy.data(), sampled.vz.data(),
+                               sampled.magnitudes.data(), sampled.clipped.data()};
+    const int nx = sampled.countX;
+    const int ny = sampled.countY;
+    const int nz = sampled.countZ;
+    const float minStep = minimum(sampled.stepX, sampled.stepY, sampled.stepZ);
+
+    float minMagnitude = std::numeric_limits<float>::max();
+    float maxMagnitude = 0.0f;
+    QVector<int> nodes;
+    QVector<float> magnitudes;
+    nodes.reserve(nodesPerChunk + ny * nz);
+
+    auto publishNodes = [&](int level) {
+        if (sampling.sampled) {
+            sampleNodeList(sampling, SampledEvaluator{sampling.sampled.get()}, sampled, out, nodes);
+        } else if (sampling.expression && !sampling.native) {
+            sampleNodeList(sampling, ExpressionEvaluator{sampling.expression.get()}, sampled, out, nodes);
+        } else {
+            sampleNodeList(sampling, KernelEvaluator{sampling.kernel}, sampled, out, nodes);
+        }
+
+        magnitudes.resize(nodes.size());
+        for (int k = 0; k < nodes.size(); k++) {
+            const int i = nodes[k];
+            const float fx = factors[0] * sampled.vx[i];
+            const float fy = factors[1] * sampled.vy[i];
+            const float fz = factors[2] * sampled.vz[i];
+            magnitudes[k] = fx * fx + fy * fy + fz * fz;
+            if (!sampled.clipped[i] && !FieldGrid::sampleFlag(magnitudes[k])) {
+                minMagnitude = std::fmin(minMagnitude, magnitudes[k]);
+                maxMagnitude = std::fmax(maxMagnitude, magnitudes[k]);
+            }
+        }
+
+        GlyphChunk chunk;
+        chunk.generation = generation;
+        chunk.level = level;
+        chunk.levelCount = levelCount;
+        chunk.nodeCount = sampled.size();
+        chunk.glyphs.reserve(nodes.size());
+        if (params.lengthOption == 0) {
+            appendChunkGlyphs(sampled, nodes, magnitudes, factors, minMagnitude, maxMagnitude,
+                              GridScaling{maxMagnitude, minStep}, chunk.glyphs);
+        } else if (params.lengthOption == 1) {
+            appendChunkGlyphs(sampled, nodes, magnitudes, factors, minMagnitude, maxMagnitude,
+                              FixedScaling{}, chunk.glyphs);
+        } else {
+            appendChunkGlyphs(sampled, nodes, magnitudes, factors, minMagnitude, maxMagnitude,
+                              SliderScaling{maxMagnitude, params.arrowLength}, chunk.glyphs);
+        }
+        publish(std::move(chunk));
+        nodes.clear();
+    };
+
+    // poziom o podziale stride zawiera węzły, których wszystkie indeksy są wielokrotnościami stride;
+    // węzły poziomu rzadszego (podział 2 * stride) zostały już spróbkowane i są pomijane
+    for (int level = 0; level < levelCount; level++) {
+        const int stride = 1 << (levelCount - 1 - level);
+        const int coarser = stride * 2;
+        for (int ix = 0; ix < nx; ix += stride) {
+            const bool newLayer = level == 0 || ix % coarser != 0;
+            for (int iy = 0; iy < ny; iy += stride) {
+                for (int iz = 0; iz < nz; iz += stride) {
+                    if (newLayer || iy % coarser != 0 || iz % coarser != 0) {
+                        nodes.append((ix * ny + iy) * nz + iz);
+                    }
+                }
+            }
+            if (nodes.size() >= nodesPerChunk || (ix + stride >= nx && !nodes.isEmpty())) {
+                if (cancelled()) {
+                    result.cancelled = true;
+                    return result;
+                }
+                publishNodes(level);
+            }
+        }
+    }
+
+    // pełna siatka ma już wszystkie próbki; pozostaje ustalić statystyki i przeliczyć bazę na pole
+    if (basis) {
+        basis->grid = std::move(sampled);
+        completeBasis(params, sampling, *basis);
+        if (!rescaleField(params, *basis, result.grid, cancelled)) {
+            result.cancelled = true;
+            return result;
+        }
+        result.basis = basis;
+    } else {
+        result.grid = std::move(sampled);
+        result.grid.updateStatistics(params.pool.get());
+    }
+    // czas próbkowania obejmuje też budowanie strzałek fragmentów
+    result.sampleTimeNs = timer.nsecsElapsed();
+
+    if (params.validate) {
+        validateGrid(params, result, true, cancelled);
+    }
+    completeGlyphs(params, result, cancelled);
+    return result;
+}
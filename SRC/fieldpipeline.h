@@ -0,0 +1,282 @@
+#pragma once
+
+#include <QtCore/QPair>
+#include <QtCore/QVector>
+#include <QtGui/QQuaternion>
+#include <QtGui/QVector3D>
+
+#include <functional>
+#include <memory>
+
+#include "fieldgrid.h"
+#include "fieldexpression.h"
+#include "fieldkernels.h"
+
+class NativeField;
+class SampledField;
+class WorkStealingPool;
+struct FieldBasis;
+
+/**
+ * @brief Glyph - opis pojedynczej strzałki przygotowanej do wyświetlenia
+ */
+
+struct Glyph
+{
+    QVector3D position;   ///< położenie początku strzałki
+    QQuaternion rotation; ///< obrót siatki strzałki
+    QVector3D scaling;    ///< skalowanie siatki strzałki
+    unsigned char color;  ///< znormalizowana długość wektora, 0 - niebieski, 255 - czerwony
+};
+
+/**
+ * @brief FieldParameters - niezmienna kopia wszystkich parametrów potrzebnych do wygenerowania strzałek.
+ * Przekazywana do wątku roboczego, dzięki czemu nie odwołuje on się do obiektu Scatter ani do wykresu.
+ */
+
+struct FieldParameters
+{
+    QPair<float, float> xRange;
+    QPair<float, float> yRange;
+    QPair<float, float> zRange;
+
+    int xSegments = 10;
+    int ySegments = 10;
+    int zSegments = 10;
+
+    FieldKind kind = FieldKind::Linear;
+
+    /**
+     * @brief kernel - jądro wyznaczające wektory pola dla całej warstwy węzłów naraz
+     */
+
+    BatchKernel kernel = nullptr;
+
+    /**
+     * @brief expression - pole podane przez użytkownika; jeśli ustawione (a native nie), używane zamiast kernel
+     */
+
+    std::shared_ptr<const FieldExpression> expression;
+
+    /**
+     * @brief native - biblioteka z polem użytkownika skompilowanym do kodu natywnego, do której należy kernel;
+     * kopia wskaźnika utrzymuje bibliotekę załadowaną do końca zlecenia
+     */
+
+    std::shared_ptr<const NativeField> native;
+
+    /**
+     * @brief sampled - pole wczytane z pliku; jeśli ustawione, używane zamiast kernel i expression
+     */
+
+    std::shared_ptr<const SampledField> sampled;
+
+    float a = 1.0f;
+    float b = 1.0f;
+    float c = 1.0f;
+
+    bool cutByPlain = false;
+    float plainA = 1.0f;
+    float plainB = 1.0f;
+    float plainC = 1.0f;
+    float plainD = 1.0f;
+
+    int lengthOption = 0;
+    int arrowLength = 50;
+
+    /**
+     * @brief pool - pula wątków dzieląca próbkowanie na warstwy X, nullptr - obliczenia sekwencyjne
+     */
+
+    std::shared_ptr<WorkStealingPool> pool;
+
+    /**
+     * @brief validate - czy sprawdzać, że równoległe statystyki siatki są identyczne z sekwencyjnymi
+     */
+
+    bool validate = false;
+
+    /**
+     * @brief basis - baza z poprzedniego generowania; jeśli pasuje do parametrów, zmiana a, b, c tylko ją przeskalowuje
+     */
+
+    std::shared_ptr<const FieldBasis> basis;
+
+    /**
+     * @brief isAbovePlain - metoda która determinuje czy wektor znajduje się nad płaszczyną
+     * @return true -> wektor nad płaszczyną, false -> wektor pod płaszczyzną
+     */
+
+    bool isAbovePlain(float x, float y, float z) const;
+};
+
+/**
+ * @brief FieldBasis - próbki pola, w których składowe będące iloczynem stałej a, b lub c i wyrażenia od stałych
+ * niezależnego (ParameterDependence::separable) zapisane są bez tej stałej. Przy zmianie samych stałych składowe te
+ * są tylko przeskalowywane, a ponownie wyznaczane są jedynie pozostałe składowe - i to tylko wtedy, gdy zmieniła się
+ * stała, od której zależą. Płaszczyzna odcinająca nie wpływa na wartości pola, więc po jej zmianie wyznaczane są
+ * od nowa tylko odcięcia węzłów.
+ */
+
+struct FieldBasis
+{
+    FieldParameters source;  ///< parametry, z którymi wyznaczono bazę
+    float values[3];         ///< wartości a, b, c użyte przy wyznaczaniu bazy (1 dla stałych wyłącznie skalujących)
+    bool cached[3];          ///< czy składowa zapisana jest jako baza
+    int scale[3];            ///< indeks stałej mnożącej bazę składowej, -1 - składowa od stałych niezależna
+    unsigned char general;   ///< maska stałych, od których zależą składowe niezapisane jako baza
+
+    /**
+     * @brief generalExpression - wyrażenie pola użytkownika ograniczone do składowych niezapisanych jako baza
+     */
+
+    std::shared_ptr<const FieldExpression> generalExpression;
+
+    /**
+     * @brief grid - współrzędne, odcięcia i składowe pola wyznaczone z values
+     */
+
+    FieldGrid grid;
+
+    /**
+     * @brief matches - czy bazę wyznaczono dla tej samej siatki i pola; płaszczyzna odcinająca może być inna
+     */
+
+    bool matches(const FieldParameters& params) const;
+};
+
+/**
+ * @brief PreparedGlyphs - wynik przygotowania strzałek w wątku roboczym
+ */
+
+struct PreparedGlyphs
+{
+    quint64 generation = 0;   ///< numer zlecenia, z którego pochodzi wynik
+    bool cancelled = false;   ///< true jeśli zlecenie zostało przerwane przez nowsze
+    FieldGrid grid;
+    QVector<Glyph> glyphs;
+    qint64 sampleTimeNs = 0;
+    qint64 glyphTimeNs = 0;
+    bool statisticsMatch = true; ///< wynik porównania z obliczeniem sekwencyjnym, gdy FieldParameters::validate
+    std::shared_ptr<const FieldBasis> basis; ///< baza do wykorzystania przy następnej zmianie stałych
+    bool rescaled = false;    ///< true jeśli pole wyznaczono przez przeskalowanie bazy z FieldParameters::basis
+    int lengthOption = 0;     ///< tryb długości, z którym zbudowano strzałki
+    int arrowLength = 50;     ///< długość strzałek, z którą je zbudowano
+};
+
+/**
+ * @brief CancelCheck - funkcja zwracająca true, gdy bieżące zlecenie ma zostać przerwane
+ */
+
+using CancelCheck = std::function<bool()>;
+
+/**
+ * @brief sampleField - jednym przebiegiem wyznacza wartości pola we wszystkich węzłach siatki,
+ * warstwy X rozdzielane są między wątki params.pool
+ * @param params - parametry pola i siatki
+ * @param grid - siatka, do której zapisywane są próbki
+ * @param cancelled - sprawdzane przed każdą warstwą X, przerywa próbkowanie
+ * @return false jeśli próbkowanie zostało przerwane
+ */
+
+bool sampleField(const FieldParameters& params, FieldGrid& grid, const CancelCheck& cancelled);
+
+/**
+ * @brief sampleBasis - wyznacza bazę pola dla siatki i pola z params
+ * @param params - parametry pola i siatki
+ * @param basis - wyznaczona baza, nullptr jeśli żadnej składowej pola nie da się przeskalować
+ * @param cancelled - przerywa wyznaczanie bazy
+ * @return false jeśli wyznaczanie zostało przerwane
+ */
+
+bool sampleBasis(const FieldParameters& params, std::shared_ptr<const FieldBasis>& basis, const CancelCheck& cancelled);
+
+/**
+ * @brief rescaleField - wyznacza pole dla stałych a, b, c z params na podstawie bazy, bez ponownego wyznaczania
+ * składowych zapisanych w bazie, odcięcia dla płaszczyzny z params, a następnie statystyki siatki
+ * @param params - parametry pola; siatka i pole muszą być zgodne z bazą (FieldBasis::matches)
+ * @param basis - baza pola
+ * @param grid - siatka, do której zapisywane są próbki
+ * @param cancelled - sprawdzane przed każdą warstwą X
+ * @return false jeśli wyznaczanie zostało przerwane
+ */
+
+bool rescaleField(const FieldParameters& params, const FieldBasis& basis, FieldGrid& grid, const CancelCheck& cancelled);
+
+/**
+ * @brief limitGridSize - zmniejsza liczbę podprzedziałów osi tak, żeby siatka miała najwyżej
+ * FieldGrid::maxNodeCount węzłów; proporcje siatki zachowywane są w miarę możliwości
+ * @param params - parametry, których liczby podprzedziałów są zmieniane
+ * @return true jeśli siatkę trzeba było zmniejszyć
+ */
+
+bool limitGridSize(FieldParameters& params);
+
+/**
+ * @brief buildGlyphs - buduje strzałki dla węzłów siatki, które nie zostały odcięte, w kolejności węzłów
+ * @param params - parametry określające długość strzałek
+ * @param grid - próbki pola z wyznaczonymi statystykami
+ * @param glyphs - tablica zastępowana zbudowanymi strzałkami
+ */
+
+void buildGlyphs(const FieldParameters& params, const FieldGrid& grid, QVector<Glyph>& glyphs);
+
+/**
+ * @brief styleGlyphs - wyznacza od nowa tylko skalowanie i kolor strzałek zbudowanych przez buildGlyphs
+ * z tej samej siatki; położenie i obrót pozostają bez zmian
+ * @param params - parametry określające długość strzałek
+ * @param grid - próbki pola, z których zbudowano strzałki
+ * @param glyphs - strzałki do zmiany
+ */
+
+void styleGlyphs(const FieldParameters& params, const FieldGrid& grid, QVector<Glyph>& glyphs);
+
+/**
+ * @brief prepareGlyphs - próbkuje pole i buduje strzałki; bezpieczna do wywołania z dowolnego wątku
+ * @param params - parametry pola i siatki
+ * @param generation - numer zlecenia zapisywany w wyniku
+ * @param cancelled - pozwala przerwać zlecenie, gdy pojawi się nowsze
+ */
+
+PreparedGlyphs prepareGlyphs(const FieldParameters& params, quint64 generation, const CancelCheck& cancelled);
+
+/**
+ * @brief GlyphChunk - fragment strzałek przygotowany w trakcie stopniowego próbkowania (prepareGlyphsProgressively)
+ */
+
+struct GlyphChunk
+{
+    quint64 generation = 0; ///< numer zlecenia, z którego pochodzi fragment
+    int level = 0;          ///< poziom siatki, 0 - najrzadszy
+    int levelCount = 0;     ///< liczba poziomów; ostatni to pełna siatka
+    int nodeCount = 0;      ///< liczba węzłów pełnej siatki
+    QVector<Glyph> glyphs;  ///< strzałki węzłów, które pojawiły się na tym poziomie
+};
+
+/**
+ * @brief ChunkSink - funkcja odbierająca kolejne fragmenty strzałek, wywoływana w wątku roboczym
+ */
+
+using ChunkSink = std::function<void(GlyphChunk&&)>;
+
+/**
+ * @brief progressiveLevelCount - liczba poziomów, na które prepareGlyphsProgressively podzieli siatkę
+ * @return 1 jeśli siatka jest na tyle mała, że stopniowe próbkowanie nie ma sensu
+ */
+
+int progressiveLevelCount(const FieldParameters& params);
+
+/**
+ * @brief prepareGlyphsProgressively - próbkuje pole od siatki najrzadszej do pełnej i przekazuje strzałki kolejnych
+ * poziomów we fragmentach, zanim powstanie cała siatka. Poziom rzadszy zawiera co drugi węzeł poziomu gęstszego
+ * wzdłuż każdej osi, a próbki zapisywane są od razu w docelowej siatce, więc każdy węzeł próbkowany jest raz.
+ * Długość i kolor strzałek we fragmentach wynikają z zakresu długości znanego w chwili ich zbudowania; wynik
+ * końcowy jest identyczny z wynikiem prepareGlyphs, łącznie z bazą do przeskalowania przy zmianie stałych.
+ * @param params - parametry pola i siatki
+ * @param generation - numer zlecenia zapisywany w wyniku i we fragmentach
+ * @param cancelled - pozwala przerwać zlecenie, gdy pojawi się nowsze
+ * @param publish - odbiera kolejne fragmenty strzałek
+ */
+
+PreparedGlyphs prepareGlyphsProgressively(const FieldParameters& params, quint64 generation,
+                                          const CancelCheck& cancelled, const ChunkSink& publish);
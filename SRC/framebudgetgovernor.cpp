@@ -0,0 +1,98 @@
+#include "framebudgetgovernor.h"
+#include <QtCore/qmath.h>
+
+#include <cmath>
+
+// waga nowego pomiaru w średniej wykładniczej
+constexpr double measurementWeight = 0.3;
+
+// pomiary na mniejszej liczbie elementów zdominowane są przez stały narzut i zawyżałyby koszt jednostkowy
+constexpr qint64 minimumMeasuredNodes = 10000;
+constexpr qint64 minimumMeasuredTriangles = 100000;
+
+static void average(double &value, double measured) {
+    value += (measured - value) * measurementWeight;
+}
+
+static qint64 nodeCount(const int segments[3]) {
+    return static_cast<qint64>(segments[0] + 1) * (segments[1] + 1) * (segments[2] + 1);
+}
+
+bool GovernorDecision::capped() const {
+    return segments[0] != requestedSegments[0] || segments[1] != requestedSegments[1]
+           || segments[2] != requestedSegments[2];
+}
+
+void FrameBudgetGovernor::setBudgets(qint64 regenerationNs, qint64 frameNs) {
+    m_regenerationBudgetNs = qMax<qint64>(1, regenerationNs);
+    m_frameBudgetNs = qMax<qint64>(1, frameNs);
+}
+
+void FrameBudgetGovernor::recordGeneration(qint64 nodeCount, qint64 ns) {
+    if (nodeCount >= minimumMeasuredNodes) {
+        average(m_nsPerNode, static_cast<double>(ns) / nodeCount);
+    }
+}
+
+void FrameBudgetGovernor::recordUpload(int backend, qint64 glyphCount, qint64 ns) {
+    if (backend >= 0 && backend < backendCount && glyphCount >= minimumMeasuredNodes / 10) {
+        average(m_nsPerUpload[backend], static_cast<double>(ns) / glyphCount);
+    }
+}
+
+void FrameBudgetGovernor::recordFrame(qint64 triangleCount, qint64 ns) {
+    // czas klatki zawiera też osie i tło, więc koszt na trójkąt jest oszacowaniem z góry
+    if (triangleCount >= minimumMeasuredTriangles) {
+        average(m_nsPerTriangle, static_cast<double>(ns) / triangleCount);
+    }
+}
+
+double FrameBudgetGovernor::nsPerUpload(int backend) const {
+    return m_nsPerUpload[qBound(0, backend, backendCount - 1)];
+}
+
+qint64 FrameBudgetGovernor::triangleBudget() const {
+    return static_cast<qint64>(m_frameBudgetNs / m_nsPerTriangle);
+}
+
+GovernorDecision FrameBudgetGovernor::decide(int xSegments, int ySegments, int zSegments, int backend,
+                                             int minTriangles) const {
+    GovernorDecision decision;
+    decision.requestedSegments[0] = decision.segments[0] = qMax(1, xSegments);
+    decision.requestedSegments[1] = decision.segments[1] = qMax(1, ySegments);
+    decision.requestedSegments[2] = decision.segments[2] = qMax(1, zSegments);
+
+    const double regenerationPerNode = m_nsPerNode + nsPerUpload(backend);
+    const qint64 regenerationNodes = static_cast<qint64>(m_regenerationBudgetNs / regenerationPerNode);
+    const qint64 frameNodes = static_cast<qint64>(m_frameBudgetNs / (m_nsPerTriangle * qMax(1, minTriangles)));
+    decision.maxNodes = qMax<qint64>(8, qMin(regenerationNodes, frameNodes));
+
+    const qint64 requested = nodeCount(decision.segments);
+    if (requested > decision.maxNodes) {
+        decision.limit = regenerationNodes <= frameNodes ? GovernorLimit::Regeneration : GovernorLimit::Frame;
+
+        // wspólny współczynnik zachowuje proporcje osi, a ewentualny nadmiar po zaokrągleniu
+        // zdejmowany jest z osi o największej liczbie podprzedziałów
+        const double factor = std::cbrt(static_cast<double>(decision.maxNodes) / requested);
+        for (int &segments : decision.segments) {
+            segments = qMax(1, static_cast<int>((segments + 1) * factor) - 1);
+        }
+        while (nodeCount(decision.segments) > decision.maxNodes) {
+            int *largest = &decision.segments[0];
+            for (int &segments : decision.segments) {
+                if (segments > *largest) {
+                    largest = &segments;
+                }
+            }
+            if (*largest == 1) {
+                break;
+            }
+            --*largest;
+        }
+    }
+
+    const qint64 nodes = nodeCount(decision.segments);
+    decision.predictedRegenerationNs = static_cast<qint64>(nodes * regenerationPerNode);
+    decision.predictedFrameNs = static_cast<qint64>(nodes * m_nsPerTriangle * qMax(1, minTriangles));
+    return decision;
+}
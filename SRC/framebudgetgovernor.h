@@ -0,0 +1,127 @@
+#pragma once
+
+#include <QtCore/QtGlobal>
+
+/**
+ * @brief GovernorLimit - ograniczenie, które zdecydowało o liczbie węzłów siatki
+ */
+
+enum class GovernorLimit
+{
+    None = 0,         ///< żądana siatka mieści się w obu budżetach
+    Regeneration = 1, ///< czas próbkowania, budowania i przekazania strzałek do wykresu
+    Frame = 2         ///< czas klatki przy najprostszej siatce strzałek
+};
+
+/**
+ * @brief GovernorDecision - liczba podprzedziałów osi wybrana przez FrameBudgetGovernor
+ */
+
+struct GovernorDecision
+{
+    int segments[3] = {10, 10, 10};       ///< liczba podprzedziałów osi x, y, z do próbkowania
+    int requestedSegments[3] = {10, 10, 10};
+    qint64 maxNodes = 0;                  ///< największa liczba węzłów mieszcząca się w budżetach
+    GovernorLimit limit = GovernorLimit::None;
+    qint64 predictedRegenerationNs = 0;   ///< przewidywany czas regeneracji dla wybranej siatki
+    qint64 predictedFrameNs = 0;          ///< przewidywany czas klatki dla wybranej siatki
+
+    /**
+     * @brief capped - czy liczba podprzedziałów została zmniejszona względem żądanej
+     */
+
+    bool capped() const;
+};
+
+/**
+ * @brief FrameBudgetGovernor - mierzy na bieżącym komputerze koszt regeneracji na węzeł siatki i koszt klatki
+ * na trójkąt, a na tej podstawie ogranicza liczbę podprzedziałów osi i liczbę trójkątów strzałek tak, aby
+ * regeneracja i klatka mieściły się w zadanych budżetach czasu. Koszty uśredniane są wykładniczo; dopóki nie ma
+ * pomiarów, używane są ostrożne wartości początkowe.
+ */
+
+class FrameBudgetGovernor
+{
+public:
+    /**
+     * @brief setBudgets - ustawia budżety czasu
+     * @param regenerationNs - największy czas od zmiany parametrów do wyświetlenia strzałek
+     * @param frameNs - największy czas klatki
+     */
+
+    void setBudgets(qint64 regenerationNs, qint64 frameNs);
+
+    qint64 regenerationBudgetNs() const { return m_regenerationBudgetNs; }
+
+    qint64 frameBudgetNs() const { return m_frameBudgetNs; }
+
+    /**
+     * @brief recordGeneration - zapisuje czas próbkowania pola i budowania strzałek w wątku roboczym
+     * @param nodeCount - liczba węzłów siatki
+     * @param ns - łączny czas
+     */
+
+    void recordGeneration(qint64 nodeCount, qint64 ns);
+
+    /**
+     * @brief recordUpload - zapisuje czas przekazania strzałek do wykresu w wątku GUI
+     * @param backend - tryb renderowania (RenderBackend), koszt zależy od niego
+     * @param glyphCount - liczba przekazanych strzałek
+     * @param ns - czas przekazania
+     */
+
+    void recordUpload(int backend, qint64 glyphCount, qint64 ns);
+
+    /**
+     * @brief recordFrame - zapisuje zmierzony czas klatki
+     * @param triangleCount - liczba trójkątów strzałek w klatce
+     * @param ns - czas klatki
+     */
+
+    void recordFrame(qint64 triangleCount, qint64 ns);
+
+    /**
+     * @brief triangleBudget - liczba trójkątów strzałek, które mieszczą się w budżecie klatki
+     */
+
+    qint64 triangleBudget() const;
+
+    /**
+     * @brief decide - wybiera liczbę podprzedziałów osi nie większą od żądanej, dla której siatka mieści się
+     * w budżetach; proporcje między osiami są zachowywane
+     * @param xSegments, ySegments, zSegments - żądana liczba podprzedziałów osi
+     * @param backend - bieżący tryb renderowania
+     * @param minTriangles - liczba trójkątów najprostszej siatki strzałki
+     */
+
+    GovernorDecision decide(int xSegments, int ySegments, int zSegments, int backend, int minTriangles) const;
+
+    /**
+     * @brief nsPerNode - uśredniony czas próbkowania i budowania strzałki na węzeł
+     */
+
+    double nsPerNode() const { return m_nsPerNode; }
+
+    /**
+     * @brief nsPerTriangle - uśredniony czas klatki na trójkąt strzałek
+     */
+
+    double nsPerTriangle() const { return m_nsPerTriangle; }
+
+    /**
+     * @brief nsPerUpload - uśredniony czas przekazania jednej strzałki do wykresu w danym trybie renderowania
+     */
+
+    double nsPerUpload(int backend) const;
+
+private:
+    static constexpr int backendCount = 3;
+
+    qint64 m_regenerationBudgetNs = 250000000;
+    qint64 m_frameBudgetNs = 33333333;
+
+    double m_nsPerNode = 1000.0;
+    double m_nsPerUpload[backendCount] = {20000.0, 200.0, 1000.0};
+    // przy budżecie klatki 33 ms odpowiada to domyślnemu budżetowi milionu trójkątów strzałek
+    double m_nsPerTriangle = 33.3;
+};
@@ -0,0 +1,219 @@
+#include "glyphmesh.h"
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+
+#include "colorpalette.h"
+#include "meshregistry.h"
+#include "workstealingpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// strzałki dzielone są na bloki, każdy blok przekształcany i formatowany jest przez jeden wątek
+constexpr int glyphsPerBlock = 4096;
+
+// maksymalna długość wiersza "v"/"vn" oraz wiersza "f" tworzonych przez appendVector i appendCorner
+constexpr int maxVectorLine = 2 + 3 * 16 + 1;
+constexpr int maxFaceLine = 1 + 3 * (1 + 3 * 11 + 2) + 1;
+
+static char *appendInt(char *out, qint64 value) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+static char *appendFixed(char *out, float value) {
+    // normalne strzałek o zerowej długości nie są określone
+    if (!std::isfinite(value)) {
+        value = 0.0f;
+    }
+    // cztery miejsca po przecinku wystarczają dla współrzędnych sceny wykresu (osie mają długość kilku jednostek)
+    qint64 scaled = std::llround(static_cast<double>(value) * 10000.0);
+    if (scaled < 0) {
+        *out++ = '-';
+        scaled = -scaled;
+    }
+    out = appendInt(out, scaled / 10000);
+    *out++ = '.';
+    int fraction = static_cast<int>(scaled % 10000);
+    for (int divisor = 1000; divisor > 0; divisor /= 10) {
+        *out++ = static_cast<char>('0' + fraction / divisor % 10);
+    }
+    return out;
+}
+
+static char *appendVector(char *out, const char *type, const QVector3D &vector) {
+    while (*type) {
+        *out++ = *type++;
+    }
+    for (int i = 0; i < 3; i++) {
+        *out++ = ' ';
+        out = appendFixed(out, vector[i]);
+    }
+    *out++ = '\n';
+    return out;
+}
+
+static char *appendCorner(char *out, qint64 position, int uv, qint64 normal) {
+    *out++ = ' ';
+    out = appendInt(out, position);
+    *out++ = '/';
+    out = appendInt(out, uv);
+    *out++ = '/';
+    out = appendInt(out, normal);
+    return out;
+}
+
+GlyphSpace sceneGlyphSpace(const QVector3D &lower, const QVector3D &upper, float aspectRatio,
+                           float horizontalAspectRatio) {
+    GlyphSpace space;
+    space.center = (lower + upper) / 2.0f;
+    space.halfExtent = (upper - lower) / 2.0f;
+
+    // tak samo jak Q3DScatter: bez zadanych proporcji osi poziomych dłuższa z nich ma w scenie długość 2 * aspectRatio
+    const float width = upper.x() - lower.x();
+    const float depth = upper.z() - lower.z();
+    float scaleX = aspectRatio;
+    float scaleZ = aspectRatio;
+    if (horizontalAspectRatio <= 0.0f) {
+        const float longer = qMax(width, depth);
+        scaleX = aspectRatio * width / longer;
+        scaleZ = aspectRatio * depth / longer;
+    } else if (horizontalAspectRatio >= 1.0f) {
+        scaleZ = aspectRatio / horizontalAspectRatio;
+    } else {
+        scaleX = aspectRatio * horizontalAspectRatio;
+    }
+    space.scale = QVector3D(scaleX, 1.0f, -scaleZ);
+    return space;
+}
+
+int maxGlyphMeshGlyphs(const MeshData &shape) {
+    const qint64 limit = std::numeric_limits<int>::max();
+    const qint64 positionsPerGlyph = shape.positions.size();
+    const qint64 normalsPerGlyph = shape.normals.size();
+    const qint64 trianglesPerGlyph = shape.triangleCount();
+    const qint64 elements = std::max({positionsPerGlyph, normalsPerGlyph, trianglesPerGlyph, qint64(1)});
+    qint64 glyphCount = limit / elements;
+    // blok ma co najwyżej glyphsPerBlock strzałek, mniej tylko wtedy, gdy wszystkich strzałek jest mniej
+    const qint64 textPerGlyph = (positionsPerGlyph + normalsPerGlyph) * maxVectorLine + trianglesPerGlyph * maxFaceLine;
+    if (textPerGlyph * glyphsPerBlock > limit) {
+        glyphCount = std::min(glyphCount, limit / textPerGlyph);
+    }
+    return static_cast<int>(glyphCount);
+}
+
+bool writeGlyphMesh(const MeshData &shape, const QVector<Glyph> &glyphs, const ColorPalette &palette,
+                    const GlyphSpace &space, WorkStealingPool *pool, const QString &path, GlyphMeshStats &stats) {
+    QElapsedTimer timer;
+    timer.start();
+
+    const int glyphCount = glyphs.size();
+    if (glyphCount > maxGlyphMeshGlyphs(shape)) {
+        return false;
+    }
+    const int shapePositions = shape.positions.size();
+    const int shapeNormals = shape.normals.size();
+    const int shapeTriangles = shape.triangleCount();
+
+    // bufor wierzchołków całej siatki przydzielany jest raz, wątki zapisują do rozłącznych fragmentów;
+    // maxGlyphMeshGlyphs gwarantuje, że iloczyny poniżej mieszczą się w typie int
+    QVector<QVector3D> positions(glyphCount * shapePositions);
+    QVector<QVector3D> normals(glyphCount * shapeNormals);
+
+    const int blockCount = (glyphCount + glyphsPerBlock - 1) / glyphsPerBlock;
+    QVector<QByteArray> blocks(blockCount);
+
+    auto buildBlocks = [&](int firstBlock, int lastBlock) {
+        for (int block = firstBlock; block < lastBlock; block++) {
+            const int first = block * glyphsPerBlock;
+            const int last = qMin(glyphCount, first + glyphsPerBlock);
+
+            for (int g = first; g < last; g++) {
+                const Glyph &glyph = glyphs[g];
+                const QVector3D center = space.map(glyph.position);
+                QVector3D *p = positions.data() + g * shapePositions;
+                QVector3D *n = normals.data() + g * shapeNormals;
+                for (int i = 0; i < shapePositions; i++) {
+                    p[i] = center + glyph.rotation.rotatedVector(shape.positions[i] * glyph.scaling);
+                }
+                // normalne przy niejednorodnym skalowaniu przekształcane są macierzą odwrotną do skalowania
+                for (int i = 0; i < shapeNormals; i++) {
+                    n[i] = glyph.rotation.rotatedVector((shape.normals[i] / glyph.scaling).normalized());
+                }
+            }
+
+            QByteArray &text = blocks[block];
+            text.resize((last - first) * ((shapePositions + shapeNormals) * maxVectorLine
+                                          + shapeTriangles * maxFaceLine));
+            char *out = text.data();
+            for (int i = first * shapePositions; i < last * shapePositions; i++) {
+                out = appendVector(out, "v", positions[i]);
+            }
+            for (int i = first * shapeNormals; i < last * shapeNormals; i++) {
+                out = appendVector(out, "vn", normals[i]);
+            }
+            for (int g = first; g < last; g++) {
+                // indeksy w OBJ liczone są od 1, współrzędne tekstury to kolejne przedziały palety
+                const qint64 positionBase = static_cast<qint64>(g) * shapePositions + 1;
+                const qint64 normalBase = static_cast<qint64>(g) * shapeNormals + 1;
+                const int uv = palette.binOf(glyphs[g].color) + 1;
+                for (int t = 0; t < shapeTriangles; t++) {
+                    *out++ = 'f';
+                    for (int k = 0; k < 3; k++) {
+                        const MeshCorner &corner = shape.corners[t * 3 + k];
+                        out = appendCorner(out, positionBase + corner.position, uv, normalBase + corner.normal);
+                    }
+                    *out++ = '\n';
+                }
+            }
+            text.resize(static_cast<int>(out - text.data()));
+        }
+    };
+    if (pool) {
+        pool->parallelFor(0, blockCount, 1, buildBlocks);
+    } else {
+        buildBlocks(0, blockCount);
+    }
+
+    QByteArray header("# vfv merged glyph mesh\n");
+    for (int bin = 0; bin < palette.binCount(); bin++) {
+        char line[maxVectorLine];
+        char *out = line;
+        *out++ = 'v';
+        *out++ = 't';
+        *out++ = ' ';
+        out = appendFixed(out, palette.stripCoordinate(bin));
+        *out++ = ' ';
+        out = appendFixed(out, 0.5f);
+        *out++ = '\n';
+        header.append(line, static_cast<int>(out - line));
+    }
+
+    stats.vertexCount = positions.size();
+    stats.triangleCount = glyphCount * shapeTriangles;
+    stats.vertexBytes = (positions.size() + normals.size()) * static_cast<qint64>(sizeof(QVector3D));
+    stats.buildTimeNs = timer.nsecsElapsed();
+
+    timer.restart();
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    bool written = file.write(header) == header.size();
+    for (const QByteArray &text : blocks) {
+        written = written && file.write(text) == text.size();
+    }
+    stats.fileBytes = file.size();
+    file.close();
+    stats.writeTimeNs = timer.nsecsElapsed();
+    return written;
+}
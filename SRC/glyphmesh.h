@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtGui/QVector3D>
+
+#include "fieldpipeline.h"
+
+class ColorPalette;
+class WorkStealingPool;
+struct MeshData;
+
+/**
+ * @brief GlyphSpace - odwzorowanie współrzędnych danych na współrzędne sceny wykresu, w których renderer rysuje
+ * siatki obiektów QCustom3DItem
+ */
+
+struct GlyphSpace
+{
+    QVector3D center;     ///< środek przedziałów osi w jednostkach danych
+    QVector3D halfExtent; ///< połowa długości przedziałów osi w jednostkach danych
+
+    /**
+     * @brief scale - połowa długości osi w scenie; ujemna składowa oznacza oś sceny skierowaną przeciwnie do osi danych
+     */
+
+    QVector3D scale = QVector3D(1.0f, 1.0f, 1.0f);
+
+    /**
+     * @brief map - przelicza położenie z jednostek danych na współrzędne sceny
+     */
+
+    QVector3D map(const QVector3D &position) const { return (position - center) / halfExtent * scale; }
+};
+
+/**
+ * @brief sceneGlyphSpace - odwzorowanie, w którym Q3DScatter umieszcza obiekty o położeniu podanym w jednostkach
+ * danych. Oś Y zajmuje w scenie przedział od -1 do 1, osie poziome rozciągane są zgodnie z proporcjami wykresu,
+ * a oś Z jest odwrócona.
+ * @param lower, upper - końce przedziałów osi
+ * @param aspectRatio - QAbstract3DGraph::aspectRatio
+ * @param horizontalAspectRatio - QAbstract3DGraph::horizontalAspectRatio, 0 - proporcje przedziałów osi X i Z
+ */
+
+GlyphSpace sceneGlyphSpace(const QVector3D &lower, const QVector3D &upper, float aspectRatio,
+                           float horizontalAspectRatio);
+
+/**
+ * @brief GlyphMeshStats - rozmiar i czas budowy połączonej siatki strzałek
+ */
+
+struct GlyphMeshStats
+{
+    int vertexCount = 0;     ///< liczba wierzchołków (pozycji) siatki
+    int triangleCount = 0;   ///< liczba trójkątów siatki
+    qint64 vertexBytes = 0;  ///< rozmiar bufora przekształconych pozycji i normalnych
+    qint64 fileBytes = 0;    ///< rozmiar zapisanego pliku OBJ
+    qint64 buildTimeNs = 0;  ///< czas przekształcenia wierzchołków i formatowania pliku
+    qint64 writeTimeNs = 0;  ///< czas zapisu pliku na dysk
+};
+
+/**
+ * @brief maxGlyphMeshGlyphs - największa liczba strzałek o siatce shape, którą writeGlyphMesh może połączyć.
+ * Bufory wierzchołków, liczba trójkątów i tekst bloku strzałek indeksowane są typem int (QVector, QByteArray).
+ */
+
+int maxGlyphMeshGlyphs(const MeshData &shape);
+
+/**
+ * @brief writeGlyphMesh - łączy strzałki w jedną siatkę i zapisuje ją jako plik OBJ, który można przekazać do
+ * jednego obiektu QCustom3DItem o położeniu bezwzględnym (0, 0, 0) i skalowaniu 1. Wierzchołki wszystkich
+ * strzałek przekształcane są równolegle do wcześniej przydzielonego bufora; kolor strzałki wybiera współrzędna tekstury
+ * wskazująca przedział palety w ColorPalette::strip, tak jak tekstura obiektu w trybie CustomItems.
+ * @param shape - siatka pojedynczej strzałki
+ * @param glyphs - strzałki do połączenia
+ * @param palette - paleta, której przedziały wyznaczają kolory
+ * @param space - odwzorowanie położeń strzałek na współrzędne sceny
+ * @param pool - pula wątków, nullptr - obliczenia sekwencyjne
+ * @param path - ścieżka zapisywanego pliku
+ * @param stats - rozmiar i czas budowy siatki
+ * @return false jeśli pliku nie udało się zapisać albo strzałek jest więcej niż maxGlyphMeshGlyphs
+ */
+
+bool writeGlyphMesh(const MeshData &shape, const QVector<Glyph> &glyphs, const ColorPalette &palette,
+                    const GlyphSpace &space, WorkStealingPool *pool, const QString &path, GlyphMeshStats &stats);
@@ -0,0 +1,186 @@
+#include "imageregistration.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+// obrazy o mniejszej rozpiętości jasności (np. samo tło) nie wyznaczają przesunięcia
+constexpr int minimumContrast = 16;
+// najmniejsza część obrazu, która musi się pokrywać, żeby przesunięcie było brane pod uwagę
+constexpr double minimumOverlap = 0.4;
+// obraz zmniejszany jest do czasu, gdy przeszukiwany zakres nie przekracza tej liczby pikseli
+constexpr int coarseSearchRange = 16;
+constexpr int coarseMinimumSize = 48;
+
+LumaImage LumaImage::fromImage(const QImage &image, const QRect &rect) {
+    const QImage source = image.depth() == 32 ? image : image.convertToFormat(QImage::Format_RGB32);
+    LumaImage luma;
+    luma.width = rect.width();
+    luma.height = rect.height();
+    luma.pixels.resize(luma.width * luma.height);
+    for (int y = 0; y < luma.height; y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(source.constScanLine(rect.y() + y)) + rect.x();
+        uchar *out = luma.pixels.data() + y * luma.width;
+        for (int x = 0; x < luma.width; x++) {
+            out[x] = static_cast<uchar>((qRed(line[x]) * 77 + qGreen(line[x]) * 150 + qBlue(line[x]) * 29) >> 8);
+        }
+    }
+    return luma;
+}
+
+LumaImage LumaImage::downsampled(int factor) const {
+    LumaImage result;
+    result.width = width / factor;
+    result.height = height / factor;
+    result.pixels.resize(result.width * result.height);
+    for (int y = 0; y < result.height; y++) {
+        for (int x = 0; x < result.width; x++) {
+            int sum = 0;
+            for (int dy = 0; dy < factor; dy++) {
+                const uchar *line = pixels.constData() + (y * factor + dy) * width + x * factor;
+                for (int dx = 0; dx < factor; dx++) {
+                    sum += line[dx];
+                }
+            }
+            result.pixels[y * result.width + x] = static_cast<uchar>(sum / (factor * factor));
+        }
+    }
+    return result;
+}
+
+int LumaImage::contrast() const {
+    int low = 255;
+    int high = 0;
+    for (uchar value : pixels) {
+        low = qMin<int>(low, value);
+        high = qMax<int>(high, value);
+    }
+    return pixels.isEmpty() ? 0 : high - low;
+}
+
+// średnia różnica jasności w części wspólnej; nieskończoność, gdy część wspólna jest za mała
+static double meanDifference(const LumaImage &reference, const LumaImage &moving, int shiftX, int shiftY) {
+    const int x0 = qMax(0, -shiftX);
+    const int x1 = qMin(moving.width, reference.width - shiftX);
+    const int y0 = qMax(0, -shiftY);
+    const int y1 = qMin(moving.height, reference.height - shiftY);
+    const qint64 area = static_cast<qint64>(x1 - x0) * (y1 - y0);
+    if (x1 <= x0 || y1 <= y0 || area < minimumOverlap * moving.width * moving.height) {
+        return std::numeric_limits<double>::infinity();
+    }
+    qint64 sum = 0;
+    for (int y = y0; y < y1; y++) {
+        const uchar *movingLine = moving.pixels.constData() + y * moving.width;
+        const uchar *referenceLine = reference.pixels.constData() + (y + shiftY) * reference.width + shiftX;
+        for (int x = x0; x < x1; x++) {
+            sum += std::abs(movingLine[x] - referenceLine[x]);
+        }
+    }
+    return static_cast<double>(sum) / area;
+}
+
+// najlepsze całkowite przesunięcie w kwadracie center ± range
+static QPoint bestShift(const LumaImage &reference, const LumaImage &moving, QPoint center, int range) {
+    QPoint best = center;
+    double bestDifference = std::numeric_limits<double>::infinity();
+    for (int dy = -range; dy <= range; dy++) {
+        for (int dx = -range; dx <= range; dx++) {
+            const double difference = meanDifference(reference, moving, center.x() + dx, center.y() + dy);
+            if (difference < bestDifference) {
+                bestDifference = difference;
+                best = QPoint(center.x() + dx, center.y() + dy);
+            }
+        }
+    }
+    return best;
+}
+
+// położenie minimum paraboli przechodzącej przez trzy próbki, w przedziale [-0.5, 0.5]
+static double parabolaMinimum(double before, double at, double after) {
+    const double curvature = before - 2.0 * at + after;
+    if (!(curvature > 0.0) || std::isinf(before) || std::isinf(after)) {
+        return 0.0;
+    }
+    return qBound(-0.5, (before - after) / (2.0 * curvature), 0.5);
+}
+
+QPointF findTranslation(const LumaImage &reference, const LumaImage &moving, QPoint predicted, int range,
+                        bool *found) {
+    if (reference.contrast() < minimumContrast || moving.contrast() < minimumContrast) {
+        *found = false;
+        return QPointF();
+    }
+    *found = true;
+
+    QVector<LumaImage> referenceLevels{reference};
+    QVector<LumaImage> movingLevels{moving};
+    int scale = 1;
+    while (range > coarseSearchRange
+           && qMin(referenceLevels.last().width, referenceLevels.last().height) / 2 >= coarseMinimumSize) {
+        referenceLevels.append(referenceLevels.last().downsampled(2));
+        movingLevels.append(movingLevels.last().downsampled(2));
+        range = (range + 1) / 2;
+        scale *= 2;
+    }
+
+    // pełne przeszukanie najmniejszego poziomu, a na każdym większym tylko otoczenie podwojonego wyniku
+    QPoint shift = bestShift(referenceLevels.last(), movingLevels.last(),
+                             QPoint(predicted.x() / scale, predicted.y() / scale), range);
+    for (int level = referenceLevels.size() - 2; level >= 0; level--) {
+        shift = bestShift(referenceLevels[level], movingLevels[level], shift * 2, 2);
+    }
+
+    const double center = meanDifference(reference, moving, shift.x(), shift.y());
+    const double subX = parabolaMinimum(meanDifference(reference, moving, shift.x() - 1, shift.y()), center,
+                                        meanDifference(reference, moving, shift.x() + 1, shift.y()));
+    const double subY = parabolaMinimum(meanDifference(reference, moving, shift.x(), shift.y() - 1), center,
+                                        meanDifference(reference, moving, shift.x(), shift.y() + 1));
+    return QPointF(shift.x() + subX, shift.y() + subY);
+}
+
+QPoint alignRegions(const QVector<LumaRegion> &references, const LumaImage &moving, QPoint predicted, int radius) {
+    QVector<const LumaRegion*> textured;
+    for (const LumaRegion &region : references) {
+        if (region.image.contrast() >= minimumContrast) {
+            textured.append(&region);
+        }
+    }
+    if (textured.isEmpty()) {
+        return predicted;
+    }
+
+    QPoint best = predicted;
+    double bestDifference = std::numeric_limits<double>::infinity();
+    int bestDistance = 0;
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            qint64 sum = 0;
+            qint64 count = 0;
+            for (const LumaRegion *region : textured) {
+                const int offsetX = region->origin.x() + predicted.x() + dx;
+                const int offsetY = region->origin.y() + predicted.y() + dy;
+                const int x0 = qMax(0, -offsetX);
+                const int x1 = qMin(region->image.width, moving.width - offsetX);
+                for (int y = qMax(0, -offsetY); y < qMin(region->image.height, moving.height - offsetY); y++) {
+                    const uchar *referenceLine = region->image.pixels.constData() + y * region->image.width;
+                    const uchar *movingLine = moving.pixels.constData() + (y + offsetY) * moving.width + offsetX;
+                    for (int x = x0; x < x1; x++) {
+                        sum += std::abs(referenceLine[x] - movingLine[x]);
+                    }
+                    count += qMax(0, x1 - x0);
+                }
+            }
+            if (count == 0) {
+                continue;
+            }
+            const double difference = static_cast<double>(sum) / count;
+            const int distance = dx * dx + dy * dy;
+            if (difference < bestDifference || (difference == bestDifference && distance < bestDistance)) {
+                bestDifference = difference;
+                bestDistance = distance;
+                best = QPoint(predicted.x() + dx, predicted.y() + dy);
+            }
+        }
+    }
+    return best;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QtCore/QPoint>
+#include <QtCore/QPointF>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+
+/**
+ * @brief LumaImage - jasność pikseli obrazu (0-255), używana do wyznaczania przesunięcia między obrazami
+ */
+
+struct LumaImage
+{
+    int width = 0;
+    int height = 0;
+    QVector<uchar> pixels;
+
+    uchar at(int x, int y) const { return pixels[y * width + x]; }
+
+    /**
+     * @brief fromImage - jasność prostokąta obrazu; prostokąt musi leżeć wewnątrz obrazu
+     */
+
+    static LumaImage fromImage(const QImage& image, const QRect& rect);
+
+    /**
+     * @brief downsampled - obraz zmniejszony factor razy przez uśrednienie bloków factor×factor
+     */
+
+    LumaImage downsampled(int factor) const;
+
+    /**
+     * @brief contrast - różnica między największą i najmniejszą jasnością
+     */
+
+    int contrast() const;
+};
+
+/**
+ * @brief LumaRegion - fragment obrazu odniesienia i położenie jego lewego górnego rogu w układzie obrazu
+ * porównywanego (przy przesunięciu zerowym)
+ */
+
+struct LumaRegion
+{
+    LumaImage image;
+    QPoint origin;
+};
+
+/**
+ * @brief findTranslation - wyznacza z dokładnością do części piksela przesunięcie shift, dla którego
+ * moving(p) ≈ reference(p + shift). Przeszukuje najpierw obrazy zmniejszone, a potem pełną rozdzielczość wokół
+ * znalezionego przesunięcia. Oba obrazy muszą mieć ten sam rozmiar. Obrazy z powtarzającym się wzorem (np. linie
+ * siatki) pasują przy kilku przesunięciach, dlatego zakres wokół przewidywanego przesunięcia powinien być mniejszy
+ * od połowy okresu wzoru.
+ * @param predicted - środek przeszukiwanego zakresu
+ * @param range - największa odległość od predicted w każdej osi, w pikselach
+ * @param found - ustawiane na false, gdy obrazy nie mają wystarczającego kontrastu
+ */
+
+QPointF findTranslation(const LumaImage& reference, const LumaImage& moving, QPoint predicted, int range,
+                        bool *found);
+
+/**
+ * @brief alignRegions - wyznacza całkowite przesunięcie obrazu moving względem fragmentów odniesienia: dla
+ * wyniku d piksel fragmentu (x, y) odpowiada pikselowi origin + (x, y) + d obrazu moving. Przeszukiwane są
+ * przesunięcia odległe od predicted o co najwyżej radius; przy jednakowym dopasowaniu wybierane jest najbliższe
+ * predicted, a fragmenty bez kontrastu są pomijane.
+ */
+
+QPoint alignRegions(const QVector<LumaRegion>& references, const LumaImage& moving, QPoint predicted, int radius);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/**
+ * @brief LockFreeQueue - kolejka bez blokad dla wielu wątków dopisujących i jednego wątku odczytującego.
+ * Dopisanie to jedna wymiana wskaźnika, a odczyt nie czeka na wątki dopisujące: element dopisywany w tej samej
+ * chwili może zostać odczytany dopiero przy kolejnym wywołaniu pop.
+ */
+
+template <typename T>
+class LockFreeQueue
+{
+public:
+    LockFreeQueue() : m_head(new Node), m_tail(m_head.load()) {}
+
+    /**
+     * @brief destruktor - usuwa elementy, których nie odczytano; nie może działać równocześnie z push
+     */
+
+    ~LockFreeQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete m_tail;
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    /**
+     * @brief push - dopisuje element na końcu kolejki; można wywoływać z dowolnego wątku
+     */
+
+    void push(T value) {
+        Node *node = new Node;
+        node->value = std::move(value);
+        Node *previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief pop - odczytuje element z początku kolejki; wywoływana zawsze z tego samego wątku
+     * @param value - odczytany element
+     * @return false jeśli kolejka jest pusta
+     */
+
+    bool pop(T& value) {
+        Node *next = m_tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete m_tail;
+        m_tail = next;
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    // ostatni dopisany węzeł, zmieniany przez wątki dopisujące
+    std::atomic<Node*> m_head;
+
+    // węzeł poprzedzający pierwszy nieodczytany element, używany tylko przez wątek odczytujący
+    Node *m_tail;
+};
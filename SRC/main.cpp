@@ -4,19 +4,31 @@
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QComboBox>
 #include <QtWidgets/QCheckBox>
+#include <QtWidgets/QFileDialog>
 #include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QMessageBox>
+#include <QtWidgets/QProgressBar>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QSlider>
 #include <QtWidgets/QVBoxLayout>
 #include <QtWidgets/QWidget>
 
+#include <cstdio>
+
+#include "nativefield.h"
 #include "scatter.h"
 
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
+
+    if (app.arguments().contains(QStringLiteral("--benchmark"))) {
+        std::printf("%s\n%s\n%s\n%s", benchmarkKernels(1 << 20).c_str(), benchmarkDispatch(1 << 20).c_str(),
+                    benchmarkExpressions(1 << 20).c_str(), qPrintable(benchmarkNativeFields(1 << 20)));
+        return 0;
+    }
+
     QPointer <Q3DScatter> graph = new Q3DScatter();
     QPointer <QWidget> container = QWidget::createWindowContainer(graph);
 
@@ -127,8 +139,40 @@ int main(int argc, char *argv[]) {
     functionComboBox->addItem("F(x,y,z) = v(a*y*z, b*x*z, c*x*y)");
     functionComboBox->addItem("F(x, y, z) = v(a * sin(x), b * sin(y), c * sin(z))");
     functionComboBox->addItem("F(x, y, z) = v(a * tan(x), b * tan(y), c * tan(z))");
+    functionComboBox->addItem("F(x, y, z) = v(P, Q, R) - własne wyrażenia");
+    functionComboBox->addItem("F(x, y, z) = v(a*u, b*v, c*w) - dane z pliku");
     vLayout->addWidget(new QLabel(QStringLiteral("Wybierz funkcję:")));
     vLayout->addWidget(functionComboBox);
+
+    // Custom field expressions
+    QPointer <QHBoxLayout> hCustomLayout = new QHBoxLayout();
+    QPointer <QLineEdit> customP = new QLineEdit(widget);
+    customP->setPlaceholderText(QString("a*x"));
+    QPointer <QLineEdit> customQ = new QLineEdit(widget);
+    customQ->setPlaceholderText(QString("b*y"));
+    QPointer <QLineEdit> customR = new QLineEdit(widget);
+    customR->setPlaceholderText(QString("c*z"));
+    hCustomLayout->addWidget(new QLabel(QStringLiteral(" P =")));
+    hCustomLayout->addWidget(customP);
+    hCustomLayout->addWidget(new QLabel(QStringLiteral(" Q =")));
+    hCustomLayout->addWidget(customQ);
+    hCustomLayout->addWidget(new QLabel(QStringLiteral(" R =")));
+    hCustomLayout->addWidget(customR);
+    vLayout->addLayout(hCustomLayout);
+    QPointer <QLabel> expressionErrorLabel = new QLabel(widget);
+    expressionErrorLabel->setStyleSheet(QStringLiteral("color: red"));
+    vLayout->addWidget(expressionErrorLabel);
+    QPointer <QCheckBox> nativeCheckBox = new QCheckBox;
+    nativeCheckBox->setText("Kompiluj wyrażenia do kodu natywnego");
+    nativeCheckBox->setChecked(qEnvironmentVariableIsSet("VFV_NATIVE_EXPRESSIONS"));
+    QPointer <QLabel> nativeLabel = new QLabel(widget);
+    vLayout->addWidget(nativeCheckBox);
+    vLayout->addWidget(nativeLabel);
+    QPointer <QPushButton> fieldFileButton = new QPushButton(widget);
+    fieldFileButton->setText(QStringLiteral("Wczytaj pole z pliku (.vfv)..."));
+    QPointer <QLabel> fieldFileLabel = new QLabel(widget);
+    vLayout->addWidget(fieldFileButton);
+    vLayout->addWidget(fieldFileLabel);
     //Set a,b,c params
     QPointer <QLineEdit> a = new QLineEdit(widget);
     a->setPlaceholderText(QString("1"));
@@ -151,6 +195,42 @@ int main(int argc, char *argv[]) {
     hParLayout->addWidget(c);
     vLayout->addLayout(hParLayout);
 
+    // Render backend combobox
+    QPointer <QComboBox> backendComboBox = new QComboBox();
+    backendComboBox->addItem("Osobne obiekty (QCustom3DItem)");
+    backendComboBox->addItem("Seria punktów (QScatter3DSeries)");
+    backendComboBox->addItem("Jedna połączona siatka (QCustom3DItem)");
+    vLayout->addWidget(new QLabel(QStringLiteral("Tryb renderowania:")));
+    vLayout->addWidget(backendComboBox);
+
+    QPointer <QComboBox> interactionComboBox = new QComboBox();
+    interactionComboBox->addItem("Wszystkie strzałki", 0);
+    interactionComboBox->addItem("Podzbiór strzałek, 30 FPS", 30);
+    interactionComboBox->addItem("Podzbiór strzałek, 60 FPS", 60);
+    vLayout->addWidget(new QLabel(QStringLiteral("W trakcie ruchu kamery:")));
+    vLayout->addWidget(interactionComboBox);
+
+    QPointer <QCheckBox> governorCheckBox = new QCheckBox;
+    governorCheckBox->setText("Automatycznie ograniczaj siatkę (regeneracja 250 ms, klatka 33 ms)");
+    QPointer <QLabel> governorLabel = new QLabel(widget);
+    governorLabel->setWordWrap(true);
+    vLayout->addWidget(governorCheckBox);
+
+    QPointer <QCheckBox> progressiveCheckBox = new QCheckBox;
+    progressiveCheckBox->setText("Wyświetlaj dużą siatkę stopniowo");
+    progressiveCheckBox->setChecked(true);
+    vLayout->addWidget(progressiveCheckBox);
+    vLayout->addWidget(governorLabel);
+
+    QPointer <QCheckBox> fpsCheckBox = new QCheckBox;
+    fpsCheckBox->setText("Mierz czas klatki");
+    QPointer <QLabel> fpsLabel = new QLabel(widget);
+    vLayout->addWidget(fpsCheckBox);
+    vLayout->addWidget(fpsLabel);
+    QPointer <QLabel> statsLabel = new QLabel(widget);
+    vLayout->addWidget(statsLabel);
+    //
+
     // Theme combobox
     QPointer <QComboBox> themeComboBox = new QComboBox();
     themeComboBox->addItem("Biały motyw");
@@ -192,8 +272,21 @@ int main(int argc, char *argv[]) {
     vLayout->addLayout(hPlainLayout);
 
     // Save to file
+    QPointer <QComboBox> exportComboBox = new QComboBox();
+    exportComboBox->addItem("Rozmiar okna");
+    exportComboBox->addItem("Dwukrotny rozmiar okna");
+    exportComboBox->addItem("Rozmiar okna, 2× i 4×");
+    exportComboBox->addItem("Plakat PNG 16384 px (kafelki, rzut prostokątny)");
     QPointer <QPushButton> saveButton = new QPushButton("Zapisz", widget);
+    QPointer <QProgressBar> exportProgressBar = new QProgressBar(widget);
+    exportProgressBar->setVisible(false);
+    QPointer <QLabel> exportLabel = new QLabel(widget);
+    exportLabel->setWordWrap(true);
+    vLayout->addWidget(new QLabel(QStringLiteral("Rozdzielczość zapisu:")));
+    vLayout->addWidget(exportComboBox);
     vLayout->addWidget(saveButton);
+    vLayout->addWidget(exportProgressBar);
+    vLayout->addWidget(exportLabel);
 
     // Bottom layout
     hSegLayout->addWidget(xSeg);
@@ -244,9 +337,96 @@ int main(int argc, char *argv[]) {
 
     QObject::connect(functionComboBox, SIGNAL(currentIndexChanged(int)), modifier,
                      SLOT(functionboxItemChanged(int)));
+    QObject::connect(customP, SIGNAL(textChanged(QString)), modifier,
+                     SLOT(setCustomP(QString)));
+    QObject::connect(customQ, SIGNAL(textChanged(QString)), modifier,
+                     SLOT(setCustomQ(QString)));
+    QObject::connect(customR, SIGNAL(textChanged(QString)), modifier,
+                     SLOT(setCustomR(QString)));
+    QObject::connect(modifier.data(), &Scatter::expressionError, expressionErrorLabel.data(), &QLabel::setText);
+    QObject::connect(nativeCheckBox, &QCheckBox::toggled, modifier.data(), &Scatter::setNativeExpressions);
+    QObject::connect(modifier.data(), &Scatter::nativeExpressionChanged, nativeLabel.data(), &QLabel::setText);
+    QObject::connect(modifier.data(), &Scatter::fieldFileChanged, fieldFileLabel.data(), &QLabel::setText);
+    QObject::connect(fieldFileButton, &QPushButton::clicked, modifier.data(),
+                     [=]() {
+                         const QString fileName = QFileDialog::getOpenFileName(widget, QStringLiteral("Wczytaj pole"),
+                                                                               QString(),
+                                                                               QStringLiteral("Pole wektorowe (*.vfv)"));
+                         if (fileName.isEmpty() || !modifier->loadFieldFile(fileName))
+                             return;
+                         // przedziały ustawił już loadFieldFile, pola tekstowe tylko je pokazują
+                         QLineEdit *ranges[6] = {xRange1, xRange2, yRange1, yRange2, zRange1, zRange2};
+                         const float values[6] = {graph->axisX()->min(), graph->axisX()->max(),
+                                                  graph->axisY()->min(), graph->axisY()->max(),
+                                                  graph->axisZ()->min(), graph->axisZ()->max()};
+                         for (int i = 0; i < 6; i++) {
+                             QSignalBlocker blocker(ranges[i]);
+                             ranges[i]->setText(QString::number(values[i]));
+                         }
+                         functionComboBox->setCurrentIndex(5);
+                     });
     QObject::connect(lengthOptions, SIGNAL(currentIndexChanged(int)), modifier,
                      SLOT(lengthboxItemChanged(int)));
 
+    QObject::connect(backendComboBox, SIGNAL(currentIndexChanged(int)), modifier,
+                     SLOT(renderBackendChanged(int)));
+    QObject::connect(fpsCheckBox, &QCheckBox::toggled, graph.data(), &Q3DScatter::setMeasureFps);
+    QObject::connect(interactionComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), modifier.data(),
+                     [modifier, interactionComboBox](int index) {
+                         modifier->setTargetFrameRate(interactionComboBox->itemData(index).toInt());
+                     });
+    QObject::connect(progressiveCheckBox, &QCheckBox::toggled, modifier.data(), &Scatter::setProgressiveRendering);
+    QObject::connect(governorCheckBox, &QCheckBox::toggled, modifier.data(), &Scatter::setGovernorEnabled);
+    QObject::connect(modifier.data(), &Scatter::governorChanged, governorLabel.data(), &QLabel::setText);
+    QObject::connect(graph.data(), &Q3DScatter::currentFpsChanged, fpsLabel.data(), [fpsLabel](qreal fps) {
+        if (fps > 0.0)
+            fpsLabel->setText(QString("%1 FPS (%2 ms/klatkę)").arg(fps, 0, 'f', 1).arg(1000.0 / fps, 0, 'f', 2));
+    });
+
+    QObject::connect(modifier.data(), &Scatter::statisticsChanged, statsLabel.data(), [statsLabel](const PipelineStats &stats) {
+        statsLabel->setText(QString("Próbki: %1, odcięte: %2, strzałki: %3\nTekstury: %4 (%5 KiB)\n"
+                                    "Czas [ms]: próbkowanie %6, strzałki %7, wykres %8\n"
+                                    "Pominięte regeneracje: %9\nPole: %10\n"
+                                    "Ostatni etap: %11, zmienione w miejscu: %12 (%13 ms)\n"
+                                    "Obiekty: użyte ponownie %14, utworzone %15, usunięte %16\n"
+                                    "Siatka: %17 trójkątów, wierzchołki %18 KiB, plik %19 KiB, %20 ms\n"
+                                    "Trójkąty na klatkę: %21, poziom szczegółów: %22\n"
+                                    "Wyświetlane: %23 (co %24.), czas klatki [ms]: ruch %25, wszystkie %26\n"
+                                    "Pierwsze strzałki po %27 ms, pełna siatka po %28 ms (poziomy podglądu: %29)\n"
+                                    "Pominięte próbki (nieskończoność lub NaN): %30")
+                                    .arg(stats.sampledCount)
+                                    .arg(stats.clippedCount)
+                                    .arg(stats.emittedCount)
+                                    .arg(stats.textureCount)
+                                    .arg(stats.textureUploadBytes / 1024.0, 0, 'f', 1)
+                                    .arg(stats.sampleTimeNs / 1.0e6, 0, 'f', 1)
+                                    .arg(stats.glyphTimeNs / 1.0e6, 0, 'f', 1)
+                                    .arg(stats.renderTimeNs / 1.0e6, 0, 'f', 1)
+                                    .arg(stats.coalescedCount)
+                                    .arg(stats.rescaled ? "przeskalowana baza" : "pełne próbkowanie")
+                                    .arg(stats.stage == PipelineStage::Sample ? "próbkowanie"
+                                         : stats.stage == PipelineStage::Style ? "styl" : "wykres")
+                                    .arg(stats.restyledCount)
+                                    .arg(stats.styleTimeNs / 1.0e6, 0, 'f', 1)
+                                    .arg(stats.reusedItemCount)
+                                    .arg(stats.createdItemCount)
+                                    .arg(stats.destroyedItemCount)
+                                    .arg(stats.meshTriangleCount)
+                                    .arg(stats.meshVertexBytes / 1024.0, 0, 'f', 1)
+                                    .arg(stats.meshFileBytes / 1024.0, 0, 'f', 1)
+                                    .arg(stats.meshBuildTimeNs / 1.0e6, 0, 'f', 1)
+                                    .arg(stats.triangleCount)
+                                    .arg(stats.detailLevel)
+                                    .arg(stats.displayedCount)
+                                    .arg(stats.interactionStride)
+                                    .arg(stats.interactionFrameTimeNs / 1.0e6, 0, 'f', 2)
+                                    .arg(stats.settledFrameTimeNs / 1.0e6, 0, 'f', 2)
+                                    .arg(stats.firstGlyphTimeNs / 1.0e6, 0, 'f', 1)
+                                    .arg(stats.fullDetailTimeNs / 1.0e6, 0, 'f', 1)
+                                    .arg(stats.previewLevelCount)
+                                    .arg(stats.invalidCount));
+    });
+
     QObject::connect(themeComboBox, SIGNAL(currentIndexChanged(int)), modifier,
                      SLOT(themeboxItemChanged(int)));
 
@@ -262,6 +442,16 @@ int main(int argc, char *argv[]) {
                      SLOT(setPlainD(QString)));
 
     QObject::connect(saveButton, SIGNAL (released()), modifier, SLOT (handleButton()));
+    QObject::connect(exportComboBox, SIGNAL(currentIndexChanged(int)), modifier, SLOT(setExportResolution(int)));
+    QObject::connect(modifier.data(), &Scatter::exportProgress, exportProgressBar.data(),
+                     [exportProgressBar](int finished, int total) {
+                         exportProgressBar->setVisible(finished < total);
+                         exportProgressBar->setRange(0, total);
+                         exportProgressBar->setValue(finished);
+                         // plakat renderowany jest bez powrotu do pętli zdarzeń, więc pasek rysowany jest od razu
+                         exportProgressBar->repaint();
+                     });
+    QObject::connect(modifier.data(), &Scatter::exportFinished, exportLabel.data(), &QLabel::setText);
     widget->show();
     return app.exec();
 }
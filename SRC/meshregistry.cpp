@@ -0,0 +1,230 @@
+#include "meshregistry.h"
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/qmath.h>
+
+// kategoria zdefiniowana w scatter.cpp
+Q_DECLARE_LOGGING_CATEGORY(lcPipeline)
+
+// kolejne poziomy szczegółów strzałki, od pełnej siatki
+static const MeshId arrowDetailLevels[] = {MeshId::Arrow, MeshId::ArrowReduced, MeshId::Cone};
+
+qint64 MeshData::memoryUsage() const {
+    return positions.size() * static_cast<qint64>(sizeof(QVector3D))
+           + uvs.size() * static_cast<qint64>(sizeof(QVector2D))
+           + normals.size() * static_cast<qint64>(sizeof(QVector3D))
+           + corners.size() * static_cast<qint64>(sizeof(MeshCorner));
+}
+
+MeshRegistry &MeshRegistry::instance() {
+    static MeshRegistry registry;
+    return registry;
+}
+
+MeshRegistry::MeshRegistry() {
+    m_meshFiles[static_cast<int>(MeshId::Arrow)] = QStringLiteral(":/arrow.obj");
+    m_meshFiles[static_cast<int>(MeshId::Sphere)] = QStringLiteral(":/sphere.obj");
+    m_meshFiles[static_cast<int>(MeshId::Cone)] = QStringLiteral(":/cone.obj");
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < resourceMeshCount; i++) {
+        QFile file(m_meshFiles[i]);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCWarning(lcPipeline, "mesh registry: cannot open %s", qPrintable(m_meshFiles[i]));
+            continue;
+        }
+        m_meshes[i] = parseObj(file.readAll());
+    }
+
+    const int reduced = static_cast<int>(MeshId::ArrowReduced);
+    m_meshes[reduced] = reduceArrow(m_meshes[static_cast<int>(MeshId::Arrow)], 6);
+    m_meshFiles[reduced] = m_generatedDirectory.filePath(QStringLiteral("arrow-reduced.obj"));
+    QFile file(m_meshFiles[reduced]);
+    if (!m_generatedDirectory.isValid() || !file.open(QIODevice::WriteOnly)
+        || file.write(writeObj(m_meshes[reduced])) < 0) {
+        qCWarning(lcPipeline, "mesh registry: cannot write %s", qPrintable(m_meshFiles[reduced]));
+        m_meshes[reduced] = m_meshes[static_cast<int>(MeshId::Arrow)];
+        m_meshFiles[reduced] = m_meshFiles[static_cast<int>(MeshId::Arrow)];
+    }
+    m_loadTimeNs = timer.nsecsElapsed();
+
+    // QtDataVisualization nadal sam wczytuje pliki przekazane do setMeshFile, więc to jest dodatkowe parsowanie,
+    // potrzebne tylko do liczenia trójkątów, generowania uproszczonych siatek i łączenia strzałek w jedną siatkę
+    qCInfo(lcPipeline, "mesh registry: parsed %d meshes for glyph geometry in %.3f ms, %lld bytes",
+           meshCount, m_loadTimeNs / 1.0e6, memoryUsage());
+}
+
+const MeshData &MeshRegistry::mesh(MeshId id) const {
+    return m_meshes[static_cast<int>(id)];
+}
+
+const QString &MeshRegistry::meshFile(MeshId id) const {
+    return m_meshFiles[static_cast<int>(id)];
+}
+
+qint64 MeshRegistry::memoryUsage() const {
+    qint64 bytes = 0;
+    for (const MeshData &mesh : m_meshes) {
+        bytes += mesh.memoryUsage();
+    }
+    return bytes;
+}
+
+static MeshCorner parseCorner(const QByteArray &token) {
+    // v, v/vt, v//vn lub v/vt/vn; indeksy w OBJ liczone są od 1
+    MeshCorner corner{-1, -1, -1};
+    const QList<QByteArray> parts = token.split('/');
+    if (parts.size() > 0 && !parts[0].isEmpty())
+        corner.position = parts[0].toInt() - 1;
+    if (parts.size() > 1 && !parts[1].isEmpty())
+        corner.uv = parts[1].toInt() - 1;
+    if (parts.size() > 2 && !parts[2].isEmpty())
+        corner.normal = parts[2].toInt() - 1;
+    return corner;
+}
+
+MeshData MeshRegistry::parseObj(const QByteArray &data) {
+    MeshData mesh;
+    const QList<QByteArray> lines = data.split('\n');
+    for (const QByteArray &rawLine : lines) {
+        const QByteArray line = rawLine.simplified();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        const QList<QByteArray> tokens = line.split(' ');
+        const QByteArray &type = tokens[0];
+        if (type == "v" && tokens.size() >= 4) {
+            mesh.positions.append(QVector3D(tokens[1].toFloat(), tokens[2].toFloat(), tokens[3].toFloat()));
+        } else if (type == "vt" && tokens.size() >= 3) {
+            mesh.uvs.append(QVector2D(tokens[1].toFloat(), tokens[2].toFloat()));
+        } else if (type == "vn" && tokens.size() >= 4) {
+            mesh.normals.append(QVector3D(tokens[1].toFloat(), tokens[2].toFloat(), tokens[3].toFloat()));
+        } else if (type == "f" && tokens.size() >= 4) {
+            const MeshCorner first = parseCorner(tokens[1]);
+            MeshCorner previous = parseCorner(tokens[2]);
+            for (int i = 3; i < tokens.size(); i++) {
+                const MeshCorner current = parseCorner(tokens[i]);
+                mesh.corners.append(first);
+                mesh.corners.append(previous);
+                mesh.corners.append(current);
+                previous = current;
+            }
+        }
+    }
+    return mesh;
+}
+
+QByteArray MeshRegistry::writeObj(const MeshData &mesh) {
+    QByteArray data;
+    for (const QVector3D &v : mesh.positions) {
+        data += "v " + QByteArray::number(v.x()) + ' ' + QByteArray::number(v.y()) + ' '
+                + QByteArray::number(v.z()) + '\n';
+    }
+    for (const QVector2D &vt : mesh.uvs) {
+        data += "vt " + QByteArray::number(vt.x()) + ' ' + QByteArray::number(vt.y()) + '\n';
+    }
+    for (const QVector3D &vn : mesh.normals) {
+        data += "vn " + QByteArray::number(vn.x()) + ' ' + QByteArray::number(vn.y()) + ' '
+                + QByteArray::number(vn.z()) + '\n';
+    }
+    for (int i = 0; i < mesh.corners.size(); i += 3) {
+        data += 'f';
+        for (int k = 0; k < 3; k++) {
+            const MeshCorner &corner = mesh.corners[i + k];
+            data += ' ' + QByteArray::number(corner.position + 1) + '/' + QByteArray::number(corner.uv + 1) + '/'
+                    + QByteArray::number(corner.normal + 1);
+        }
+        data += '\n';
+    }
+    return data;
+}
+
+static void addTriangle(MeshData &mesh, int a, int b, int c, const QVector3D &outward) {
+    // kolejność wierzchołków dobierana jest tak, aby ściana była zwrócona na zewnątrz (przeciwnie do wskazówek zegara)
+    QVector3D normal = QVector3D::crossProduct(mesh.positions[b] - mesh.positions[a],
+                                               mesh.positions[c] - mesh.positions[a]).normalized();
+    if (QVector3D::dotProduct(normal, outward) < 0.0f) {
+        qSwap(b, c);
+        normal = -normal;
+    }
+    const int n = mesh.normals.size();
+    mesh.normals.append(normal);
+    mesh.corners.append(MeshCorner{a, 0, n});
+    mesh.corners.append(MeshCorner{b, 0, n});
+    mesh.corners.append(MeshCorner{c, 0, n});
+}
+
+MeshData MeshRegistry::reduceArrow(const MeshData &arrow, int sides) {
+    sides = qMax(3, sides);
+
+    // wymiary odczytywane są z pełnej siatki: wierzchołek grotu, najszersze miejsce grotu i dolny pierścień trzonu
+    float tipY = 0.0f;
+    float bottomY = 0.0f;
+    float headY = 0.0f;
+    float headRadius = 0.0f;
+    for (const QVector3D &v : arrow.positions) {
+        tipY = qMax(tipY, v.y());
+        bottomY = qMin(bottomY, v.y());
+        const float radius = qSqrt(v.x() * v.x() + v.z() * v.z());
+        if (radius > headRadius) {
+            headRadius = radius;
+            headY = v.y();
+        }
+    }
+    float shaftRadius = 0.0f;
+    for (const QVector3D &v : arrow.positions) {
+        if (v.y() < headY) {
+            shaftRadius = qMax(shaftRadius, qSqrt(v.x() * v.x() + v.z() * v.z()));
+        }
+    }
+
+    MeshData mesh;
+    mesh.uvs.append(QVector2D(0.5f, 0.5f));
+    mesh.positions.append(QVector3D(0.0f, tipY, 0.0f));
+    const int head = 1;
+    const int shaftTop = head + sides;
+    const int shaftBottom = shaftTop + sides;
+    const float radii[] = {headRadius, shaftRadius, shaftRadius};
+    const float heights[] = {headY, headY, bottomY};
+    for (int ring = 0; ring < 3; ring++) {
+        for (int k = 0; k < sides; k++) {
+            const float angle = 2.0f * static_cast<float>(M_PI) * k / sides;
+            mesh.positions.append(QVector3D(radii[ring] * qSin(angle), heights[ring], -radii[ring] * qCos(angle)));
+        }
+    }
+
+    const QVector3D down(0.0f, -1.0f, 0.0f);
+    for (int k = 0; k < sides; k++) {
+        const int next = (k + 1) % sides;
+        const float angle = 2.0f * static_cast<float>(M_PI) * (k + 0.5f) / sides;
+        const QVector3D radial(qSin(angle), 0.0f, -qCos(angle));
+        // grot
+        addTriangle(mesh, 0, head + k, head + next, radial);
+        // spód grotu
+        addTriangle(mesh, head + k, shaftTop + k, shaftTop + next, down);
+        addTriangle(mesh, head + k, shaftTop + next, head + next, down);
+        // trzon
+        addTriangle(mesh, shaftTop + k, shaftBottom + k, shaftBottom + next, radial);
+        addTriangle(mesh, shaftTop + k, shaftBottom + next, shaftTop + next, radial);
+    }
+    // podstawa trzonu
+    for (int k = 1; k + 1 < sides; k++) {
+        addTriangle(mesh, shaftBottom, shaftBottom + k, shaftBottom + k + 1, down);
+    }
+    return mesh;
+}
+
+ArrowDetail selectArrowDetail(int glyphCount, float zoomLevel, qint64 triangleBudget) {
+    // powyżej dwukrotnego przybliżenia budżet już nie rośnie, żeby liczba trójkątów pozostała ograniczona
+    const float zoom = qBound(1.0f, zoomLevel, 200.0f) / 100.0f;
+    const double budget = triangleBudget * static_cast<double>(zoom) * zoom;
+    const MeshRegistry &registry = MeshRegistry::instance();
+    const int levelCount = sizeof(arrowDetailLevels) / sizeof(arrowDetailLevels[0]);
+    for (int level = 0; level < levelCount - 1; level++) {
+        if (static_cast<double>(glyphCount) * registry.mesh(arrowDetailLevels[level]).triangleCount() <= budget) {
+            return ArrowDetail{arrowDetailLevels[level], level};
+        }
+    }
+    return ArrowDetail{arrowDetailLevels[levelCount - 1], levelCount - 1};
+}
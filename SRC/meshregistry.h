@@ -0,0 +1,182 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QVector>
+#include <QtGui/QVector2D>
+#include <QtGui/QVector3D>
+
+/**
+ * @brief MeshId - identyfikatory siatek dostępnych w zasobach programu (resources.qrc) lub z nich wygenerowanych
+ */
+
+enum class MeshId
+{
+    Arrow = 0,
+    Sphere = 1,
+    Cone = 2,        ///< stożek o trzech ścianach bocznych w obrysie strzałki, najniższy poziom szczegółów strzałki
+    ArrowReduced = 3 ///< strzałka o wymiarach arrow.obj z sześcioma ścianami bocznymi, generowana przy starcie
+};
+
+/**
+ * @brief MeshCorner - wierzchołek trójkąta, indeksy do tablic MeshData (jak w zapisie "f v/vt/vn" pliku OBJ)
+ */
+
+struct MeshCorner
+{
+    int position;
+    int uv;
+    int normal;
+};
+
+/**
+ * @brief MeshData - siatka wczytana z pliku OBJ, ściany rozbite na trójkąty
+ */
+
+struct MeshData
+{
+    QVector<QVector3D> positions;
+    QVector<QVector2D> uvs;
+    QVector<QVector3D> normals;
+
+    /**
+     * @brief corners - wierzchołki kolejnych trójkątów, po trzy na trójkąt
+     */
+
+    QVector<MeshCorner> corners;
+
+    /**
+     * @brief triangleCount - liczba trójkątów siatki
+     */
+
+    int triangleCount() const { return corners.size() / 3; }
+
+    /**
+     * @brief memoryUsage - przybliżona ilość pamięci zajmowanej przez siatkę
+     * @return liczba bajtów
+     */
+
+    qint64 memoryUsage() const;
+};
+
+/**
+ * @brief MeshRegistry - rejestr siatek, który przechowuje jedną sparsowaną kopię każdego pliku OBJ z zasobów na
+ * potrzeby programu: liczenia trójkątów, generowania uproszczonych siatek i łączenia strzałek w jedną siatkę.
+ * Nie zastępuje wczytywania w QtDataVisualization - renderer nadal sam parsuje plik podany w setMeshFile
+ * lub setUserDefinedMesh, raz dla każdej ścieżki.
+ */
+
+class MeshRegistry
+{
+public:
+    /**
+     * @brief instance - zwraca jedyną instancję rejestru, przy pierwszym wywołaniu wczytuje wszystkie siatki
+     */
+
+    static MeshRegistry &instance();
+
+    /**
+     * @brief mesh - zwraca sparsowaną geometrię siatki
+     * @param id - identyfikator siatki
+     */
+
+    const MeshData &mesh(MeshId id) const;
+
+    /**
+     * @brief meshFile - zwraca ścieżkę siatki, którą należy przekazać do QCustom3DItem::setMeshFile
+     * i QAbstract3DSeries::setUserDefinedMesh. Renderer przechowuje wczytane siatki według tej ścieżki,
+     * więc wszystkie obiekty korzystające z tego samego napisu współdzielą jedną kopię geometrii na GPU.
+     * @param id - identyfikator siatki
+     */
+
+    const QString &meshFile(MeshId id) const;
+
+    /**
+     * @brief loadTimeNs - czas wczytania i sparsowania wszystkich siatek przez rejestr (bez parsowania w rendererze)
+     * @return czas w nanosekundach
+     */
+
+    qint64 loadTimeNs() const { return m_loadTimeNs; }
+
+    /**
+     * @brief memoryUsage - pamięć zajmowana przez wszystkie wczytane siatki
+     * @return liczba bajtów
+     */
+
+    qint64 memoryUsage() const;
+
+    /**
+     * @brief parseObj - parsuje zawartość pliku OBJ, wielokąty dzielone są na trójkąty
+     * @param data - zawartość pliku
+     * @return sparsowana siatka
+     */
+
+    static MeshData parseObj(const QByteArray &data);
+
+    /**
+     * @brief writeObj - zapisuje siatkę w formacie OBJ
+     * @param mesh - siatka
+     * @return zawartość pliku
+     */
+
+    static QByteArray writeObj(const MeshData &mesh);
+
+    /**
+     * @brief reduceArrow - buduje uproszczoną strzałkę (stożek grotu i graniastosłup trzonu) o wymiarach
+     * grotu i trzonu odczytanych z pełnej siatki strzałki
+     * @param arrow - pełna siatka strzałki, oś wzdłuż Y, grot skierowany w stronę dodatnich Y
+     * @param sides - liczba ścian bocznych, co najmniej 3
+     * @return uproszczona siatka
+     */
+
+    static MeshData reduceArrow(const MeshData &arrow, int sides);
+
+private:
+    MeshRegistry();
+
+    static constexpr int resourceMeshCount = 3;
+
+    static constexpr int meshCount = 4;
+
+    MeshData m_meshes[meshCount];
+
+    QString m_meshFiles[meshCount];
+
+    /**
+     * @brief m_generatedDirectory - katalog plików OBJ siatek generowanych przy starcie; renderer wczytuje siatki
+     * wyłącznie z plików
+     */
+
+    QTemporaryDir m_generatedDirectory;
+
+    qint64 m_loadTimeNs = 0;
+};
+
+/**
+ * @brief defaultArrowTriangleBudget - liczba trójkątów na klatkę, jaką mogą zająć strzałki przy domyślnym
+ * przybliżeniu kamery (100%)
+ */
+
+constexpr qint64 defaultArrowTriangleBudget = 1000000;
+
+/**
+ * @brief ArrowDetail - poziom szczegółów strzałki wybrany przez selectArrowDetail
+ */
+
+struct ArrowDetail
+{
+    MeshId mesh = MeshId::Arrow; ///< siatka strzałki
+    int level = 0;               ///< 0 - pełna siatka, kolejne poziomy coraz prostsze
+};
+
+/**
+ * @brief selectArrowDetail - wybiera najdokładniejszą siatkę strzałki, dla której wszystkie strzałki mieszczą się
+ * w budżecie trójkątów na klatkę. Budżet rośnie z kwadratem przybliżenia kamery, bo strzałki zajmują wtedy więcej
+ * pikseli ekranu (do przybliżenia 200%); przy oddalonej kamerze drobne szczegóły strzałek i tak nie są widoczne.
+ * @param glyphCount - liczba wyświetlanych strzałek
+ * @param zoomLevel - przybliżenie kamery w procentach (Q3DCamera::zoomLevel), odwrotnie proporcjonalne do odległości
+ * @param triangleBudget - budżet trójkątów na klatkę przy przybliżeniu 100%
+ * @return wybrany poziom szczegółów
+ */
+
+ArrowDetail selectArrowDetail(int glyphCount, float zoomLevel, qint64 triangleBudget = defaultArrowTriangleBudget);
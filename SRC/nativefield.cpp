@@ -0,0 +1,334 @@
+#include "nativefield.h"
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QLibrary>
+#include <QtCore/QMutex>
+#include <QtCore/QProcess>
+#include <QtCore/QStandardPaths>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <locale>
+#include <random>
+#include <sstream>
+#include <vector>
+
+static const char *const entryPoint = "vfv_field_batch";
+
+static const int compileTimeoutMs = 60000;
+
+static QStringList compilerFlags() {
+    // -ffp-contract=off zabrania łączenia mnożenia z dodawaniem w FMA, dzięki czemu wyniki są identyczne
+    // z maszyną wirtualną, a statystyki siatki nie zależą od wybranego wykonawcy wyrażeń
+    return {QStringLiteral("-std=c++17"), QStringLiteral("-O3"), QStringLiteral("-march=native"),
+            QStringLiteral("-fno-math-errno"), QStringLiteral("-ffp-contract=off"),
+            QStringLiteral("-shared"), QStringLiteral("-fPIC")};
+}
+
+static QByteArray targetDescription(const QString &compilerPath) {
+    // -march=native daje różny kod na różnych procesorach, a katalog podręczny może być współdzielony
+    // (katalog domowy w sieci, kopia profilu), więc klucz zawiera makra celu, które kompilator ustala dla tego
+    // procesora (__AVX2__, __FMA__, ...); wynik jest zapamiętywany, żeby nie uruchamiać kompilatora przy każdym polu
+    static QMutex mutex;
+    static QHash<QString, QByteArray> targets;
+    QMutexLocker locker(&mutex);
+    const auto cached = targets.constFind(compilerPath);
+    if (cached != targets.constEnd()) {
+        return cached.value();
+    }
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    process.start(compilerPath, {QStringLiteral("-march=native"), QStringLiteral("-dM"), QStringLiteral("-E"),
+                                 QStringLiteral("-x"), QStringLiteral("c++"), QStringLiteral("-")});
+    process.closeWriteChannel();
+    QByteArray target;
+    if (process.waitForFinished(compileTimeoutMs)) {
+        target = process.readAll();
+    } else {
+        process.kill();
+        process.waitForFinished();
+    }
+    targets.insert(compilerPath, target);
+    return target;
+}
+
+static QString librarySuffix() {
+#if defined(Q_OS_WIN)
+    return QStringLiteral(".dll");
+#elif defined(Q_OS_MACOS)
+    return QStringLiteral(".dylib");
+#else
+    return QStringLiteral(".so");
+#endif
+}
+
+static std::string floatLiteral(float value) {
+    // zapis szesnastkowy odtwarza stałą co do bitu, niezależnie od ustawień regionalnych
+    if (std::isnan(value)) {
+        return "__builtin_nanf(\"\")";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "__builtin_inff()" : "(-__builtin_inff())";
+    }
+    std::ostringstream stream;
+    stream.imbue(std::locale::classic());
+    stream << std::hexfloat << value << 'f';
+    return "(" + stream.str() + ")";
+}
+
+static const char *functionName(FieldExpression::Op op) {
+    using Op = FieldExpression::Op;
+    switch (op) {
+    case Op::Sin: return "std::sin";
+    case Op::Cos: return "std::cos";
+    case Op::Tan: return "std::tan";
+    case Op::Asin: return "std::asin";
+    case Op::Acos: return "std::acos";
+    case Op::Atan: return "std::atan";
+    case Op::Sinh: return "std::sinh";
+    case Op::Cosh: return "std::cosh";
+    case Op::Tanh: return "std::tanh";
+    case Op::Exp: return "std::exp";
+    case Op::Log: return "std::log";
+    case Op::Sqrt: return "std::sqrt";
+    case Op::Abs: return "std::fabs";
+    default: return nullptr;
+    }
+}
+
+QByteArray NativeField::generateSource(const FieldExpression &expression) {
+    using Op = FieldExpression::Op;
+
+    std::string source = "// wygenerowane przez NativeField::generateSource\n";
+    const char *names[3] = {"P", "Q", "R"};
+    for (int component = 0; component < 3; component++) {
+        std::string text = expression.source(component);
+        for (char &c : text) {
+            if (c == '\n' || c == '\r') {
+                c = ' ';
+            }
+        }
+        source += std::string("// ") + names[component] + " = " + text + "\n";
+    }
+    source += "#include <cmath>\n"
+              "#ifdef _WIN32\n"
+              "#define VFV_EXPORT extern \"C\" __declspec(dllexport)\n"
+              "#else\n"
+              "#define VFV_EXPORT extern \"C\" __attribute__((visibility(\"default\")))\n"
+              "#endif\n\n"
+              "VFV_EXPORT void " + std::string(entryPoint) + "(const float *__restrict x, const float *__restrict y, "
+              "const float *__restrict z, float *__restrict vx, float *__restrict vy, float *__restrict vz, "
+              "int count, float a, float b, float c) {\n"
+              "    for (int i = 0; i < count; i++) {\n";
+
+    // rejestry maszyny wirtualnej są używane wielokrotnie, w kodzie C++ każda instrukcja dostaje własną
+    // stałą t<n>, a registerValue wskazuje, która z nich jest aktualnie w danym rejestrze
+    std::vector<std::string> registerValue(static_cast<size_t>(expression.registerCount()));
+    const std::vector<FieldExpression::Instruction> &code = expression.code();
+    for (size_t n = 0; n < code.size(); n++) {
+        const FieldExpression::Instruction &instruction = code[n];
+        const std::string &l = registerValue[instruction.lhs];
+        const std::string &r = registerValue[instruction.rhs];
+        std::string value;
+        switch (instruction.op) {
+        case Op::Const: value = floatLiteral(instruction.value); break;
+        case Op::X: value = "x[i]"; break;
+        case Op::Y: value = "y[i]"; break;
+        case Op::Z: value = "z[i]"; break;
+        case Op::ParamA: value = "a"; break;
+        case Op::ParamB: value = "b"; break;
+        case Op::ParamC: value = "c"; break;
+        case Op::Add: value = l + " + " + r; break;
+        case Op::Sub: value = l + " - " + r; break;
+        case Op::Mul: value = l + " * " + r; break;
+        case Op::Div: value = l + " / " + r; break;
+        case Op::Pow: value = "std::pow(" + l + ", " + r + ")"; break;
+        case Op::Neg: value = "-" + l; break;
+        default: value = std::string(functionName(instruction.op)) + "(" + l + ")"; break;
+        }
+        const std::string name = "t" + std::to_string(n);
+        source += "        const float " + name + " = " + value + ";\n";
+        registerValue[instruction.dst] = name;
+    }
+    source += "        vx[i] = " + registerValue[expression.outputRegister(0)] + ";\n"
+              "        vy[i] = " + registerValue[expression.outputRegister(1)] + ";\n"
+              "        vz[i] = " + registerValue[expression.outputRegister(2)] + ";\n"
+              "    }\n"
+              "}\n";
+    return QByteArray::fromStdString(source);
+}
+
+QString NativeField::compiler() {
+    const QString fromEnvironment = qEnvironmentVariable("CXX");
+    if (!fromEnvironment.isEmpty()) {
+        return QStandardPaths::findExecutable(fromEnvironment).isEmpty() && !QFile::exists(fromEnvironment)
+               ? QString() : fromEnvironment;
+    }
+    for (const char *name : {"c++", "g++", "clang++"}) {
+        const QString path = QStandardPaths::findExecutable(QString::fromLatin1(name));
+        if (!path.isEmpty()) {
+            return path;
+        }
+    }
+    return QString();
+}
+
+QString NativeField::cacheDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/native-fields");
+}
+
+NativeField::~NativeField() {
+    if (m_library) {
+        m_library->unload();
+    }
+}
+
+QString NativeField::libraryPath() const {
+    return m_library ? m_library->fileName() : QString();
+}
+
+std::shared_ptr<const NativeField> NativeField::load(const FieldExpression &expression, QString *error) {
+    const QString compilerPath = compiler();
+    if (compilerPath.isEmpty()) {
+        *error = QStringLiteral("no C++ compiler found (set CXX or install g++/clang++)");
+        return nullptr;
+    }
+
+    const QByteArray source = generateSource(expression);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(source);
+    hash.addData(compilerPath.toUtf8());
+    hash.addData(compilerFlags().join(QLatin1Char(' ')).toUtf8());
+    hash.addData(targetDescription(compilerPath));
+    const QString key = QString::fromLatin1(hash.result().toHex());
+
+    const QDir directory(cacheDirectory());
+    if (!directory.mkpath(QStringLiteral("."))) {
+        *error = QStringLiteral("cannot create cache directory %1").arg(directory.path());
+        return nullptr;
+    }
+    const QString libraryPath = directory.filePath(QStringLiteral("field-") + key + librarySuffix());
+
+    std::shared_ptr<NativeField> field(new NativeField);
+    field->m_fromCache = QFile::exists(libraryPath);
+    if (!field->m_fromCache) {
+        // kompilacja do plików tymczasowych i zmiana nazwy na końcu, dzięki czemu inny proces
+        // kompilujący to samo wyrażenie nigdy nie zobaczy niekompletnej biblioteki
+        static std::atomic<int> compilation(0);
+        const QString suffix = QStringLiteral(".%1-%2.tmp").arg(QCoreApplication::applicationPid()).arg(compilation++);
+        const QString sourcePath = directory.filePath(QStringLiteral("field-") + key + suffix + QStringLiteral(".cpp"));
+        const QString temporaryLibrary = directory.filePath(QStringLiteral("field-") + key + suffix + librarySuffix());
+        QFile sourceFile(sourcePath);
+        if (!sourceFile.open(QIODevice::WriteOnly) || sourceFile.write(source) != source.size()) {
+            *error = QStringLiteral("cannot write %1").arg(sourcePath);
+            return nullptr;
+        }
+        sourceFile.close();
+
+        QElapsedTimer timer;
+        timer.start();
+        QProcess process;
+        process.setProcessChannelMode(QProcess::MergedChannels);
+        process.start(compilerPath, compilerFlags() << QStringLiteral("-o") << temporaryLibrary << sourcePath);
+        const bool finished = process.waitForFinished(compileTimeoutMs);
+        field->m_compileTimeNs = timer.nsecsElapsed();
+        if (!finished) {
+            process.kill();
+            process.waitForFinished();
+        }
+        const QString output = QString::fromLocal8Bit(process.readAll()).trimmed();
+        QFile::remove(sourcePath);
+        if (!finished || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+            QFile::remove(temporaryLibrary);
+            *error = QStringLiteral("%1 failed: %2").arg(compilerPath, finished ? output : process.errorString());
+            return nullptr;
+        }
+        if (!QFile::rename(temporaryLibrary, libraryPath)) {
+            // inny proces zdążył zapisać tę samą bibliotekę
+            QFile::remove(temporaryLibrary);
+        }
+    }
+
+    field->m_library.reset(new QLibrary(libraryPath));
+    field->m_kernel = reinterpret_cast<BatchKernel>(field->m_library->resolve(entryPoint));
+    if (!field->m_kernel) {
+        *error = field->m_library->errorString();
+        if (field->m_fromCache) {
+            // uszkodzony wpis katalogu podręcznego - następne wywołanie skompiluje pole od nowa
+            field->m_library->unload();
+            QFile::remove(libraryPath);
+        }
+        return nullptr;
+    }
+    return field;
+}
+
+QString benchmarkNativeFields(int pointCount) {
+    struct Case
+    {
+        const char *name;
+        const char *p;
+        const char *q;
+        const char *r;
+    };
+    static const Case cases[] = {
+        {"linear", "a*x", "b*y", "c*z"},
+        {"sin", "sin(a*x)", "b*sin(y)", "c*sin(z)"},
+        {"mixed", "sin(a*x)*cos(y) + z^2", "b*exp(-(x*x+y*y)/10)", "c*sqrt(abs(x*y*z)) - atan(z)"},
+    };
+
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::vector<float> x(pointCount), y(pointCount), z(pointCount);
+    for (int i = 0; i < pointCount; i++) {
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+        z[i] = distribution(generator);
+    }
+    std::vector<float> vx(pointCount), vy(pointCount), vz(pointCount);
+
+    auto measure = [&](const std::function<void()> &run) {
+        int runs = 0;
+        QElapsedTimer timer;
+        timer.start();
+        do {
+            run();
+            runs++;
+        } while (timer.elapsed() < 200);
+        return static_cast<double>(runs) * pointCount / (timer.nsecsElapsed() / 1.0e9) / 1.0e6;
+    };
+
+    QString report = QStringLiteral("field    VM Mpoints/s  native Mpoints/s  compile ms  (%1)\n").arg(NativeField::compiler());
+    for (const Case &test : cases) {
+        std::string expressionError;
+        auto expression = FieldExpression::compile(test.p, test.q, test.r, &expressionError);
+        if (!expression) {
+            report += QStringLiteral("%1: %2\n").arg(test.name, QString::fromStdString(expressionError));
+            continue;
+        }
+        QString error;
+        auto native = NativeField::load(*expression, &error);
+        if (!native) {
+            report += QStringLiteral("%1: %2\n").arg(test.name, error);
+            continue;
+        }
+        const double vm = measure([&]() {
+            expression->evaluate(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+        });
+        const BatchKernel kernel = native->kernel();
+        const double compiled = measure([&]() {
+            kernel(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), pointCount, 2.0f, 1.5f, 0.5f);
+        });
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-8s %13.1f  %16.1f  %10s\n", test.name, vm, compiled,
+                      native->fromCache() ? "cached" : QByteArray::number(native->compileTimeNs() / 1.0e6, 'f', 1).constData());
+        report += QString::fromLatin1(line);
+    }
+    return report;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QtCore/QString>
+
+#include <memory>
+
+#include "fieldexpression.h"
+#include "fieldkernels.h"
+
+class QLibrary;
+
+/**
+ * @brief NativeField - pole użytkownika skompilowane do kodu maszynowego kompilatorem systemowym.
+ *
+ * Kod bajtowy FieldExpression tłumaczony jest na jednostkę translacji C++ z funkcją o postaci BatchKernel,
+ * kompilowaną (gcc lub clang, -O3 -march=native) do biblioteki współdzielonej i ładowaną przez QLibrary.
+ * Biblioteki przechowywane są w katalogu podręcznym pod nazwą wyznaczoną ze skrótu SHA-1 kodu źródłowego,
+ * kompilatora, opcji i makr celu, które kompilator ustala dla -march=native na tym procesorze, więc to samo
+ * wyrażenie przy kolejnym uruchomieniu ładowane jest bez kompilacji, a biblioteka z innego procesora nie jest używana.
+ */
+
+class NativeField
+{
+public:
+    ~NativeField();
+
+    /**
+     * @brief load - zwraca skompilowane pole, kompilując je, jeśli nie ma go w katalogu podręcznym.
+     * Kompilacja trwa od kilkuset milisekund do kilku sekund, dlatego funkcję należy wywoływać poza wątkiem interfejsu.
+     * @param expression - skompilowane wyrażenia pola
+     * @param error - opis błędu, jeśli pola nie udało się skompilować lub załadować
+     * @return pole lub nullptr, np. gdy w systemie nie ma kompilatora - należy wtedy użyć FieldExpression::evaluate
+     */
+
+    static std::shared_ptr<const NativeField> load(const FieldExpression &expression, QString *error);
+
+    /**
+     * @brief generateSource - tworzy kod źródłowy C++ z funkcją vfv_field_batch wyznaczającą pole
+     * @param expression - skompilowane wyrażenia pola
+     */
+
+    static QByteArray generateSource(const FieldExpression &expression);
+
+    /**
+     * @brief compiler - ścieżka kompilatora: zmienna środowiskowa CXX, a gdy jej brak - c++, g++ lub clang++ z PATH
+     * @return ścieżka lub pusty napis, gdy kompilator nie został znaleziony
+     */
+
+    static QString compiler();
+
+    /**
+     * @brief cacheDirectory - katalog, w którym przechowywane są skompilowane biblioteki
+     */
+
+    static QString cacheDirectory();
+
+    /**
+     * @brief kernel - funkcja wyznaczająca wektory pola; ważna, dopóki istnieje obiekt NativeField
+     */
+
+    BatchKernel kernel() const { return m_kernel; }
+
+    /**
+     * @brief libraryPath - ścieżka załadowanej biblioteki
+     */
+
+    QString libraryPath() const;
+
+    /**
+     * @brief fromCache - true jeśli biblioteka była już w katalogu podręcznym i nie trzeba było jej kompilować
+     */
+
+    bool fromCache() const { return m_fromCache; }
+
+    /**
+     * @brief compileTimeNs - czas kompilacji, 0 jeśli biblioteka pochodziła z katalogu podręcznego
+     */
+
+    qint64 compileTimeNs() const { return m_compileTimeNs; }
+
+private:
+    NativeField() = default;
+
+    std::unique_ptr<QLibrary> m_library;
+
+    BatchKernel m_kernel = nullptr;
+
+    bool m_fromCache = false;
+
+    qint64 m_compileTimeNs = 0;
+};
+
+/**
+ * @brief benchmarkNativeFields - porównuje przepustowość maszyny wirtualnej z polami skompilowanymi do kodu natywnego
+ * @param pointCount - liczba punktów w jednym przebiegu
+ * @return tabela wyników w postaci tekstu
+ */
+
+QString benchmarkNativeFields(int pointCount);
@@ -0,0 +1,210 @@
+#include "parametersweep.h"
+#include "scatter.h"
+#include "videostreamwriter.h"
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QImage>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Kolejka o ograniczonej długości między etapami animacji: push czeka na wolne miejsce, pop na element.
+// Po zamknięciu push odrzuca nowe elementy, a pop oddaje jeszcze te, które już są w kolejce.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity) : m_capacity(static_cast<size_t>(qMax(1, capacity))) {}
+
+    bool push(T value) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]() { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(value));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T &value) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return false;
+        }
+        value = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    const size_t m_capacity;
+    std::deque<T> m_items;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
+
+struct FrameRequest
+{
+    int frame = 0;
+    bool compute = false; ///< false - klatka używa strzałek poprzedniej klatki
+    FieldParameters params;
+};
+
+struct ComputedFrame
+{
+    int frame = 0;
+    bool compute = false;
+    PreparedGlyphs prepared;
+    qint64 timeNs = 0;
+};
+
+}
+
+ParameterSweep::ParameterSweep(Scatter *scatter, Q3DScatter *graph)
+        : m_scatter(scatter),
+          m_graph(graph) {
+}
+
+SweepResult ParameterSweep::run(const SweepOptions &options, const ApplyFrame &apply, VideoStreamWriter &writer) {
+    SweepResult result;
+    QElapsedTimer total;
+    total.start();
+
+    BoundedQueue<FrameRequest> requests(options.queueDepth);
+    BoundedQueue<ComputedFrame> computed(options.queueDepth);
+    BoundedQueue<QImage> frames(options.queueDepth);
+    std::atomic<bool> aborted{false};
+
+    // wątek obliczeń przekazuje bazę pola z klatki do klatki niezależnie od tego, kiedy klatki trafią do wykresu
+    std::thread computeThread([&]() {
+        std::shared_ptr<const FieldBasis> basis;
+        const CancelCheck cancelled = [&aborted]() { return aborted.load(); };
+        FrameRequest request;
+        while (requests.pop(request)) {
+            ComputedFrame frame;
+            frame.frame = request.frame;
+            frame.compute = request.compute;
+            if (request.compute) {
+                if (basis) {
+                    request.params.basis = basis;
+                }
+                QElapsedTimer timer;
+                timer.start();
+                frame.prepared = prepareGlyphs(request.params, 0, cancelled);
+                frame.timeNs = timer.nsecsElapsed();
+                basis = frame.prepared.basis;
+            }
+            if (!computed.push(std::move(frame))) {
+                break;
+            }
+        }
+        computed.close();
+    });
+
+    QString writeError;
+    std::thread writeThread([&]() {
+        QImage image;
+        while (frames.pop(image)) {
+            if (!writeError.isEmpty()) {
+                continue;
+            }
+            QElapsedTimer timer;
+            timer.start();
+            if (!writer.writeFrame(image)) {
+                writeError = writer.errorString();
+                aborted = true;
+            }
+            result.writeTimeNs += timer.nsecsElapsed();
+        }
+    });
+
+    // parametry klatki wysyłane są do obliczeń z wyprzedzeniem, a przed renderowaniem klatki jej parametry
+    // ustawiane są ponownie, bo wykres mógł już przejść do jednej z następnych
+    int issued = 0;
+    auto issue = [&]() {
+        const bool compute = issued == 0 || options.fieldChanges;
+        if (compute) {
+            apply(issued);
+        }
+        requests.push(FrameRequest{issued, compute, compute ? m_scatter->parameters() : FieldParameters()});
+        issued++;
+    };
+    while (issued < qMin(options.queueDepth, options.frameCount)) {
+        issue();
+    }
+
+    for (int frame = 0; frame < options.frameCount && !aborted; frame++) {
+        QElapsedTimer timer;
+        timer.start();
+        ComputedFrame ready;
+        if (!computed.pop(ready)) {
+            break;
+        }
+        result.stallTimeNs += timer.nsecsElapsed();
+        apply(frame);
+        if (ready.compute) {
+            if (ready.prepared.cancelled) {
+                break;
+            }
+            result.computeTimeNs += ready.timeNs;
+            (ready.prepared.rescaled ? result.rescaledFrames : result.sampledFrames)++;
+            timer.restart();
+            m_scatter->showPreparedGlyphs(std::move(ready.prepared));
+            result.uploadTimeNs += timer.nsecsElapsed();
+        } else {
+            result.reusedFrames++;
+        }
+
+        timer.restart();
+        const QImage image = m_graph->renderToImage(options.samples, options.size);
+        result.renderTimeNs += timer.nsecsElapsed();
+        if (image.isNull()) {
+            result.error = QStringLiteral("Nie udało się wyrenderować klatki %1").arg(frame);
+            aborted = true;
+            break;
+        }
+        timer.restart();
+        if (!frames.push(image)) {
+            break;
+        }
+        result.stallTimeNs += timer.nsecsElapsed();
+        if (issued < options.frameCount) {
+            issue();
+        }
+    }
+
+    // zamknięcie kolejek zwalnia wątki czekające na miejsce, jeśli zapis został przerwany
+    requests.close();
+    computed.close();
+    frames.close();
+    computeThread.join();
+    writeThread.join();
+
+    result.frames = writer.frameCount();
+    result.bytes = writer.bytesWritten();
+    if (result.error.isEmpty()) {
+        result.error = writeError;
+    }
+    result.ok = result.error.isEmpty() && result.frames == options.frameCount;
+    if (result.error.isEmpty() && !result.ok) {
+        result.error = QStringLiteral("Zapisano %1 z %2 klatek").arg(result.frames).arg(options.frameCount);
+    }
+    result.totalTimeNs = total.nsecsElapsed();
+    return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QtDataVisualization/q3dscatter.h>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+
+#include <functional>
+
+using namespace QtDataVisualization;
+
+class Scatter;
+class VideoStreamWriter;
+
+/**
+ * @brief SweepOptions - parametry animacji zapisywanej przez ParameterSweep
+ */
+
+struct SweepOptions
+{
+    int frameCount = 0;       ///< liczba klatek
+    QSize size;               ///< rozmiar klatek w pikselach
+    int samples = 4;          ///< liczba próbek wygładzania krawędzi
+    int queueDepth = 3;       ///< o ile klatek obliczenia mogą wyprzedzać renderowanie, a renderowanie zapis
+    bool fieldChanges = true; ///< czy zmieniany parametr wpływa na strzałki; false (np. kamera) - strzałki
+                              ///< pierwszej klatki używane są we wszystkich klatkach
+};
+
+/**
+ * @brief SweepResult - wynik, liczniki i czasy etapów zapisu animacji
+ */
+
+struct SweepResult
+{
+    bool ok = false;
+    QString error;               ///< opis błędu, pusty gdy zapis się powiódł
+    int frames = 0;              ///< liczba zapisanych klatek
+    int sampledFrames = 0;       ///< klatki, dla których pole spróbkowano od nowa
+    int rescaledFrames = 0;      ///< klatki wyznaczone z bazy pola wcześniejszej klatki (FieldBasis)
+    int reusedFrames = 0;        ///< klatki korzystające ze strzałek poprzedniej klatki
+    qint64 computeTimeNs = 0;    ///< próbkowanie pola i budowanie strzałek w wątku obliczeń
+    qint64 uploadTimeNs = 0;     ///< przekazanie strzałek do wykresu w wątku GUI
+    qint64 renderTimeNs = 0;     ///< renderowanie klatek w wątku GUI
+    qint64 writeTimeNs = 0;      ///< konwersja i zapis klatek w wątku zapisu
+    qint64 stallTimeNs = 0;      ///< czas, w którym wątek GUI czekał na obliczenia lub na miejsce w kolejce zapisu
+    qint64 totalTimeNs = 0;      ///< czas całego zapisu
+    qint64 bytes = 0;            ///< rozmiar zapisanego strumienia
+
+    /**
+     * @brief framesPerSecond - liczba klatek na sekundę całego potoku
+     */
+
+    double framesPerSecond() const { return totalTimeNs > 0 ? frames * 1.0e9 / totalTimeNs : 0.0; }
+};
+
+/**
+ * @brief ParameterSweep - renderuje animację zmiany jednego parametru wykresu i zapisuje ją klatka po klatce do
+ * strumienia wideo (VideoStreamWriter), bez plików PNG dla pojedynczych klatek. Etapy działają jednocześnie:
+ * wątek obliczeń przygotowuje strzałki kolejnych klatek (prepareGlyphs), wątek GUI przekazuje je do wykresu
+ * i renderuje, a wątek zapisu konwertuje i zapisuje klatki już wyrenderowane. Kolejki między etapami mają
+ * ograniczoną długość (SweepOptions::queueDepth), więc pamięć nie rośnie z liczbą klatek. Baza pola przechodzi
+ * z klatki do klatki, dzięki czemu zmiana stałych a, b, c lub płaszczyzny odcinającej nie wymaga ponownego
+ * próbkowania pola.
+ */
+
+class ParameterSweep
+{
+public:
+    /**
+     * @brief ApplyFrame - ustawia w obiekcie Scatter i na wykresie wartość parametru dla podanej klatki;
+     * wywoływana w wątku GUI, także wielokrotnie i nie po kolei dla tej samej klatki
+     */
+
+    using ApplyFrame = std::function<void(int frame)>;
+
+    ParameterSweep(Scatter *scatter, Q3DScatter *graph);
+
+    /**
+     * @brief run - renderuje i zapisuje wszystkie klatki; strumień musi być już rozpoczęty (VideoStreamWriter::begin)
+     * @param options - liczba i rozmiar klatek
+     * @param apply - ustawia parametry kolejnych klatek
+     * @param writer - strumień, do którego zapisywane są klatki
+     */
+
+    SweepResult run(const SweepOptions& options, const ApplyFrame& apply, VideoStreamWriter& writer);
+
+private:
+    Scatter *m_scatter;
+    Q3DScatter *m_graph;
+};
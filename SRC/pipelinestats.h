@@ -0,0 +1,214 @@
+#pragma once
+
+#include <QtCore/QMetaType>
+
+/**
+ * @brief PipelineStage - etapy generowania strzałek, w kolejności wykonywania. Zmiana parametru powoduje
+ * wykonanie pierwszego etapu, na który ma wpływ, i wszystkich następnych; etapy wcześniejsze korzystają
+ * z wyników zachowanych z poprzedniego generowania.
+ */
+
+enum class PipelineStage
+{
+    Sample = 0,     ///< wartości pola w węzłach siatki (wątek roboczy)
+    Statistics = 1, ///< zakres długości i histogram (wątek roboczy)
+    Geometry = 2,   ///< położenie i obrót strzałek (wątek roboczy)
+    Style = 3,      ///< skalowanie i kolor strzałek
+    Upload = 4      ///< przekazanie strzałek do wykresu w wybranym trybie renderowania
+};
+
+/**
+ * @brief PipelineStats - liczniki ostatniego generowania strzałek, publikowane przez Scatter::statisticsChanged
+ */
+
+struct PipelineStats
+{
+    /**
+     * @brief sampledCount - liczba węzłów siatki, w których wyznaczono wartość pola
+     */
+
+    int sampledCount = 0;
+
+    /**
+     * @brief clippedCount - liczba węzłów odciętych płaszczyzną
+     */
+
+    int clippedCount = 0;
+
+    /**
+     * @brief invalidCount - liczba węzłów pominiętych, bo wartość pola nie była skończona (nieskończoność lub NaN)
+     */
+
+    int invalidCount = 0;
+
+    /**
+     * @brief emittedCount - liczba strzałek przekazanych do renderera
+     */
+
+    int emittedCount = 0;
+
+    /**
+     * @brief coalescedCount - łączna liczba zmian parametrów, które nie wywołały osobnej regeneracji
+     */
+
+    int coalescedCount = 0;
+
+    /**
+     * @brief threadCount - liczba wątków, na które podzielono próbkowanie
+     */
+
+    int threadCount = 1;
+
+    /**
+     * @brief rescaled - czy pole wyznaczono przez przeskalowanie bazy (zmieniły się tylko stałe a, b, c)
+     */
+
+    bool rescaled = false;
+
+    /**
+     * @brief sampleTimeNs - czas próbkowania pola
+     */
+
+    qint64 sampleTimeNs = 0;
+
+    /**
+     * @brief glyphTimeNs - czas budowania strzałek z próbek
+     */
+
+    qint64 glyphTimeNs = 0;
+
+    /**
+     * @brief renderTimeNs - czas przekazania strzałek do wykresu w wątku GUI
+     */
+
+    qint64 renderTimeNs = 0;
+
+    /**
+     * @brief restyledCount - liczba strzałek zaktualizowanych w miejscu przy ostatniej zmianie stylu
+     */
+
+    int restyledCount = 0;
+
+    /**
+     * @brief stage - pierwszy etap wykonany przy ostatniej aktualizacji strzałek
+     */
+
+    PipelineStage stage = PipelineStage::Sample;
+
+    /**
+     * @brief styleTimeNs - czas ostatniej zmiany stylu istniejących strzałek, razem z aktualizacją wykresu
+     */
+
+    qint64 styleTimeNs = 0;
+
+    /**
+     * @brief reusedItemCount - liczba obiektów QCustom3DItem z puli użytych ponownie przy ostatniej aktualizacji
+     */
+
+    int reusedItemCount = 0;
+
+    /**
+     * @brief createdItemCount - liczba obiektów QCustom3DItem utworzonych przy ostatniej aktualizacji
+     */
+
+    int createdItemCount = 0;
+
+    /**
+     * @brief destroyedItemCount - liczba obiektów QCustom3DItem usuniętych przy ostatniej aktualizacji
+     */
+
+    int destroyedItemCount = 0;
+
+    /**
+     * @brief triangleCount - liczba trójkątów strzałek przekazywanych do renderera w każdej klatce
+     */
+
+    qint64 triangleCount = 0;
+
+    /**
+     * @brief detailLevel - poziom szczegółów siatki strzałek, 0 - pełna siatka arrow.obj
+     */
+
+    int detailLevel = 0;
+
+    /**
+     * @brief meshTriangleCount - liczba trójkątów połączonej siatki strzałek
+     */
+
+    int meshTriangleCount = 0;
+
+    /**
+     * @brief meshVertexBytes - rozmiar bufora wierzchołków połączonej siatki
+     */
+
+    qint64 meshVertexBytes = 0;
+
+    /**
+     * @brief meshFileBytes - rozmiar pliku OBJ połączonej siatki
+     */
+
+    qint64 meshFileBytes = 0;
+
+    /**
+     * @brief meshBuildTimeNs - czas ostatniej przebudowy połączonej siatki, razem z zapisem pliku
+     */
+
+    qint64 meshBuildTimeNs = 0;
+
+    /**
+     * @brief interactionStride - średnio co która strzałka jest wyświetlana, 1 - wszystkie (kamera nieruchoma)
+     */
+
+    int interactionStride = 1;
+
+    /**
+     * @brief displayedCount - liczba strzałek aktualnie wyświetlanych na wykresie
+     */
+
+    int displayedCount = 0;
+
+    /**
+     * @brief interactionFrameTimeNs - ostatni zmierzony czas klatki w trakcie ruchu kamery
+     */
+
+    qint64 interactionFrameTimeNs = 0;
+
+    /**
+     * @brief settledFrameTimeNs - ostatni zmierzony czas klatki ze wszystkimi strzałkami
+     */
+
+    qint64 settledFrameTimeNs = 0;
+
+    /**
+     * @brief firstGlyphTimeNs - czas od zlecenia generowania do wyświetlenia pierwszych strzałek; przy stopniowym
+     * próbkowaniu są to strzałki najrzadszego poziomu siatki
+     */
+
+    qint64 firstGlyphTimeNs = 0;
+
+    /**
+     * @brief fullDetailTimeNs - czas od zlecenia generowania do wyświetlenia strzałek pełnej siatki
+     */
+
+    qint64 fullDetailTimeNs = 0;
+
+    /**
+     * @brief previewLevelCount - liczba poziomów siatki wyświetlonych przed pełną siatką, 0 - bez podglądu
+     */
+
+    int previewLevelCount = 0;
+
+    /**
+     * @brief textureCount - liczba tekstur wysłanych do GPU
+     */
+
+    int textureCount = 0;
+
+    /**
+     * @brief textureUploadBytes - łączny rozmiar tekstur wysłanych do GPU
+     */
+
+    qint64 textureUploadBytes = 0;
+};
+
+Q_DECLARE_METATYPE(PipelineStats)
@@ -0,0 +1,227 @@
+#include "pngstreamwriter.h"
+#include <QtCore/QIODevice>
+#include <QtCore/QtEndian>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <zlib.h>
+
+// rozmiar bufora wyjściowego kompresji, a zarazem największego fragmentu IDAT
+constexpr int outputBufferSize = 64 * 1024;
+// przybliżona pamięć stanu kompresji zlib przy domyślnych parametrach deflateInit
+constexpr qint64 deflateStateBytes = 268 * 1024;
+
+enum PngFilter
+{
+    FilterNone = 0,
+    FilterSub = 1,
+    FilterUp = 2,
+    FilterAverage = 3,
+    FilterPaeth = 4
+};
+
+struct PngStreamWriter::Stream
+{
+    z_stream zlib;
+    bool initialized = false;
+};
+
+static uchar paeth(int left, int up, int upLeft) {
+    const int estimate = left + up - upLeft;
+    const int distanceLeft = std::abs(estimate - left);
+    const int distanceUp = std::abs(estimate - up);
+    const int distanceUpLeft = std::abs(estimate - upLeft);
+    if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) {
+        return static_cast<uchar>(left);
+    }
+    return static_cast<uchar>(distanceUp <= distanceUpLeft ? up : upLeft);
+}
+
+// suma bajtów filtrowanego wiersza traktowanych jako liczby ze znakiem - heurystyka wyboru filtra z libpng
+static quint64 signedSum(const uchar *data, int size) {
+    quint64 sum = 0;
+    for (int i = 0; i < size; i++) {
+        sum += data[i] < 128 ? data[i] : 256 - data[i];
+    }
+    return sum;
+}
+
+// filtruje wiersz i zwraca wartość heurystyki; pętle są osobne dla każdego filtra, żeby kompilator mógł je
+// wektoryzować
+static quint64 applyFilter(PngFilter filter, const uchar *row, const uchar *previous, int size, uchar *out) {
+    constexpr int bpp = 3;
+    out[0] = static_cast<uchar>(filter);
+    uchar *filtered = out + 1;
+    switch (filter) {
+    case FilterNone:
+        std::memcpy(filtered, row, static_cast<size_t>(size));
+        break;
+    case FilterSub:
+        std::memcpy(filtered, row, bpp);
+        for (int i = bpp; i < size; i++) {
+            filtered[i] = static_cast<uchar>(row[i] - row[i - bpp]);
+        }
+        break;
+    case FilterUp:
+        for (int i = 0; i < size; i++) {
+            filtered[i] = static_cast<uchar>(row[i] - previous[i]);
+        }
+        break;
+    case FilterAverage:
+        for (int i = 0; i < bpp; i++) {
+            filtered[i] = static_cast<uchar>(row[i] - previous[i] / 2);
+        }
+        for (int i = bpp; i < size; i++) {
+            filtered[i] = static_cast<uchar>(row[i] - (row[i - bpp] + previous[i]) / 2);
+        }
+        break;
+    case FilterPaeth:
+        for (int i = 0; i < bpp; i++) {
+            filtered[i] = static_cast<uchar>(row[i] - previous[i]);
+        }
+        for (int i = bpp; i < size; i++) {
+            filtered[i] = static_cast<uchar>(row[i] - paeth(row[i - bpp], previous[i], previous[i - bpp]));
+        }
+        break;
+    }
+    return signedSum(filtered, size);
+}
+
+PngStreamWriter::PngStreamWriter(QIODevice *device)
+        : m_device(device),
+          m_stream(new Stream) {
+}
+
+PngStreamWriter::~PngStreamWriter() {
+    if (m_stream->initialized) {
+        deflateEnd(&m_stream->zlib);
+    }
+}
+
+qint64 PngStreamWriter::bufferBytes() const {
+    return static_cast<qint64>(m_previous.size()) + m_current.size() + m_filtered.size() + m_candidate.size()
+           + m_output.size() + (m_stream->initialized ? deflateStateBytes : 0);
+}
+
+bool PngStreamWriter::writeChunk(const char type[4], const uchar *data, int size) {
+    uchar header[8];
+    qToBigEndian<quint32>(static_cast<quint32>(size), header);
+    std::memcpy(header + 4, type, 4);
+    uLong crc = crc32(0L, header + 4, 4);
+    if (size > 0) {
+        // crc32 z pustym wskaźnikiem zwraca wartość początkową zamiast sumy
+        crc = crc32(crc, data, static_cast<uInt>(size));
+    }
+    uchar trailer[4];
+    qToBigEndian<quint32>(static_cast<quint32>(crc), trailer);
+
+    if (m_device->write(reinterpret_cast<const char*>(header), 8) != 8
+        || (size > 0 && m_device->write(reinterpret_cast<const char*>(data), size) != size)
+        || m_device->write(reinterpret_cast<const char*>(trailer), 4) != 4) {
+        m_error = m_device->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PngStreamWriter::begin(int width, int height, int compressionLevel) {
+    if (width <= 0 || height <= 0 || width > (1 << 30) / 3) {
+        m_error = QStringLiteral("Niepoprawny rozmiar obrazu %1×%2").arg(width).arg(height);
+        return false;
+    }
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_previous.fill(0, width * 3);
+    m_current.resize(width * 3);
+    m_filtered.resize(width * 3 + 1);
+    m_candidate.resize(width * 3 + 1);
+    m_output.resize(outputBufferSize);
+
+    std::memset(&m_stream->zlib, 0, sizeof(z_stream));
+    if (deflateInit(&m_stream->zlib, qBound(0, compressionLevel, 9)) != Z_OK) {
+        m_error = QStringLiteral("Nie udało się zainicjować kompresji zlib");
+        return false;
+    }
+    m_stream->initialized = true;
+    m_stream->zlib.next_out = m_output.data();
+    m_stream->zlib.avail_out = outputBufferSize;
+
+    static const char signature[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+    if (m_device->write(signature, 8) != 8) {
+        m_error = m_device->errorString();
+        return false;
+    }
+    uchar header[13];
+    qToBigEndian<quint32>(static_cast<quint32>(width), header);
+    qToBigEndian<quint32>(static_cast<quint32>(height), header + 4);
+    header[8] = 8;  // bitów na składową
+    header[9] = 2;  // RGB
+    header[10] = 0; // deflate
+    header[11] = 0; // filtry adaptacyjne
+    header[12] = 0; // bez przeplotu
+    return writeChunk("IHDR", header, 13);
+}
+
+bool PngStreamWriter::deflateRow(const uchar *data, int size, int flush) {
+    z_stream &zlib = m_stream->zlib;
+    zlib.next_in = const_cast<uchar*>(data);
+    zlib.avail_in = static_cast<uInt>(size);
+    for (;;) {
+        const int status = deflate(&zlib, flush);
+        if (status == Z_STREAM_ERROR) {
+            m_error = QStringLiteral("Błąd kompresji zlib");
+            return false;
+        }
+        if (zlib.avail_out == 0 || (status == Z_STREAM_END && zlib.avail_out < outputBufferSize)) {
+            if (!writeChunk("IDAT", m_output.constData(), outputBufferSize - static_cast<int>(zlib.avail_out))) {
+                return false;
+            }
+            zlib.next_out = m_output.data();
+            zlib.avail_out = outputBufferSize;
+        }
+        if (status == Z_STREAM_END || (flush == Z_NO_FLUSH && zlib.avail_in == 0 && zlib.avail_out > 0)) {
+            return true;
+        }
+    }
+}
+
+bool PngStreamWriter::writeRow(const QRgb *pixels) {
+    if (!m_stream->initialized || m_rowsWritten >= m_height) {
+        m_error = QStringLiteral("Zapisano już wszystkie wiersze obrazu");
+        return false;
+    }
+    uchar *row = m_current.data();
+    for (int x = 0; x < m_width; x++) {
+        row[3 * x] = static_cast<uchar>(qRed(pixels[x]));
+        row[3 * x + 1] = static_cast<uchar>(qGreen(pixels[x]));
+        row[3 * x + 2] = static_cast<uchar>(qBlue(pixels[x]));
+    }
+
+    const int size = m_width * 3;
+    quint64 best = applyFilter(FilterNone, row, m_previous.constData(), size, m_filtered.data());
+    for (PngFilter filter : {FilterSub, FilterUp, FilterAverage, FilterPaeth}) {
+        const quint64 sum = applyFilter(filter, row, m_previous.constData(), size, m_candidate.data());
+        if (sum < best) {
+            best = sum;
+            m_filtered.swap(m_candidate);
+        }
+    }
+    m_previous.swap(m_current);
+    m_rowsWritten++;
+    return deflateRow(m_filtered.constData(), size + 1, Z_NO_FLUSH);
+}
+
+bool PngStreamWriter::finish() {
+    if (!m_stream->initialized || m_rowsWritten != m_height) {
+        m_error = QStringLiteral("Zapisano %1 z %2 wierszy obrazu").arg(m_rowsWritten).arg(m_height);
+        return false;
+    }
+    if (!deflateRow(nullptr, 0, Z_FINISH)) {
+        return false;
+    }
+    deflateEnd(&m_stream->zlib);
+    m_stream->initialized = false;
+    return writeChunk("IEND", nullptr, 0);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtGui/qrgb.h>
+
+#include <memory>
+
+class QIODevice;
+
+/**
+ * @brief PngStreamWriter - zapisuje obraz PNG (RGB, 8 bitów na składową) wiersz po wierszu. W pamięci trzymane są
+ * tylko dwa wiersze potrzebne do filtrowania i bufor wyjściowy kompresji, więc rozmiar obrazu nie jest ograniczony
+ * pamięcią, w przeciwieństwie do QImageWriter, który wymaga całego QImage.
+ */
+
+class PngStreamWriter
+{
+public:
+    /**
+     * @brief PngStreamWriter - tworzy koder zapisujący do otwartego urządzenia
+     * @param device - urządzenie do zapisu; musi istnieć do zakończenia zapisu
+     */
+
+    explicit PngStreamWriter(QIODevice *device);
+
+    ~PngStreamWriter();
+
+    PngStreamWriter(const PngStreamWriter&) = delete;
+    PngStreamWriter& operator=(const PngStreamWriter&) = delete;
+
+    /**
+     * @brief begin - zapisuje sygnaturę i nagłówek obrazu
+     * @param width, height - rozmiar obrazu w pikselach
+     * @param compressionLevel - poziom kompresji zlib od 0 do 9
+     * @return false w przypadku błędu zapisu
+     */
+
+    bool begin(int width, int height, int compressionLevel = 6);
+
+    /**
+     * @brief writeRow - filtruje, kompresuje i zapisuje kolejny wiersz obrazu
+     * @param pixels - width pikseli w formacie QRgb; kanał alfa jest pomijany
+     * @return false w przypadku błędu zapisu lub gdy zapisano już wszystkie wiersze
+     */
+
+    bool writeRow(const QRgb *pixels);
+
+    /**
+     * @brief finish - kończy strumień skompresowanych danych i zapisuje znacznik końca obrazu; wymaga zapisania
+     * wszystkich wierszy
+     */
+
+    bool finish();
+
+    /**
+     * @brief errorString - opis ostatniego błędu
+     */
+
+    QString errorString() const { return m_error; }
+
+    /**
+     * @brief bufferBytes - pamięć zajmowana przez bufory kodera, razem ze stanem kompresji zlib
+     */
+
+    qint64 bufferBytes() const;
+
+private:
+
+    /**
+     * @brief writeChunk - zapisuje fragment PNG z sumą kontrolną CRC
+     */
+
+    bool writeChunk(const char type[4], const uchar *data, int size);
+
+    /**
+     * @brief deflateRow - przekazuje dane do kompresji i zapisuje zapełnione bufory wyjściowe jako fragmenty IDAT
+     * @param flush - Z_NO_FLUSH lub Z_FINISH
+     */
+
+    bool deflateRow(const uchar *data, int size, int flush);
+
+    struct Stream;
+
+    QIODevice *m_device;
+    std::unique_ptr<Stream> m_stream;
+    QString m_error;
+    int m_width = 0;
+    int m_height = 0;
+    int m_rowsWritten = 0;
+
+    /**
+     * @brief m_previous, m_current - poprzedni i bieżący wiersz bez filtra (RGB)
+     */
+
+    QVector<uchar> m_previous;
+    QVector<uchar> m_current;
+
+    /**
+     * @brief m_filtered - bieżący wiersz po filtrze; pierwszy bajt to typ filtra
+     */
+
+    QVector<uchar> m_filtered;
+    QVector<uchar> m_candidate;
+    QVector<uchar> m_output;
+};
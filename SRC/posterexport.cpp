@@ -0,0 +1,340 @@
+#include "posterexport.h"
+#include "imageregistration.h"
+#include "pngstreamwriter.h"
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtMath>
+#include <QtDataVisualization/q3dcamera.h>
+#include <QtDataVisualization/q3dscene.h>
+
+#include <cmath>
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+// dłuższy bok obrazów próbnych, z których wyznaczane jest przesunięcie obrazu względem celu kamery
+constexpr int calibrationSize = 1024;
+// przesunięcie celu kamery rośnie dwukrotnie od pierwszego do ostatniego obrazu próbnego; mały pierwszy krok
+// nie pozwala pomylić sąsiednich linii siatki, a duży ostatni zmniejsza względny błąd pomiaru
+constexpr float firstCalibrationDelta = 1.0f / 64.0f;
+constexpr float lastCalibrationDelta = 0.5f;
+constexpr int firstCalibrationRange = 16;
+constexpr int nextCalibrationRange = 4;
+// zakładka z sąsiednimi kafelkami i zakres dopasowania, w pikselach plakatu
+constexpr int tileMargin = 32;
+constexpr int alignRadius = 12;
+// największy renderowany obraz; kafelek z marginesem i ewentualnym przesunięciem musi się w nim zmieścić
+constexpr int maxRenderSize = 8192;
+
+static qint64 processPeakBytes() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(Q_OS_DARWIN)
+    return usage.ru_maxrss;
+#else
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static int divideRoundingUp(int value, int divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+static double dot(const double first[3], const double second[3]) {
+    return first[0] * second[0] + first[1] * second[1] + first[2] * second[2];
+}
+
+// najmniejszy rozmiar obrazu nie mniejszy od 2 * halfExtent, dla którego środek obrazu wypada w tym samym miejscu
+// piksela co center; dzięki temu piksele kafelka pokrywają się z pikselami płótna bez przesunięcia o pół piksela
+static int renderExtent(double halfExtent, double center) {
+    int extent = qCeil(2.0 * halfExtent);
+    const double fraction = center - std::floor(center);
+    const bool odd = fraction >= 0.25 && fraction < 0.75;
+    if ((extent % 2 == 1) != odd) {
+        extent++;
+    }
+    return extent;
+}
+
+static qint64 imageBytes(const QImage &image) {
+    return static_cast<qint64>(image.bytesPerLine()) * image.height();
+}
+
+/**
+ * @brief CameraState - ustawienia kamery i rzutowania zmieniane w czasie zapisu, przywracane w destruktorze
+ */
+
+class CameraState
+{
+public:
+    explicit CameraState(Q3DScatter *graph)
+            : m_graph(graph),
+              m_camera(graph->scene()->activeCamera()),
+              m_orthoProjection(graph->isOrthoProjection()),
+              m_target(m_camera->target()),
+              m_zoomLevel(m_camera->zoomLevel()),
+              m_maxZoomLevel(m_camera->maxZoomLevel()) {
+    }
+
+    ~CameraState() {
+        m_camera->setMaxZoomLevel(m_maxZoomLevel);
+        m_camera->setZoomLevel(m_zoomLevel);
+        m_camera->setTarget(m_target);
+        m_graph->setOrthoProjection(m_orthoProjection);
+    }
+
+    QVector3D target() const { return m_target; }
+
+    float zoomLevel() const { return m_zoomLevel; }
+
+    float maxZoomLevel() const { return m_maxZoomLevel; }
+
+private:
+    Q3DScatter *m_graph;
+    Q3DCamera *m_camera;
+    bool m_orthoProjection;
+    QVector3D m_target;
+    float m_zoomLevel;
+    float m_maxZoomLevel;
+};
+
+PosterExporter::PosterExporter(Q3DScatter *graph)
+        : m_graph(graph) {
+}
+
+QImage PosterExporter::renderView(const QVector3D &target, float zoomLevel, const QSize &size, int samples) {
+    Q3DCamera *camera = m_graph->scene()->activeCamera();
+    camera->setTarget(target);
+    camera->setZoomLevel(zoomLevel);
+    QImage image = m_graph->renderToImage(samples, size);
+    if (!image.isNull() && image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32
+        && image.format() != QImage::Format_ARGB32_Premultiplied) {
+        image = image.convertToFormat(QImage::Format_RGB32);
+    }
+    return image;
+}
+
+PosterResult PosterExporter::exportPng(const QString &fileName, const PosterOptions &options,
+                                       const Progress &progress) {
+    PosterResult result;
+    result.processPeakBeforeBytes = processPeakBytes();
+    const int width = options.size.width();
+    const int height = options.size.height();
+    if (width <= 0 || height <= 0 || options.maxTileSize <= 2 * tileMargin) {
+        result.error = QStringLiteral("Niepoprawny rozmiar plakatu lub kafelka");
+        return result;
+    }
+
+    // siatka kafelków ma tyle samo wierszy i kolumn, więc kafelki mają proporcje całego widoku, a płótno jest
+    // co najwyżej o kilka pikseli większe od plakatu i przycinane z prawej i z dołu
+    const int tiles = qMax(divideRoundingUp(width, options.maxTileSize),
+                           divideRoundingUp(height, options.maxTileSize));
+    const int tileWidth = divideRoundingUp(width, tiles);
+    const int tileHeight = divideRoundingUp(height, tiles);
+    const int canvasWidth = tiles * tileWidth;
+    const int canvasHeight = tiles * tileHeight;
+    const QPointF canvasCenter(canvasWidth / 2.0, canvasHeight / 2.0);
+    result.tiles = tiles;
+
+    result.projectionChanged = !m_graph->isOrthoProjection();
+    if (result.projectionChanged && !options.allowOrthoSwitch) {
+        result.error = QStringLiteral("Plakat można złożyć z kafelków tylko w rzucie prostokątnym, "
+                                      "a widok jest w rzucie perspektywicznym");
+        return result;
+    }
+    const CameraState state(m_graph);
+    m_graph->setOrthoProjection(true);
+    const QVector3D baseTarget = state.target();
+    QElapsedTimer timer;
+
+    // w rzucie prostokątnym skala obrazu zależy tylko od powiększenia i wysokości obrazu, a przesunięcie obrazu
+    // jest liniowe względem celu kamery: środek obrazu pokazuje punkt płótna
+    // canvasCenter + jacobian * (cel - baseTarget)
+    timer.start();
+    const double previewScale = static_cast<double>(calibrationSize) / qMax(canvasWidth, canvasHeight);
+    const QSize previewSize(qMax(1, qRound(canvasWidth * previewScale)),
+                            qMax(1, qRound(canvasHeight * previewScale)));
+    const double canvasPerPreview = static_cast<double>(canvasHeight) / previewSize.height();
+    const QImage preview = renderView(baseTarget, state.zoomLevel(), previewSize, options.samples);
+    if (preview.isNull()) {
+        result.error = QStringLiteral("Nie udało się wyrenderować wykresu");
+        return result;
+    }
+    const LumaImage reference = LumaImage::fromImage(preview, preview.rect());
+    double jacobian[2][3] = {};
+    for (int axis = 0; axis < 3; axis++) {
+        // cel kamery ograniczony jest do [-1, 1], więc próbki odsuwane są od bliższego brzegu
+        const float direction = baseTarget[axis] > 0.0f ? -1.0f : 1.0f;
+        QPoint predicted;
+        int range = firstCalibrationRange;
+        for (float delta = firstCalibrationDelta; delta <= lastCalibrationDelta; delta *= 2.0f) {
+            QVector3D probeTarget = baseTarget;
+            probeTarget[axis] += direction * delta;
+            const QImage probe = renderView(probeTarget, state.zoomLevel(), previewSize, options.samples);
+            bool found = false;
+            const QPointF shift = findTranslation(reference, LumaImage::fromImage(probe, probe.rect()), predicted,
+                                                  range, &found);
+            if (!found) {
+                break;
+            }
+            jacobian[0][axis] = shift.x() * canvasPerPreview / (direction * delta);
+            jacobian[1][axis] = shift.y() * canvasPerPreview / (direction * delta);
+            predicted = QPoint(qRound(2.0 * shift.x()), qRound(2.0 * shift.y()));
+            range = nextCalibrationRange;
+        }
+    }
+    // rozwiązanie o najmniejszej normie: cel = baseTarget + J^T (J J^T)^-1 * przesunięcie
+    const double a = dot(jacobian[0], jacobian[0]);
+    const double b = dot(jacobian[0], jacobian[1]);
+    const double c = dot(jacobian[1], jacobian[1]);
+    const double determinant = a * c - b * b;
+    result.calibrationTimeNs = timer.nsecsElapsed();
+    if (!(determinant > 1.0e-6 * a * c)) {
+        result.error = QStringLiteral("Nie udało się wyznaczyć przesunięcia obrazu względem kamery");
+        return result;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.error = file.errorString();
+        return result;
+    }
+    PngStreamWriter writer(&file);
+    if (!writer.begin(width, height, options.compressionLevel)) {
+        result.error = writer.errorString();
+        return result;
+    }
+
+    QImage strip(canvasWidth, tileHeight, QImage::Format_RGB32);
+    QImage previousRows;
+    QVector<QPoint> columnCorrection(tiles);
+    QPoint leftCorrection;
+    for (int row = 0; row < tiles; row++) {
+        for (int column = 0; column < tiles; column++) {
+            const QRect tile(column * tileWidth, row * tileHeight, tileWidth, tileHeight);
+            const double dx = column * tileWidth + tileWidth / 2.0 - canvasCenter.x();
+            const double dy = row * tileHeight + tileHeight / 2.0 - canvasCenter.y();
+            const double u = (c * dx - b * dy) / determinant;
+            const double v = (a * dy - b * dx) / determinant;
+            QVector3D target;
+            for (int axis = 0; axis < 3; axis++) {
+                target[axis] = qBound(-1.0f, baseTarget[axis]
+                                             + static_cast<float>(jacobian[0][axis] * u + jacobian[1][axis] * v), 1.0f);
+            }
+            // po ograniczeniu celu środek obrazu może nie wypaść na środku kafelka; obraz jest wtedy większy
+            const QVector3D offset = target - baseTarget;
+            const double shift[3] = {offset.x(), offset.y(), offset.z()};
+            const QPointF center(canvasCenter.x() + dot(jacobian[0], shift),
+                                 canvasCenter.y() + dot(jacobian[1], shift));
+            double halfWidth = qMax(center.x() - tile.x(), tile.x() + tileWidth - center.x()) + tileMargin;
+            double halfHeight = qMax(center.y() - tile.y(), tile.y() + tileHeight - center.y()) + tileMargin;
+            halfHeight = qMax(halfHeight, halfWidth * canvasHeight / canvasWidth);
+            halfWidth = halfHeight * canvasWidth / canvasHeight;
+            const QSize renderSize(renderExtent(halfWidth, center.x()), renderExtent(halfHeight, center.y()));
+            if (renderSize.width() > maxRenderSize || renderSize.height() > maxRenderSize) {
+                result.error = QStringLiteral("Kafelek %1, %2 wymaga obrazu %3×%4 pikseli - cel kamery jest "
+                                              "za daleko od środka wykresu")
+                                       .arg(column).arg(row).arg(renderSize.width()).arg(renderSize.height());
+                return result;
+            }
+
+            timer.restart();
+            const float zoomLevel = state.zoomLevel() * canvasHeight / renderSize.height();
+            m_graph->scene()->activeCamera()->setMaxZoomLevel(qMax(state.maxZoomLevel(), zoomLevel));
+            const QImage image = renderView(target, zoomLevel, renderSize, options.samples);
+            result.renderTimeNs += timer.nsecsElapsed();
+            if (image.isNull()) {
+                result.error = QStringLiteral("Nie udało się wyrenderować kafelka %1, %2").arg(column).arg(row);
+                return result;
+            }
+
+            // piksel płótna p odpowiada pikselowi p + placement + correction obrazu
+            timer.restart();
+            const QPoint placement(qRound(renderSize.width() / 2.0 - center.x()),
+                                   qRound(renderSize.height() / 2.0 - center.y()));
+            QVector<LumaRegion> overlaps;
+            if (column > 0) {
+                LumaRegion left;
+                left.image = LumaImage::fromImage(strip, QRect(tile.x() - tileMargin, 0, tileMargin, tileHeight));
+                left.origin = QPoint(tile.x() - tileMargin, tile.y()) + placement;
+                overlaps.append(left);
+            }
+            if (row > 0) {
+                LumaRegion top;
+                top.image = LumaImage::fromImage(previousRows, QRect(tile.x(), 0, tileWidth, tileMargin));
+                top.origin = QPoint(tile.x(), tile.y() - tileMargin) + placement;
+                overlaps.append(top);
+            }
+            // błąd kalibracji rośnie liniowo z odległością od środka, więc sąsiad jest najlepszym przewidywaniem
+            const QPoint predicted = column > 0 ? leftCorrection : columnCorrection[column];
+            const LumaImage moving = LumaImage::fromImage(image, image.rect());
+            const QPoint correction = overlaps.isEmpty() ? predicted
+                                                         : alignRegions(overlaps, moving, predicted, alignRadius);
+            result.alignTimeNs += timer.nsecsElapsed();
+            // margines obrazu musi pomieścić poprawkę razem z zaokrągleniem rozmiaru i położenia
+            if (qAbs(correction.x()) > tileMargin - 2 || qAbs(correction.y()) > tileMargin - 2) {
+                result.error = QStringLiteral("Nie udało się dopasować kafelka %1, %2").arg(column).arg(row);
+                return result;
+            }
+            result.maxCorrection = qMax(result.maxCorrection, qMax(qAbs(correction.x()), qAbs(correction.y())));
+            leftCorrection = correction;
+            columnCorrection[column] = correction;
+
+            const QPoint source = tile.topLeft() + placement + correction;
+            for (int y = 0; y < tileHeight; y++) {
+                std::memcpy(strip.scanLine(y) + tile.x() * 4, image.constScanLine(source.y() + y) + source.x() * 4,
+                            static_cast<size_t>(tileWidth) * 4);
+            }
+            result.bufferPeakBytes = qMax(result.bufferPeakBytes,
+                                          imageBytes(strip) + imageBytes(previousRows) + imageBytes(image)
+                                          + moving.pixels.size() + writer.bufferBytes());
+            if (progress) {
+                progress(row * tiles + column + 1, tiles * tiles);
+            }
+        }
+
+        timer.restart();
+        const int rows = qMin(tileHeight, height - row * tileHeight);
+        for (int y = 0; y < rows; y++) {
+            if (!writer.writeRow(reinterpret_cast<const QRgb*>(strip.constScanLine(y)))) {
+                result.error = writer.errorString();
+                return result;
+            }
+        }
+        result.encodeTimeNs += timer.nsecsElapsed();
+        previousRows = strip.copy(0, tileHeight - tileMargin, canvasWidth, tileMargin);
+    }
+
+    timer.restart();
+    if (!writer.finish()) {
+        result.error = writer.errorString();
+        return result;
+    }
+    result.bytes = file.pos();
+    if (!file.commit()) {
+        result.error = file.errorString();
+        return result;
+    }
+    result.encodeTimeNs += timer.nsecsElapsed();
+    result.processPeakBytes = processPeakBytes();
+    result.ok = true;
+    return result;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QtDataVisualization/q3dscatter.h>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+#include <QtGui/QVector3D>
+
+#include <functional>
+
+using namespace QtDataVisualization;
+
+/**
+ * @brief PosterOptions - parametry zapisu plakatu
+ */
+
+struct PosterOptions
+{
+    QSize size;                ///< rozmiar plakatu w pikselach
+    int maxTileSize = 2048;    ///< największy bok kafelka, bez marginesu
+    int samples = 4;           ///< liczba próbek wygładzania krawędzi kafelków
+    int compressionLevel = 6;  ///< poziom kompresji PNG od 0 do 9
+    bool allowOrthoSwitch = false; ///< czy widok w rzucie perspektywicznym zapisać w rzucie prostokątnym;
+                                   ///< false - taki widok jest odrzucany, bo plakat różniłby się od widoku
+};
+
+/**
+ * @brief PosterResult - wynik i czasy zapisu plakatu
+ */
+
+struct PosterResult
+{
+    bool ok = false;
+    QString error;                     ///< opis błędu, pusty gdy zapis się powiódł
+    int tiles = 0;                     ///< liczba kafelków w wierszu i w kolumnie
+    qint64 calibrationTimeNs = 0;      ///< renderowanie obrazów próbnych i wyznaczanie przesunięć kamery
+    qint64 renderTimeNs = 0;           ///< renderowanie kafelków
+    qint64 alignTimeNs = 0;            ///< dopasowanie kafelków do sąsiadów
+    qint64 encodeTimeNs = 0;           ///< kodowanie i zapis PNG
+    qint64 bufferPeakBytes = 0;        ///< największa łączna pamięć buforów eksportu (pas kafelków, kafelek, koder)
+    qint64 processPeakBeforeBytes = 0; ///< szczytowa pamięć procesu przed eksportem, 0 gdy system jej nie podaje
+    qint64 processPeakBytes = 0;       ///< szczytowa pamięć procesu po eksporcie, 0 gdy system jej nie podaje
+    int maxCorrection = 0;             ///< największa poprawka położenia kafelka względem kalibracji, w pikselach
+    bool projectionChanged = false;    ///< true jeśli widok był perspektywiczny, a plakat ma rzut prostokątny
+    qint64 bytes = 0;                  ///< rozmiar pliku
+};
+
+/**
+ * @brief PosterExporter - zapisuje wykres jako plik PNG większy niż bufor ramki karty graficznej. Obraz składany
+ * jest z kafelków, z których każdy renderowany jest osobno przez renderToImage z powiększeniem kamery i punktem,
+ * na który kamera patrzy, przesuniętym na środek kafelka. QtDataVisualization nie pozwala ustawić macierzy
+ * rzutowania, więc kafelki renderowane są w rzucie prostokątnym, w którym powiększenie i przesunięcie celu kamery
+ * są dokładnie wycinkiem całego widoku. Zależność położenia obrazu od celu kamery wyznaczana jest z obrazów
+ * próbnych, a każdy kafelek dopasowywany jest jeszcze do zakładki z sąsiadami. Gotowe wiersze pasa kafelków
+ * trafiają od razu do PngStreamWriter, więc w pamięci jest tylko jeden pas, a nie cały plakat.
+ */
+
+class PosterExporter
+{
+public:
+    /**
+     * @brief Progress - funkcja wywoływana po wyrenderowaniu każdego kafelka
+     */
+
+    using Progress = std::function<void(int finished, int total)>;
+
+    explicit PosterExporter(Q3DScatter *graph);
+
+    /**
+     * @brief exportPng - renderuje i zapisuje plakat; ustawienia kamery i rodzaj rzutowania są przywracane.
+     * Widok w rzucie perspektywicznym jest odrzucany, chyba że ustawiono PosterOptions::allowOrthoSwitch.
+     * @param fileName - ścieżka pliku PNG
+     * @param options - rozmiar plakatu i kafelków
+     * @param progress - postęp renderowania kafelków, może być pusta
+     */
+
+    PosterResult exportPng(const QString& fileName, const PosterOptions& options, const Progress& progress);
+
+private:
+
+    /**
+     * @brief renderView - renderuje wykres z podanym celem i powiększeniem kamery
+     */
+
+    QImage renderView(const QVector3D& target, float zoomLevel, const QSize& size, int samples);
+
+    Q3DScatter *m_graph;
+};
@@ -0,0 +1,203 @@
+#include "sampledfield.h"
+#include <QtCore/QFile>
+#include <QtCore/QSysInfo>
+#include <QtCore/QtEndian>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static const char magic[8] = {'V', 'F', 'V', 'F', 'I', 'E', 'L', 'D'};
+
+constexpr quint32 formatVersion = 1;
+constexpr qint64 headerSize = 104;
+
+// punkt dalej od skrajnej próbki o mniej niż tyle odstępów nadal należy do obszaru danych - węzły wykresu
+// rozpięte na granicach obszaru wyliczane są w pojedynczej precyzji i mogą minimalnie wyjść poza nie
+constexpr double edgeTolerance = 1.0e-3;
+
+static quint32 readUInt32(const uchar *header, int offset) {
+    return qFromLittleEndian<quint32>(header + offset);
+}
+
+static quint64 readUInt64(const uchar *header, int offset) {
+    return qFromLittleEndian<quint64>(header + offset);
+}
+
+static double readDouble(const uchar *header, int offset) {
+    const quint64 bits = readUInt64(header, offset);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// położenie punktu względem próbek jednej osi: indeks niższej z dwóch sąsiednich próbek i waga wyższej
+static bool locate(float position, double origin, double inverseSpacing, int count, qint64 &index, float &weight) {
+    if (count == 1) {
+        index = 0;
+        weight = 0.0f;
+        return true;
+    }
+    double cell = (position - origin) * inverseSpacing;
+    if (!(cell >= -edgeTolerance && cell <= count - 1 + edgeTolerance)) {
+        return false;
+    }
+    cell = qBound(0.0, cell, static_cast<double>(count - 1));
+    index = qMin(static_cast<qint64>(cell), static_cast<qint64>(count - 2));
+    weight = static_cast<float>(cell - index);
+    return true;
+}
+
+SampledField::~SampledField() = default;
+
+std::shared_ptr<const SampledField> SampledField::open(const QString &fileName, QString *error) {
+    if (QSysInfo::ByteOrder == QSysInfo::BigEndian) {
+        *error = QStringLiteral("Pliki pól są odwzorowywane bez konwersji i wymagają procesora little endian");
+        return nullptr;
+    }
+    std::shared_ptr<SampledField> field(new SampledField());
+    field->m_file.reset(new QFile(fileName));
+    if (!field->m_file->open(QIODevice::ReadOnly)) {
+        *error = QStringLiteral("Nie można otworzyć pliku %1: %2").arg(fileName, field->m_file->errorString());
+        return nullptr;
+    }
+    field->m_size = field->m_file->size();
+    if (field->m_size < headerSize) {
+        *error = QStringLiteral("Plik %1 jest krótszy niż nagłówek pola").arg(fileName);
+        return nullptr;
+    }
+    field->m_data = field->m_file->map(0, field->m_size);
+    if (!field->m_data) {
+        *error = QStringLiteral("Nie można odwzorować pliku %1 w pamięci: %2")
+                 .arg(fileName, field->m_file->errorString());
+        return nullptr;
+    }
+
+    const uchar *header = field->m_data;
+    if (std::memcmp(header, magic, sizeof(magic)) != 0) {
+        *error = QStringLiteral("Plik %1 nie jest plikiem pola wektorowego (.vfv)").arg(fileName);
+        return nullptr;
+    }
+    const quint32 version = readUInt32(header, 8);
+    if (version != formatVersion) {
+        *error = QStringLiteral("Nieobsługiwana wersja formatu pola %1").arg(version);
+        return nullptr;
+    }
+    const quint32 type = readUInt32(header, 12);
+    if (type != static_cast<quint32>(ComponentType::Float32) && type != static_cast<quint32>(ComponentType::Float64)) {
+        *error = QStringLiteral("Nieobsługiwany typ składowych %1").arg(type);
+        return nullptr;
+    }
+    field->m_type = static_cast<ComponentType>(type);
+    const quint64 componentSize = field->m_type == ComponentType::Float32 ? sizeof(float) : sizeof(double);
+
+    // liczba próbek liczona krokami, żeby iloczyn wymiarów nie przepełnił się przed porównaniem
+    // z rozmiarem pliku
+    const quint64 available = static_cast<quint64>(field->m_size) / componentSize;
+    quint64 samples = 1;
+    for (int axis = 0; axis < 3; axis++) {
+        const quint32 count = readUInt32(header, 16 + 4 * axis);
+        const double origin = readDouble(header, 32 + 8 * axis);
+        const double spacing = readDouble(header, 56 + 8 * axis);
+        if (count == 0 || count > static_cast<quint32>(std::numeric_limits<int>::max())
+                || count > available / samples) {
+            *error = QStringLiteral("Niepoprawne wymiary siatki %1×%2×%3").arg(readUInt32(header, 16))
+                     .arg(readUInt32(header, 20)).arg(readUInt32(header, 24));
+            return nullptr;
+        }
+        if (!std::isfinite(origin) || !std::isfinite(spacing) || spacing <= 0.0) {
+            *error = QStringLiteral("Niepoprawne położenie lub odstęp próbek wzdłuż osi %1")
+                     .arg(QChar('x' + axis));
+            return nullptr;
+        }
+        samples *= count;
+        field->m_count[axis] = static_cast<int>(count);
+        field->m_origin[axis] = origin;
+        field->m_spacing[axis] = spacing;
+    }
+
+    const quint64 bytes = samples * componentSize;
+    const quint64 size = static_cast<quint64>(field->m_size);
+    for (int component = 0; component < 3; component++) {
+        const quint64 offset = readUInt64(header, 80 + 8 * component);
+        if (offset < static_cast<quint64>(headerSize) || offset % componentSize != 0
+                || offset > size || bytes > size - offset) {
+            *error = QStringLiteral("Tablica składowej %1 wychodzi poza plik lub nie jest wyrównana")
+                     .arg(QChar('x' + component));
+            return nullptr;
+        }
+        field->m_components[component] = field->m_data + offset;
+    }
+    return field;
+}
+
+QString SampledField::fileName() const {
+    return m_file->fileName();
+}
+
+QVector3D SampledField::lower() const {
+    return QVector3D(static_cast<float>(m_origin[0]), static_cast<float>(m_origin[1]),
+                     static_cast<float>(m_origin[2]));
+}
+
+QVector3D SampledField::upper() const {
+    return QVector3D(static_cast<float>(m_origin[0] + (m_count[0] - 1) * m_spacing[0]),
+                     static_cast<float>(m_origin[1] + (m_count[1] - 1) * m_spacing[1]),
+                     static_cast<float>(m_origin[2] + (m_count[2] - 1) * m_spacing[2]));
+}
+
+void SampledField::evaluate(const float *x, const float *y, const float *z,
+                            float *vx, float *vy, float *vz, int count,
+                            float a, float b, float c) const {
+    if (m_type == ComponentType::Float32) {
+        interpolate<float>(x, y, z, vx, vy, vz, count, a, b, c);
+    } else {
+        interpolate<double>(x, y, z, vx, vy, vz, count, a, b, c);
+    }
+}
+
+template <typename T>
+void SampledField::interpolate(const float *x, const float *y, const float *z,
+                               float *vx, float *vy, float *vz, int count,
+                               float a, float b, float c) const {
+    const T *data[3] = {reinterpret_cast<const T*>(m_components[0]), reinterpret_cast<const T*>(m_components[1]),
+                        reinterpret_cast<const T*>(m_components[2])};
+    const double inverse[3] = {1.0 / m_spacing[0], 1.0 / m_spacing[1], 1.0 / m_spacing[2]};
+    // odległości do sąsiednich próbek w tablicy; na osi z jedną próbką sąsiadem jest ta sama próbka
+    const qint64 nx = m_count[0];
+    const qint64 nxy = nx * m_count[1];
+    const qint64 strides[3] = {m_count[0] > 1 ? 1 : 0, m_count[1] > 1 ? nx : 0, m_count[2] > 1 ? nxy : 0};
+    const float scales[3] = {a, b, c};
+    float *out[3] = {vx, vy, vz};
+
+    for (int p = 0; p < count; p++) {
+        qint64 i, j, k;
+        float wx, wy, wz;
+        if (!locate(x[p], m_origin[0], inverse[0], m_count[0], i, wx)
+                || !locate(y[p], m_origin[1], inverse[1], m_count[1], j, wy)
+                || !locate(z[p], m_origin[2], inverse[2], m_count[2], k, wz)) {
+            vx[p] = 0.0f;
+            vy[p] = 0.0f;
+            vz[p] = 0.0f;
+            continue;
+        }
+        const qint64 base = k * nxy + j * nx + i;
+        const qint64 corners[8] = {base, base + strides[0], base + strides[1], base + strides[0] + strides[1],
+                                   base + strides[2], base + strides[2] + strides[0], base + strides[2] + strides[1],
+                                   base + strides[2] + strides[0] + strides[1]};
+        const float weights[8] = {(1 - wx) * (1 - wy) * (1 - wz), wx * (1 - wy) * (1 - wz),
+                                  (1 - wx) * wy * (1 - wz), wx * wy * (1 - wz),
+                                  (1 - wx) * (1 - wy) * wz, wx * (1 - wy) * wz,
+                                  (1 - wx) * wy * wz, wx * wy * wz};
+        for (int component = 0; component < 3; component++) {
+            const T *values = data[component];
+            float sum = 0.0f;
+            for (int corner = 0; corner < 8; corner++) {
+                sum += weights[corner] * static_cast<float>(values[corners[corner]]);
+            }
+            // stała mnoży składową jako ostatnia, tak jak w polach wbudowanych, więc przeskalowanie bazy
+            // daje ten sam wynik co próbkowanie od nowa
+            out[component][p] = scales[component] * sum;
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <QtGui/QVector3D>
+
+#include <memory>
+
+class QFile;
+
+/**
+ * @brief SampledField - pole wektorowe spróbkowane na regularnej siatce, wczytane z pliku .vfv.
+ *
+ * Plik odwzorowywany jest w pamięć (QFile::map) i czytany bez kopiowania, więc otwarcie pliku o rozmiarze wielu GB
+ * sprawdza tylko nagłówek; strony z danymi wczytuje system dopiero wtedy, gdy wykres próbkuje dany obszar.
+ * Wykres próbkuje dane tą samą drogą co pola analityczne - wartości w węzłach siatki wykresu wyznaczane są
+ * interpolacją trójliniową, a poza obszarem danych pole jest zerowe.
+ *
+ * Format pliku (little endian, nagłówek 104 bajty):
+ *
+ *     przesunięcie  typ          pole
+ *     0             char[8]      "VFVFIELD"
+ *     8             uint32       wersja formatu, 1
+ *     12            uint32       typ składowych: 1 - float32, 2 - float64
+ *     16            uint32[3]    nx, ny, nz - liczba próbek wzdłuż osi x, y, z
+ *     28            uint32       zarezerwowane, 0
+ *     32            float64[3]   origin - położenie próbki (0, 0, 0)
+ *     56            float64[3]   spacing - odległość między próbkami wzdłuż osi, większa od 0
+ *     80            uint64[3]    przesunięcia tablic vx, vy, vz od początku pliku, wielokrotności rozmiaru składowej
+ *
+ * Każda z tablic vx, vy, vz zawiera nx*ny*nz wartości; próbka (i, j, k) leży w punkcie
+ * origin + (i, j, k) * spacing pod indeksem (k*ny + j)*nx + i (x zmienia się najszybciej). Tablice mogą
+ * leżeć w dowolnej kolejności i miejscu pliku. Oś z jedną próbką oznacza pole stałe wzdłuż tej osi.
+ */
+
+class SampledField
+{
+public:
+    /**
+     * @brief ComponentType - typ zapisanych składowych
+     */
+
+    enum class ComponentType
+    {
+        Float32 = 1,
+        Float64 = 2
+    };
+
+    ~SampledField();
+
+    /**
+     * @brief open - odwzorowuje plik w pamięć i sprawdza jego nagłówek
+     * @param fileName - ścieżka pliku .vfv
+     * @param error - opis błędu, jeśli pliku nie udało się otworzyć lub ma niepoprawny format
+     * @return pole lub nullptr w przypadku błędu
+     */
+
+    static std::shared_ptr<const SampledField> open(const QString &fileName, QString *error);
+
+    /**
+     * @brief evaluate - wyznacza wektory pola dla count punktów, ma tę samą postać co BatchKernel.
+     * Składowe x, y, z mnożone są na końcu przez a, b, c. Może być wywoływana jednocześnie z wielu wątków.
+     */
+
+    void evaluate(const float *x, const float *y, const float *z,
+                  float *vx, float *vy, float *vz, int count,
+                  float a, float b, float c) const;
+
+    /**
+     * @brief lower, upper - narożniki obszaru zajmowanego przez próbki
+     */
+
+    QVector3D lower() const;
+    QVector3D upper() const;
+
+    /**
+     * @brief countX, countY, countZ - liczba próbek wzdłuż osi
+     */
+
+    int countX() const { return m_count[0]; }
+    int countY() const { return m_count[1]; }
+    int countZ() const { return m_count[2]; }
+
+    ComponentType componentType() const { return m_type; }
+
+    /**
+     * @brief fileName - ścieżka odwzorowanego pliku
+     */
+
+    QString fileName() const;
+
+    /**
+     * @brief fileSize - rozmiar pliku w bajtach
+     */
+
+    qint64 fileSize() const { return m_size; }
+
+private:
+    SampledField() = default;
+
+    template <typename T>
+    void interpolate(const float *x, const float *y, const float *z,
+                     float *vx, float *vy, float *vz, int count,
+                     float a, float b, float c) const;
+
+    std::unique_ptr<QFile> m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    ComponentType m_type = ComponentType::Float32;
+    int m_count[3] = {0, 0, 0};
+    double m_origin[3] = {0.0, 0.0, 0.0};
+    double m_spacing[3] = {1.0, 1.0, 1.0};
+    const uchar *m_components[3] = {nullptr, nullptr, nullptr};
+};
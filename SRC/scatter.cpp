@@ -1,5 +1,17 @@
 ﻿#include "scatter.h"
+#include "glyphmesh.h"
+#include "meshregistry.h"
+#include "nativefield.h"
+#include "posterexport.h"
+#include "sampledfield.h"
+#include "workstealingpool.h"
 #include <QtCore/qmath.h>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QLoggingCategory>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QtDataVisualization/QCustom3DItem>
 #include <QtDataVisualization/q3dcamera.h>
 #include <QtDataVisualization/q3dscene.h>
@@ -8,7 +20,6 @@
 #include <QtDataVisualization/qscatterdataproxy.h>
 #include <QtDataVisualization/qvalue3daxis.h>
 #include <Qt3DCore/QTransform>
-#include <QPixmap>
 #include <QFileDialog>
 #include <QMessageBox>
 
@@ -16,34 +27,100 @@
 
 using namespace QtDataVisualization;
 
+Q_LOGGING_CATEGORY(lcPipeline, "vfv.pipeline")
+
 constexpr float verticalRange = 10.0f;
 constexpr float horizontalRange = verticalRange;
-constexpr float doublePi = static_cast<float>(M_PI) * 2.0f;
-constexpr float radiansToDegrees = 360.0f / doublePi;
+constexpr float seriesItemSizeFactor = 0.5f;
+constexpr int defaultRegenerationDelay = 16;
+constexpr int maxRegenerationLatency = 100;
+constexpr int customFieldIndex = 4;
+constexpr int fileFieldIndex = 5;
+constexpr int cameraSettleDelay = 250;
+constexpr int nativeCompileDelay = 500;
+constexpr int chunkDrainInterval = 16;
+constexpr int exportSamples = 8;
+constexpr int exportPngQuality = 100;
+constexpr int exportJpegQuality = 95;
+constexpr int posterResolution = 3;
+constexpr int posterLongSide = 16384;
+// liczba trójkątów na klatkę, przy której ruch kamery osiąga 60 FPS, dopóki nie zmierzono rzeczywistego czasu klatki
+constexpr double interactionTriangleBudget = 300000.0;
 
-float minimum(float a, float b, float c) {
-    if (a < b) {
-        if (a < c) {
-            return a;
-        }
+static bool keepDuringInteraction(int index, unsigned char color, int stride) {
+    // skrót indeksu zamiast co n-tego węzła, żeby podzbiór nie układał się w pasy lub płaszczyzny siatki;
+    // dłuższe strzałki (kolor bliżej czerwonego) zostają z większym prawdopodobieństwem, średnio 1 na stride
+    const quint64 hash = static_cast<quint32>(index * 2654435761u);
+    const quint64 threshold = (Q_UINT64_C(1) << 32) * (128 + color) / (255 * static_cast<quint64>(stride));
+    return hash < threshold;
+}
+
+static qint64 gridNodes(const int segments[3]) {
+    return static_cast<qint64>(segments[0] + 1) * (segments[1] + 1) * (segments[2] + 1);
+}
+
+static QString explainGovernorDecision(const GovernorDecision &decision, const FrameBudgetGovernor &governor) {
+    const qint64 nodes = gridNodes(decision.segments);
+    const QString chosen = QStringLiteral("%1×%2×%3 (%4 węzłów)")
+                                   .arg(decision.segments[0]).arg(decision.segments[1]).arg(decision.segments[2])
+                                   .arg(nodes);
+    if (decision.limit == GovernorLimit::None) {
+        return QStringLiteral("Siatka %1 mieści się w budżetach: regeneracja ~%2 ms z %3 ms, klatka ~%4 ms z %5 ms")
+                .arg(chosen)
+                .arg(decision.predictedRegenerationNs / 1.0e6, 0, 'f', 1)
+                .arg(governor.regenerationBudgetNs() / 1.0e6, 0, 'f', 0)
+                .arg(decision.predictedFrameNs / 1.0e6, 0, 'f', 1)
+                .arg(governor.frameBudgetNs() / 1.0e6, 0, 'f', 1);
     }
-    if (b < c) {
-        return b;
-    } else {
-        return c;
+
+    // przewidywania są liniowe względem liczby węzłów, więc czas żądanej siatki wynika z proporcji
+    const double growth = static_cast<double>(gridNodes(decision.requestedSegments)) / nodes;
+    const QString requested = QStringLiteral("%1×%2×%3")
+                                      .arg(decision.requestedSegments[0]).arg(decision.requestedSegments[1])
+                                      .arg(decision.requestedSegments[2]);
+    if (decision.limit == GovernorLimit::Regeneration) {
+        return QStringLiteral("Siatkę ograniczono z %1 do %2: regeneracja trwałaby ~%3 ms przy budżecie %4 ms "
+                              "(%5 µs na węzeł)")
+                .arg(requested, chosen)
+                .arg(decision.predictedRegenerationNs * growth / 1.0e6, 0, 'f', 0)
+                .arg(governor.regenerationBudgetNs() / 1.0e6, 0, 'f', 0)
+                .arg(decision.predictedRegenerationNs / 1.0e3 / nodes, 0, 'f', 2);
+    }
+    return QStringLiteral("Siatkę ograniczono z %1 do %2: klatka trwałaby ~%3 ms przy budżecie %4 ms "
+                          "(%5 ns na trójkąt)")
+            .arg(requested, chosen)
+            .arg(decision.predictedFrameNs * growth / 1.0e6, 0, 'f', 1)
+            .arg(governor.frameBudgetNs() / 1.0e6, 0, 'f', 1)
+            .arg(governor.nsPerTriangle(), 0, 'f', 1);
+}
+
+static QVector<int> exportScales(int resolution) {
+    switch (resolution) {
+    case 1:
+        return {2};
+    case 2:
+        return {1, 2, 4};
+    default:
+        return {1};
     }
 }
 
 Scatter::Scatter(Q3DScatter *scatter)
         : m_graph(scatter),
-          m_function([](const QVector3D &&vec, float, float, float) { return QVector3D(vec.x(), vec.y(), vec.z()); }),
+          m_chunkQueue(std::make_shared<LockFreeQueue<GlyphChunk>>()),
+          m_latestGeneration(std::make_shared<std::atomic<quint64>>(0)),
+          m_pool(std::make_shared<WorkStealingPool>(qEnvironmentVariableIntValue("VFV_THREADS"))),
+          m_nativeExpressions(qEnvironmentVariableIsSet("VFV_NATIVE_EXPRESSIONS")),
           m_xRange(-horizontalRange, horizontalRange),
           m_yRange(-verticalRange, verticalRange),
           m_zRange(-horizontalRange, horizontalRange),
-          m_arrowLength(50) {
+          m_validateGlyphCount(qEnvironmentVariableIsSet("VFV_VALIDATE_GLYPHS")),
+          m_arrowLength(50),
+          m_exportQueue([this](const QSize &size) { return m_graph->renderToImage(exportSamples, size); }) {
 
     m_graph->setShadowQuality(QAbstract3DGraph::ShadowQualityNone);
     m_graph->scene()->activeCamera()->setCameraPreset(Q3DCamera::CameraPresetFront);
+    connect(m_graph->scene()->activeCamera(), &Q3DCamera::zoomLevelChanged, this, &Scatter::updateArrowDetail);
     //m_graph->customItems().clear();
     m_graph->activeTheme()->setType(Q3DTheme::ThemeQt);
 
@@ -54,102 +131,877 @@ Scatter::Scatter(Q3DScatter *scatter)
     m_graph->axisX()->setSegmentCount(static_cast<int>(horizontalRange));
     m_graph->axisZ()->setSegmentCount(static_cast<int>(horizontalRange));
 
+    m_expressionSource[0] = QStringLiteral("a*x");
+    m_expressionSource[1] = QStringLiteral("b*y");
+    m_expressionSource[2] = QStringLiteral("c*z");
+    m_expression = FieldExpression::compile("a*x", "b*y", "c*z", nullptr);
+    m_nativeCompilePool.setMaxThreadCount(1);
+    m_nativeCompileTimer.setSingleShot(true);
+    m_nativeCompileTimer.setInterval(nativeCompileDelay);
+    connect(&m_nativeCompileTimer, &QTimer::timeout, this, &Scatter::compileNativeExpression);
+    if (m_nativeExpressions) {
+        compileNativeExpression();
+    }
+
+    m_regenerationTimer.setSingleShot(true);
+    m_regenerationTimer.setInterval(defaultRegenerationDelay);
+    connect(&m_regenerationTimer, &QTimer::timeout, this, &Scatter::flushScheduledRegeneration);
+
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(cameraSettleDelay);
+    connect(&m_settleTimer, &QTimer::timeout, this, &Scatter::settleCamera);
+    m_chunkTimer.setInterval(chunkDrainInterval);
+    connect(&m_chunkTimer, &QTimer::timeout, this, &Scatter::drainGlyphChunks);
+    Q3DCamera *camera = m_graph->scene()->activeCamera();
+    connect(camera, &Q3DCamera::xRotationChanged, this, &Scatter::cameraMoved);
+    connect(camera, &Q3DCamera::yRotationChanged, this, &Scatter::cameraMoved);
+    connect(camera, &Q3DCamera::zoomLevelChanged, this, &Scatter::cameraMoved);
+    connect(camera, &Q3DCamera::targetChanged, this, &Scatter::cameraMoved);
+    connect(m_graph, &QAbstract3DGraph::currentFpsChanged, this, &Scatter::frameRateMeasured);
+    connect(&m_exportQueue, &ExportQueue::progressChanged, this, &Scatter::exportProgress);
+    connect(&m_exportQueue, &ExportQueue::targetFinished, this, [this](const ExportResult &result) {
+        qCInfo(lcPipeline, "export: file=%s ok=%d bytes=%lld captureMs=%.3f scaleMs=%.3f encodeMs=%.3f",
+               qPrintable(result.fileName), result.ok, result.bytes, result.captureTimeNs / 1.0e6,
+               result.scaleTimeNs / 1.0e6, result.encodeTimeNs / 1.0e6);
+        Q_EMIT exportFinished(result.ok
+                              ? QStringLiteral("Zapisano %1 (%2 KiB, przechwycenie %3 ms, kodowanie %4 ms)")
+                                        .arg(QFileInfo(result.fileName).fileName())
+                                        .arg(result.bytes / 1024)
+                                        .arg(result.captureTimeNs / 1.0e6, 0, 'f', 0)
+                                        .arg((result.scaleTimeNs + result.encodeTimeNs) / 1.0e6, 0, 'f', 0)
+                              : QStringLiteral("Nie zapisano %1: %2").arg(result.fileName, result.error));
+    });
+
+    // wczytanie siatek z zasobów odbywa się raz, przed utworzeniem pierwszych strzałek
+    MeshRegistry::instance();
+
     generateAndRenderVectors();
 }
 
 Scatter::~Scatter() {
-    m_graph->removeCustomItems();
+    // przerwanie zleceń, które jeszcze działają w tle
+    ++(*m_latestGeneration);
+    clearGlyphs();
     delete m_graph;
 }
 
 void Scatter::generateAndRenderVectors() {
-    m_graph->removeCustomItems();
+    m_regenerationTimer.stop();
+    m_dirty = {};
+    applyGovernor();
+    m_regenerationClock.start();
+    const quint64 generation = ++(*m_latestGeneration);
+    applyPreparedGlyphs(prepareGlyphs(parameters(), generation, []() { return false; }));
+}
+
+void Scatter::showPreparedGlyphs(PreparedGlyphs &&prepared) {
+    m_regenerationTimer.stop();
+    m_dirty = {};
+    m_regenerationClock.start();
+    prepared.generation = ++(*m_latestGeneration);
+    applyPreparedGlyphs(std::move(prepared));
+}
+
+void Scatter::requestRegeneration() {
+    applyGovernor();
+    m_regenerationClock.start();
+    const quint64 generation = ++(*m_latestGeneration);
+    const FieldParameters params = parameters();
+    const std::shared_ptr<std::atomic<quint64>> latest = m_latestGeneration;
+    const bool progressive = m_progressiveRendering && progressiveLevelCount(params) > 1;
+    // wątek roboczy nie odwołuje się do obiektu Scatter, fragmenty odbiera tylko przez kolejkę
+    const std::shared_ptr<LockFreeQueue<GlyphChunk>> chunks = m_chunkQueue;
+
+    auto watcher = new QFutureWatcher<PreparedGlyphs>(this);
+    connect(watcher, &QFutureWatcher<PreparedGlyphs>::finished, this, [this, watcher]() {
+        applyPreparedGlyphs(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([params, generation, latest, progressive, chunks]() {
+        const CancelCheck cancelled = [&]() { return latest->load() != generation; };
+        if (progressive) {
+            return prepareGlyphsProgressively(params, generation, cancelled,
+                                              [&](GlyphChunk &&chunk) { chunks->push(std::move(chunk)); });
+        }
+        return prepareGlyphs(params, generation, cancelled);
+    }));
+    if (progressive) {
+        m_chunkTimer.start();
+    }
+}
+
+void Scatter::drainGlyphChunks() {
+    const quint64 latest = m_latestGeneration->load();
+    int levels = 0;
+    GlyphChunk chunk;
+    while (m_chunkQueue->pop(chunk)) {
+        if (chunk.generation != latest) {
+            continue;
+        }
+        if (chunk.generation != m_previewGeneration) {
+            // pierwszy fragment nowego zlecenia zastępuje poprzednie strzałki; poziom szczegółów dobierany jest
+            // od razu dla pełnej siatki, żeby nie wymieniać siatek strzałek w trakcie podglądu
+            m_previewGeneration = chunk.generation;
+            m_previewGlyphs.clear();
+            m_arrowDetail = currentArrowDetail(chunk.nodeCount);
+            m_stats.firstGlyphTimeNs = 0;
+        }
+        m_previewGlyphs += chunk.glyphs;
+        levels = chunk.level + 1;
+    }
+    if (levels == 0) {
+        return;
+    }
+
+    m_previewing = true;
+    displayGlyphs(m_previewGlyphs);
+    m_stats.displayedCount = m_previewGlyphs.size();
+    if (m_interacting) {
+        showInteractionSubset();
+    }
+    if (m_stats.firstGlyphTimeNs == 0) {
+        m_stats.firstGlyphTimeNs = m_regenerationClock.nsecsElapsed();
+    }
+    m_stats.previewLevelCount = levels;
+    Q_EMIT statisticsChanged(m_stats);
+}
+
+FieldParameters Scatter::parameters() const {
+    FieldParameters params;
+    params.xRange = m_xRange;
+    params.yRange = m_yRange;
+    params.zRange = m_zRange;
+    if (m_governorEnabled) {
+        params.xSegments = m_governorDecision.segments[0];
+        params.ySegments = m_governorDecision.segments[1];
+        params.zSegments = m_governorDecision.segments[2];
+    } else {
+        params.xSegments = m_graph->axisX()->segmentCount();
+        params.ySegments = m_graph->axisY()->segmentCount();
+        params.zSegments = m_graph->axisZ()->segmentCount();
+    }
+    if (limitGridSize(params)) {
+        qCWarning(lcPipeline, "grid limited to %dx%dx%d segments (%lld nodes at most)",
+                  params.xSegments, params.ySegments, params.zSegments, FieldGrid::maxNodeCount);
+    }
+    params.kind = m_fieldKind;
+    params.kernel = batchKernel(m_fieldKind);
+    if (m_customField) {
+        params.expression = m_expression;
+        if (m_native) {
+            params.kernel = m_native->kernel();
+            params.native = m_native;
+        }
+    }
+    if (m_fileField && m_sampledField) {
+        params.kernel = nullptr;
+        params.sampled = m_sampledField;
+    }
+    params.a = m_a;
+    params.b = m_b;
+    params.c = m_c;
+    params.cutByPlain = m_cutByPlain;
+    params.plainA = m_plainA;
+    params.plainB = m_plainB;
+    params.plainC = m_plainC;
+    params.plainD = m_plainD;
+    params.lengthOption = m_lenghtOption;
+    params.arrowLength = m_arrowLength;
+    params.pool = m_pool;
+    params.validate = m_validateGlyphCount;
+    params.basis = m_basis;
+    return params;
+}
+
+void Scatter::applyPreparedGlyphs(PreparedGlyphs &&prepared) {
+    if (prepared.cancelled || prepared.generation != m_latestGeneration->load()) {
+        return;
+    }
+
+    // pozostałe fragmenty tego zlecenia są już zbędne, pełne strzałki zastępują podgląd
+    m_chunkTimer.stop();
+    GlyphChunk staleChunk;
+    while (m_chunkQueue->pop(staleChunk)) {
+    }
+    const bool previewed = m_previewing && m_previewGeneration == prepared.generation;
+    m_previewing = false;
+    m_previewGlyphs.clear();
+
+    m_grid = std::move(prepared.grid);
+    m_basis = std::move(prepared.basis);
+    m_glyphs = std::move(prepared.glyphs);
+    if (!m_interacting) {
+        m_interactionStride = 0;
+    }
+    m_arrowDetail = currentArrowDetail(m_glyphs.size());
+    if (prepared.lengthOption != m_lenghtOption || prepared.arrowLength != m_arrowLength) {
+        // długość zmieniła się w trakcie próbkowania i została już nałożona na poprzednie strzałki
+        styleGlyphs(parameters(), m_grid, m_glyphs);
+    }
+
+    m_stats.stage = PipelineStage::Sample;
+    m_stats.sampledCount = m_grid.size();
+    m_stats.invalidCount = m_grid.invalidCount;
+    m_stats.clippedCount = m_grid.size() - m_grid.visibleCount - m_grid.invalidCount;
+    m_stats.emittedCount = m_glyphs.size();
+    m_stats.sampleTimeNs = prepared.sampleTimeNs;
+    m_stats.glyphTimeNs = prepared.glyphTimeNs;
+    m_stats.threadCount = m_pool->threadCount();
+    m_stats.rescaled = prepared.rescaled;
+    if (!prepared.rescaled) {
+        // przeskalowanie bazy pomija próbkowanie pola i zaniżałoby koszt węzła
+        m_governor.recordGeneration(m_stats.sampledCount, m_stats.sampleTimeNs + m_stats.glyphTimeNs);
+    }
+    checkGlyphCount();
+    if (m_validateGlyphCount && !prepared.statisticsMatch) {
+        qFatal("Scatter: parallel grid statistics differ from the serial reduction");
+    }
+
+    uploadGlyphs();
+    m_stats.fullDetailTimeNs = m_regenerationClock.nsecsElapsed();
+    if (!previewed) {
+        m_stats.firstGlyphTimeNs = m_stats.fullDetailTimeNs;
+        m_stats.previewLevelCount = 0;
+    }
+
+    if (m_stats.invalidCount > 0) {
+        qCWarning(lcPipeline, "skipped %d samples with infinite or NaN field values", m_stats.invalidCount);
+    }
+    qCInfo(lcPipeline, "sampled=%d%s clipped=%d emitted=%d textures=%d uploadBytes=%lld "
+                       "items reused=%d created=%d destroyed=%d triangles=%lld lod=%d "
+                       "sampleMs=%.3f glyphMs=%.3f renderMs=%.3f firstGlyphMs=%.3f fullDetailMs=%.3f previewLevels=%d",
+           m_stats.sampledCount, m_stats.rescaled ? " (rescaled)" : "", m_stats.clippedCount, m_stats.emittedCount,
+           m_stats.textureCount, m_stats.textureUploadBytes,
+           m_stats.reusedItemCount, m_stats.createdItemCount, m_stats.destroyedItemCount,
+           m_stats.triangleCount, m_stats.detailLevel,
+           m_stats.sampleTimeNs / 1.0e6, m_stats.glyphTimeNs / 1.0e6, m_stats.renderTimeNs / 1.0e6,
+           m_stats.firstGlyphTimeNs / 1.0e6, m_stats.fullDetailTimeNs / 1.0e6, m_stats.previewLevelCount);
+    Q_EMIT statisticsChanged(m_stats);
+}
+
+void Scatter::displayGlyphs(const QVector<Glyph> &glyphs) {
+    clearGlyphSeries();
+    if (m_renderBackend != RenderBackend::MergedMesh) {
+        clearMergedMesh();
+    }
     m_graph->clearSelection();
 
-    float min = 10000.;
-    float max = 0.;
+    if (m_renderBackend != RenderBackend::CustomItems) {
+        m_stats.reusedItemCount = 0;
+        m_stats.createdItemCount = 0;
+        m_stats.destroyedItemCount = 0;
+        destroyGlyphItems(m_glyphItems.size());
+    }
+    if (m_renderBackend == RenderBackend::ScatterSeries) {
+        renderScatterSeries(glyphs);
+    } else if (m_renderBackend == RenderBackend::MergedMesh) {
+        renderMergedMesh(glyphs);
+    } else {
+        renderCustomItems(glyphs);
+    }
+}
+
+void Scatter::uploadGlyphs() {
+    QElapsedTimer timer;
+    timer.start();
+    displayGlyphs(m_glyphs);
+    m_stats.renderTimeNs = timer.nsecsElapsed();
+    m_governor.recordUpload(static_cast<int>(m_renderBackend), m_glyphs.size(), m_stats.renderTimeNs);
+    m_stats.displayedCount = m_glyphs.size();
+    if (m_interacting) {
+        showInteractionSubset();
+    }
+    m_stats.detailLevel = m_arrowDetail.level;
+    m_stats.triangleCount = static_cast<qint64>(m_glyphs.size())
+                            * MeshRegistry::instance().mesh(m_arrowDetail.mesh).triangleCount();
+}
+
+void Scatter::setTargetFrameRate(int fps) {
+    m_targetFrameRate = qMax(0, fps);
+    m_interactionStride = 0;
+    if (m_interacting) {
+        settleCamera();
+    }
+}
+
+void Scatter::setProgressiveRendering(bool enabled) {
+    m_progressiveRendering = enabled;
+}
+
+void Scatter::setGovernorEnabled(bool enabled) {
+    m_governorEnabled = enabled;
+    if (!enabled) {
+        Q_EMIT governorChanged(QString());
+    }
+    scheduleRegeneration(DirtyGrid);
+}
+
+void Scatter::setGovernorBudgets(int regenerationMs, int frameMs) {
+    m_governor.setBudgets(static_cast<qint64>(regenerationMs) * 1000000, static_cast<qint64>(frameMs) * 1000000);
+    if (m_governorEnabled) {
+        scheduleRegeneration(DirtyGrid);
+    }
+}
+
+void Scatter::applyGovernor() {
+    if (!m_governorEnabled) {
+        return;
+    }
+    // najmniejsza liczba węzłów mieszcząca się w budżecie klatki liczona jest dla najprostszej strzałki,
+    // bo przy większej liczbie strzałek i tak zostanie ona wybrana przez currentArrowDetail
+    m_governorDecision = m_governor.decide(m_graph->axisX()->segmentCount(), m_graph->axisY()->segmentCount(),
+                                           m_graph->axisZ()->segmentCount(), static_cast<int>(m_renderBackend),
+                                           MeshRegistry::instance().mesh(MeshId::Cone).triangleCount());
+    qCInfo(lcPipeline, "governor: segments=%dx%dx%d requested=%dx%dx%d maxNodes=%lld limit=%d "
+                       "predictedRegenMs=%.1f predictedFrameMs=%.1f nsPerNode=%.1f nsPerTriangle=%.2f",
+           m_governorDecision.segments[0], m_governorDecision.segments[1], m_governorDecision.segments[2],
+           m_governorDecision.requestedSegments[0], m_governorDecision.requestedSegments[1],
+           m_governorDecision.requestedSegments[2], m_governorDecision.maxNodes,
+           static_cast<int>(m_governorDecision.limit), m_governorDecision.predictedRegenerationNs / 1.0e6,
+           m_governorDecision.predictedFrameNs / 1.0e6, m_governor.nsPerNode(), m_governor.nsPerTriangle());
+    Q_EMIT governorChanged(explainGovernorDecision(m_governorDecision, m_governor));
+}
+
+void Scatter::cameraMoved() {
+    if (m_targetFrameRate <= 0 || m_exportingPoster) {
+        return;
+    }
+    m_settleTimer.start();
+    if (m_interacting) {
+        return;
+    }
+
+    m_interacting = true;
+    // czas klatki mierzony jest tylko w trakcie ruchu kamery, bo pomiar wymusza ciągłe renderowanie
+    m_measureFpsBeforeInteraction = m_graph->measureFps();
+    m_graph->setMeasureFps(true);
+    if (m_interactionStride == 0) {
+        // pierwszy ruch kamery dla tych strzałek - podział szacowany z liczby trójkątów,
+        // a jeśli zmierzono już czas klatki pełnego zbioru, to z niego
+        const double targetNs = 1.0e9 / m_targetFrameRate;
+        const double estimate = m_stats.settledFrameTimeNs > 0
+                                ? m_stats.settledFrameTimeNs / targetNs
+                                : m_stats.triangleCount / (interactionTriangleBudget * 60.0 / m_targetFrameRate);
+        m_interactionStride = qBound(1, qCeil(estimate), qMax(1, m_glyphs.size()));
+    }
+    showInteractionSubset();
+    Q_EMIT statisticsChanged(m_stats);
+}
+
+void Scatter::settleCamera() {
+    if (!m_interacting) {
+        return;
+    }
+    m_settleTimer.stop();
+    m_interacting = false;
+    m_graph->setMeasureFps(m_measureFpsBeforeInteraction);
+    showInteractionSubset();
+    Q_EMIT statisticsChanged(m_stats);
+}
+
+void Scatter::frameRateMeasured(qreal fps) {
+    if (fps <= 0.0) {
+        return;
+    }
+    const qint64 frameNs = static_cast<qint64>(1.0e9 / fps);
+    m_governor.recordFrame(static_cast<qint64>(m_stats.displayedCount)
+                                   * MeshRegistry::instance().mesh(m_arrowDetail.mesh).triangleCount(),
+                           frameNs);
+    if (!m_interacting) {
+        m_stats.settledFrameTimeNs = frameNs;
+        Q_EMIT statisticsChanged(m_stats);
+        return;
+    }
 
-    std::vector<float> lengths;
+    m_stats.interactionFrameTimeNs = frameNs;
+    if (m_interactionStride <= 1) {
+        m_stats.settledFrameTimeNs = frameNs;
+    }
+    // podział jest zapamiętywany do kolejnych ruchów kamery, dopóki nie zmienią się strzałki;
+    // zmniejszany jest tylko przy dużym zapasie, żeby nie przełączać podzbiorów co pomiar
+    const double targetNs = 1.0e9 / m_targetFrameRate;
+    int stride = m_interactionStride;
+    if (frameNs > targetNs * 1.1) {
+        stride = qCeil(stride * (frameNs / targetNs));
+    } else if (frameNs < targetNs * 0.5) {
+        stride = stride / 2;
+    }
+    stride = qBound(1, stride, qMax(1, m_glyphs.size()));
+    if (stride != m_interactionStride) {
+        m_interactionStride = stride;
+        showInteractionSubset();
+    }
+    qCInfo(lcPipeline, "interaction: frameMs=%.2f targetMs=%.2f stride=%d displayed=%d",
+           frameNs / 1.0e6, targetNs / 1.0e6, m_interactionStride, m_stats.displayedCount);
+    Q_EMIT statisticsChanged(m_stats);
+}
 
-    QValue3DAxis *axisX = m_graph->axisX();
-    QValue3DAxis *axisY = m_graph->axisY();
-    QValue3DAxis *axisZ = m_graph->axisZ();
+void Scatter::showInteractionSubset() {
+    // w trakcie stopniowego próbkowania podzbiór wybierany jest z podglądu
+    const QVector<Glyph> &source = m_previewing ? m_previewGlyphs : m_glyphs;
+    const int stride = m_interacting ? qMax(1, m_interactionStride) : 1;
+    int displayed = 0;
 
-    for (float xr = m_xRange.first;
-         xr <= m_xRange.second; xr += (m_xRange.second - m_xRange.first) / axisX->segmentCount()) {
-        for (float yr = m_yRange.first;
-             yr <= m_yRange.second; yr += (m_yRange.second - m_yRange.first) / axisY->segmentCount()) {
-            for (float zr = m_zRange.first;
-                 zr <= m_zRange.second; zr += (m_zRange.second - m_zRange.first) / axisZ->segmentCount()) {
-                if (m_cutByPlain && isAbovePlain(xr, yr, zr)) {
-                    continue;
+    if (m_renderBackend == RenderBackend::CustomItems) {
+        // ukrycie obiektu z puli jest znacznie tańsze niż jego usunięcie i ponowne utworzenie po zatrzymaniu kamery
+        for (int i = 0; i < m_glyphItems.size(); i++) {
+            const bool visible = stride == 1 || keepDuringInteraction(i, source[i].color, stride);
+            if (m_glyphItems[i]->isVisible() != visible) {
+                m_glyphItems[i]->setVisible(visible);
+            }
+            displayed += visible;
+        }
+    } else {
+        QVector<Glyph> subset;
+        if (stride > 1) {
+            subset.reserve(source.size() / stride + 1);
+            for (int i = 0; i < source.size(); i++) {
+                if (keepDuringInteraction(i, source[i].color, stride)) {
+                    subset.append(source[i]);
                 }
-                auto vec = m_function(QVector3D(xr, yr, zr), m_a, m_b, m_c);
-                lengths.push_back(vec.lengthSquared());
-                if (vec.lengthSquared() > max) {
-                    max = vec.lengthSquared();
-                } else if (vec.lengthSquared() < min) {
-                    min = vec.lengthSquared();
+            }
+        }
+        const QVector<Glyph> &shown = stride > 1 ? subset : source;
+        displayed = shown.size();
+
+        if (m_renderBackend == RenderBackend::ScatterSeries) {
+            clearGlyphSeries();
+            renderScatterSeries(shown);
+        } else if (m_meshItem) {
+            // podzbiór siatki zapisywany jest raz dla danego podziału, po zatrzymaniu kamery wraca pełna siatka
+            if (stride == 1) {
+                m_meshItem->setMeshFile(m_meshFile);
+            } else {
+                if (m_subsetMeshStride != stride) {
+                    if (!m_subsetMeshFile.isEmpty()) {
+                        QFile::remove(m_subsetMeshFile);
+                    }
+                    m_subsetMeshFile = m_meshDirectory.filePath(QStringLiteral("glyphs-%1.obj").arg(++m_meshFileCount));
+                    m_subsetMeshStride = stride;
+                    GlyphMeshStats meshStats;
+                    if (!writeGlyphMesh(MeshRegistry::instance().mesh(m_arrowDetail.mesh), subset, m_palette,
+                                        glyphSpace(), m_pool.get(), m_subsetMeshFile, meshStats)) {
+                        qCWarning(lcPipeline, "cannot write merged glyph mesh %s", qPrintable(m_subsetMeshFile));
+                    }
                 }
+                m_meshItem->setMeshFile(m_subsetMeshFile);
             }
         }
     }
 
+    m_stats.interactionStride = stride;
+    m_stats.displayedCount = displayed;
+}
 
-    float stepx = (m_xRange.second - m_xRange.first) / axisX->segmentCount();
-    float stepy = (m_yRange.second - m_yRange.first) / axisY->segmentCount();
-    float stepz = (m_zRange.second - m_zRange.first) / axisZ->segmentCount();
+ArrowDetail Scatter::currentArrowDetail(int glyphCount) const {
+    const qint64 budget = m_governorEnabled ? m_governor.triangleBudget() : defaultArrowTriangleBudget;
+    return selectArrowDetail(glyphCount, m_graph->scene()->activeCamera()->zoomLevel(), budget);
+}
 
+void Scatter::updateArrowDetail() {
+    if (m_previewing || m_exportingPoster) {
+        // podgląd ma poziom dobrany dla pełnej siatki, po jej wyświetleniu poziom zostanie wybrany ponownie;
+        // powiększenie kafelków plakatu nie zmienia siatki strzałek
+        return;
+    }
+    const ArrowDetail detail = currentArrowDetail(m_glyphs.size());
+    if (detail.mesh != m_arrowDetail.mesh) {
+        m_arrowDetail = detail;
+        scheduleRegeneration(DirtyDetail);
+    }
+}
 
-    for (int h = 0; h < 3; h++) {
-        int i = 0;
-        for (float xr = m_xRange.first; xr <= m_xRange.second; xr += stepx) {
-            for (float yr = m_yRange.first; yr <= m_yRange.second; yr += stepy) {
-                for (float zr = m_zRange.first; zr <= m_zRange.second; zr += stepz) {
-                    if (m_cutByPlain && isAbovePlain(xr, yr, zr)) {
-                        continue;
-                    }
-                    auto vec = m_function(QVector3D(xr, yr, zr), m_a, m_b, m_c);
-                    auto item = new QCustom3DItem();
-                    if (m_lenghtOption == 0) {
-                        item->setScaling(
-                                QVector3D(0.05f, vec.lengthSquared() / max * minimum(stepx, stepy, stepz) / 10, 0.05f));
-                    } else if (m_lenghtOption == 1) {
-                        item->setScaling(QVector3D(0.07f, 0.12f, 0.07f));
-                    } else {
-                        item->setScaling(QVector3D(0.05f, m_arrowLength / 300.0f * vec.lengthSquared() / max, 0.05f));
-                    }
+void Scatter::restyleGlyphs(bool paletteChanged) {
+    QElapsedTimer timer;
+    timer.start();
 
-                    item->setMeshFile(QStringLiteral(":/arrow.obj"));
-                    auto out = static_cast<unsigned char>(abs((lengths[i] - min) * 255 / (max - min)));
-                    QImage img = QImage(2, 2, QImage::Format_RGB32);
-                    img.fill(QColor(static_cast<int>(out), 0, static_cast<int>(255 - out)));
-                    item->setTextureImage(img);
-                    i++;
-
-                    // rotation
-                    auto up = QVector3D(0, 1, 0);
-                    auto angle = qAcos(static_cast<double>(QVector3D::dotProduct(up, vec) / vec.length()));
-                    auto axis = QVector3D::crossProduct(up, vec);
-                    auto rot = QQuaternion::fromAxisAndAngle(axis, angle * static_cast<double>(radiansToDegrees));
-                    auto roty = QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f,
-                                                              (xr >= 0.0f && zr >= 0.0f) || (xr <= 0.0f && zr <= 0.0f)
-                                                              ? 90.0f : -90.0f);
-                    if (xr == 0.0f) {
-                        roty = QQuaternion::fromAxisAndAngle(0.0f, 1.0f, 0.0f, 180.0f);
-                        item->setRotation(roty * rot);
-                    } else if (zr == 0.0f) {
-                        item->setRotation(rot);
-                    } else {
-                        item->setRotation(roty * rot);
-                    }
+    styleGlyphs(parameters(), m_grid, m_glyphs);
 
-                    item->setPosition(QVector3D(xr, yr, zr));
-                    m_graph->addCustomItem(item);
+    int restyled = 0;
+    if (m_renderBackend == RenderBackend::ScatterSeries) {
+        if (paletteChanged) {
+            // inna liczba przedziałów zmienia przydział strzałek do serii, a nie tylko ich wygląd
+            uploadGlyphs();
+            restyled = m_glyphs.size();
+        } else {
+            // przydział do przedziałów zależy tylko od siatki, zmienia się jedynie średnia długość w serii
+            QVector<float> lengthSums(m_palette.binCount(), 0.0f);
+            QVector<int> counts(m_palette.binCount(), 0);
+            for (const Glyph &glyph : m_glyphs) {
+                int bin = m_palette.binOf(glyph.color);
+                lengthSums[bin] += glyph.scaling.y();
+                counts[bin]++;
+            }
+            for (int i = 0; i < m_glyphSeries.size(); i++) {
+                int bin = m_glyphSeriesBins[i];
+                float itemSize = seriesItemSize(lengthSums[bin] / counts[bin]);
+                if (m_glyphSeries[i]->itemSize() != itemSize) {
+                    m_glyphSeries[i]->setItemSize(itemSize);
+                    restyled += counts[bin];
                 }
             }
         }
-     }
+    } else if (m_renderBackend == RenderBackend::MergedMesh) {
+        // skalowanie i kolor zapisane są w wierzchołkach, więc siatkę trzeba zbudować od nowa
+        uploadGlyphs();
+        restyled = m_glyphs.size();
+    } else {
+        // pula obiektów porównuje nowe strzałki z wyświetlanymi, więc zmieniane jest tylko skalowanie i tekstura
+        restyled = renderCustomItems(m_glyphs);
+    }
+
+    m_stats.stage = PipelineStage::Style;
+    m_stats.restyledCount = restyled;
+    m_stats.styleTimeNs = timer.nsecsElapsed();
+
+    qCInfo(lcPipeline, "restyled=%d of %d palette=%s styleMs=%.3f",
+           m_stats.restyledCount, m_glyphs.size(), paletteChanged ? "changed" : "kept", m_stats.styleTimeNs / 1.0e6);
+    Q_EMIT statisticsChanged(m_stats);
+}
+
+float Scatter::seriesItemSize(float meanLength) {
+    return qBound(0.01f, meanLength * seriesItemSizeFactor, 1.0f);
+}
+
+PipelineStage Scatter::firstStage(DirtyFlags flags) {
+    if (flags & (DirtyGrid | DirtyField | DirtyClip)) {
+        return PipelineStage::Sample;
+    }
+    if (flags & (DirtyStyle | DirtyColor)) {
+        return PipelineStage::Style;
+    }
+    return PipelineStage::Upload;
+}
+
+void Scatter::checkGlyphCount() const {
+    // każdy węzeł, który nie został odcięty ani odrzucony, musi dać dokładnie jedną strzałkę
+    const int visible = m_stats.sampledCount - m_stats.clippedCount - m_stats.invalidCount;
+    const bool valid = m_stats.emittedCount == visible;
+    Q_ASSERT_X(valid, "Scatter::applyPreparedGlyphs", "emitted glyph count differs from visible sample count");
+    if (m_validateGlyphCount && !valid) {
+        qFatal("Scatter: emitted %d glyphs for %d visible samples", m_stats.emittedCount, visible);
+    }
+}
+
+void Scatter::setValidateGlyphCount(bool enabled) {
+    m_validateGlyphCount = enabled;
+}
+
+void Scatter::setThreadCount(int threadCount) {
+    // zlecenia działające w tle trzymają własną kopię wskaźnika, więc stara pula zostanie zwolniona po ich zakończeniu
+    m_pool = std::make_shared<WorkStealingPool>(threadCount);
+    scheduleRegeneration(DirtyGrid);
+}
+
+void Scatter::clearGlyphs() {
+    destroyGlyphItems(m_glyphItems.size());
+    clearGlyphSeries();
+    clearMergedMesh();
+}
+
+void Scatter::destroyGlyphItems(int count) {
+    if (count <= 0) {
+        return;
+    }
+    if (count == m_glyphItems.size() && !m_meshItem) {
+        m_graph->removeCustomItems();
+    } else {
+        // wykres szuka usuwanego obiektu liniowo, dlatego obiekty usuwane są od końca puli
+        for (int i = m_glyphItems.size() - 1; i >= m_glyphItems.size() - count; i--) {
+            m_graph->removeCustomItem(m_glyphItems[i]);
+        }
+    }
+    m_glyphItems.resize(m_glyphItems.size() - count);
+    m_itemGlyphs.resize(m_glyphItems.size());
+    m_stats.destroyedItemCount += count;
+}
+
+void Scatter::clearGlyphSeries() {
+    for (QScatter3DSeries *series : m_glyphSeries) {
+        m_graph->removeSeries(series);
+        delete series;
+    }
+    m_glyphSeries.clear();
+    m_glyphSeriesBins.clear();
+}
+
+int Scatter::renderCustomItems(const QVector<Glyph> &glyphs) {
+    m_stats.reusedItemCount = 0;
+    m_stats.createdItemCount = 0;
+    m_stats.destroyedItemCount = 0;
+
+    if (m_glyphItems.size() > 2 * glyphs.size()) {
+        // usuwanie pojedynczych obiektów kosztuje tyle, co przeszukanie listy wykresu - przy dużym
+        // zmniejszeniu siatki taniej jest usunąć całą pulę naraz i utworzyć brakujące obiekty od nowa
+        destroyGlyphItems(m_glyphItems.size());
+    } else {
+        destroyGlyphItems(m_glyphItems.size() - glyphs.size());
+    }
+
+    // tekstury obiektów z puli trzeba wymienić, gdy zmieniła się liczba przedziałów palety
+    const bool paletteChanged = m_itemPaletteBins != m_palette.binCount();
+    m_itemPaletteBins = m_palette.binCount();
+
+    // zmiana poziomu szczegółów wymienia tylko siatkę, reszta właściwości obiektów pozostaje bez zmian
+    const QString &arrowMesh = MeshRegistry::instance().meshFile(m_arrowDetail.mesh);
+    const bool meshChanged = m_itemMesh != m_arrowDetail.mesh;
+    m_itemMesh = m_arrowDetail.mesh;
+
+    int changedCount = 0;
+    int textureCount = 0;
+    for (int i = 0; i < m_glyphItems.size(); i++) {
+        const Glyph &glyph = glyphs[i];
+        Glyph &shown = m_itemGlyphs[i];
+        QCustom3DItem *item = m_glyphItems[i];
+        bool changed = false;
+        if (meshChanged) {
+            item->setMeshFile(arrowMesh);
+            changed = true;
+        }
+        if (glyph.position != shown.position) {
+            item->setPosition(glyph.position);
+            changed = true;
+        }
+        if (glyph.rotation != shown.rotation) {
+            item->setRotation(glyph.rotation);
+            changed = true;
+        }
+        if (glyph.scaling != shown.scaling) {
+            item->setScaling(glyph.scaling);
+            changed = true;
+        }
+        if (paletteChanged || m_palette.binOf(glyph.color) != m_palette.binOf(shown.color)) {
+            item->setTextureImage(m_palette.texture(m_palette.binOf(glyph.color)));
+            textureCount++;
+            changed = true;
+        }
+        shown = glyph;
+        changedCount += changed;
+    }
+    m_stats.reusedItemCount = m_glyphItems.size();
+
+    for (int i = m_glyphItems.size(); i < glyphs.size(); i++) {
+        const Glyph &glyph = glyphs[i];
+        auto item = new QCustom3DItem();
+        item->setScaling(glyph.scaling);
+        item->setMeshFile(arrowMesh);
+        item->setTextureImage(m_palette.texture(m_palette.binOf(glyph.color)));
+        item->setRotation(glyph.rotation);
+        item->setPosition(glyph.position);
+        m_graph->addCustomItem(item);
+        m_glyphItems.append(item);
+        m_itemGlyphs.append(glyph);
+    }
+    m_stats.createdItemCount = glyphs.size() - m_stats.reusedItemCount;
+    changedCount += m_stats.createdItemCount;
+    textureCount += m_stats.createdItemCount;
+
+    // QCustom3DItem nie potrafi współdzielić tekstury na GPU - renderer tworzy ją osobno dla każdego obiektu,
+    // palety oszczędzają jedynie tworzenie obrazów po stronie CPU; obiekty z niezmienionym kolorem zachowują teksturę
+    m_stats.textureCount = textureCount;
+    m_stats.textureUploadBytes = textureCount * m_palette.textureBytes();
+    return changedCount;
+}
+
+void Scatter::renderScatterSeries(const QVector<Glyph> &glyphs) {
+    // Seria ma jeden kolor i jeden rozmiar dla wszystkich punktów, dlatego strzałki dzielone są
+    // na przedziały palety - każdy przedział to jedno wywołanie rysowania.
+    const int binCount = m_palette.binCount();
+    QVector<QScatterDataArray *> arrays(binCount, nullptr);
+    QVector<float> lengthSums(binCount, 0.0f);
+
+    for (const Glyph &glyph : glyphs) {
+        int bin = m_palette.binOf(glyph.color);
+        if (!arrays[bin]) {
+            arrays[bin] = new QScatterDataArray;
+        }
+        QScatterDataItem item(glyph.position);
+        item.setRotation(glyph.rotation);
+        arrays[bin]->append(item);
+        lengthSums[bin] += glyph.scaling.y();
+    }
+
+    for (int bin = 0; bin < binCount; bin++) {
+        if (!arrays[bin]) {
+            continue;
+        }
+        float meanLength = lengthSums[bin] / arrays[bin]->size();
+
+        auto series = new QScatter3DSeries;
+        series->setMesh(QAbstract3DSeries::MeshUserDefined);
+        series->setUserDefinedMesh(MeshRegistry::instance().meshFile(m_arrowDetail.mesh));
+        series->setMeshSmooth(false);
+        series->setColorStyle(Q3DTheme::ColorStyleUniform);
+        series->setBaseColor(m_palette.color(bin));
+        series->setItemSize(seriesItemSize(meanLength));
+        series->dataProxy()->resetArray(arrays[bin]);
+        m_graph->addSeries(series);
+        m_glyphSeries.append(series);
+        m_glyphSeriesBins.append(bin);
+    }
+
+    // jednolity kolor serii nie wymaga żadnej tekstury
+    m_stats.textureCount = 0;
+    m_stats.textureUploadBytes = 0;
+}
+
+void Scatter::renderMergedMesh(const QVector<Glyph> &glyphs) {
+    if (glyphs.isEmpty() || !m_meshDirectory.isValid()) {
+        clearMergedMesh();
+        return;
+    }
+
+    const MeshData &shape = MeshRegistry::instance().mesh(m_arrowDetail.mesh);
+    if (glyphs.size() > maxGlyphMeshGlyphs(shape)) {
+        // jeden obiekt na strzałkę przy takiej liczbie strzałek zatrzymałby aplikację, więc siatka nie jest budowana
+        qCWarning(lcPipeline, "%d glyphs exceed the %d a merged glyph mesh can hold; choose a coarser grid or "
+                              "another render mode", glyphs.size(), maxGlyphMeshGlyphs(shape));
+        clearMergedMesh();
+        return;
+    }
+
+    // renderer przechowuje wczytane siatki według ścieżki pliku, dlatego każda przebudowa zapisuje nowy plik
+    const QString file = m_meshDirectory.filePath(QStringLiteral("glyphs-%1.obj").arg(++m_meshFileCount));
+
+    GlyphMeshStats meshStats;
+    if (!writeGlyphMesh(shape, glyphs, m_palette, glyphSpace(), m_pool.get(), file, meshStats)) {
+        qCWarning(lcPipeline, "cannot write merged glyph mesh %s", qPrintable(file));
+        QFile::remove(file);
+        return;
+    }
+
+    const bool created = !m_meshItem;
+    if (created) {
+        m_meshItem = new QCustom3DItem();
+        m_meshItem->setPositionAbsolute(true);
+        m_meshItem->setPosition(QVector3D(0.0f, 0.0f, 0.0f));
+        // wierzchołki siatki są już we współrzędnych sceny, a domyślne skalowanie obiektu to 0.1
+        m_meshItem->setScaling(QVector3D(1.0f, 1.0f, 1.0f));
+    }
+    m_meshItem->setMeshFile(file);
+    m_meshItem->setTextureImage(m_palette.strip());
+    // tekstura ustawiona po dodaniu obiektu, a przed pierwszą klatką, nie trafia do renderera i siatka jest czarna
+    if (created) {
+        m_graph->addCustomItem(m_meshItem);
+    }
+
+    // poprzednia siatka i jej podzbiór nie są już używane przez żaden obiekt
+    if (!m_meshFile.isEmpty()) {
+        QFile::remove(m_meshFile);
+    }
+    m_meshFile = file;
+    clearSubsetMesh();
+
+    m_stats.meshTriangleCount = meshStats.triangleCount;
+    m_stats.meshVertexBytes = meshStats.vertexBytes;
+    m_stats.meshFileBytes = meshStats.fileBytes;
+    m_stats.meshBuildTimeNs = meshStats.buildTimeNs + meshStats.writeTimeNs;
+    m_stats.textureCount = 1;
+    m_stats.textureUploadBytes = m_palette.strip().sizeInBytes();
+
+    qCInfo(lcPipeline, "merged mesh: glyphs=%d vertices=%d triangles=%d vertexBytes=%lld fileBytes=%lld "
+                       "buildMs=%.3f writeMs=%.3f",
+           glyphs.size(), meshStats.vertexCount, meshStats.triangleCount, meshStats.vertexBytes, meshStats.fileBytes,
+           meshStats.buildTimeNs / 1.0e6, meshStats.writeTimeNs / 1.0e6);
+}
+
+GlyphSpace Scatter::glyphSpace() const {
+    // obiekt siatki leży w środku sceny ze skalowaniem 1, więc położenia strzałek przeliczane są na współrzędne sceny
+    // tak, jak renderer przelicza położenia obiektów w trybie CustomItems; skalowanie strzałek pozostaje bezwzględne
+    return sceneGlyphSpace(QVector3D(m_graph->axisX()->min(), m_graph->axisY()->min(), m_graph->axisZ()->min()),
+                           QVector3D(m_graph->axisX()->max(), m_graph->axisY()->max(), m_graph->axisZ()->max()),
+                           static_cast<float>(m_graph->aspectRatio()),
+                           static_cast<float>(m_graph->horizontalAspectRatio()));
+}
+
+void Scatter::clearSubsetMesh() {
+    if (!m_subsetMeshFile.isEmpty()) {
+        QFile::remove(m_subsetMeshFile);
+        m_subsetMeshFile.clear();
+    }
+    m_subsetMeshStride = 0;
+}
+
+void Scatter::clearMergedMesh() {
+    if (m_meshItem) {
+        m_graph->removeCustomItem(m_meshItem);
+        m_meshItem = nullptr;
+    }
+    if (!m_meshFile.isEmpty()) {
+        QFile::remove(m_meshFile);
+        m_meshFile.clear();
+    }
+    clearSubsetMesh();
+    m_stats.meshTriangleCount = 0;
+    m_stats.meshVertexBytes = 0;
+    m_stats.meshFileBytes = 0;
+    m_stats.meshBuildTimeNs = 0;
+}
+
+void Scatter::setColorBinCount(int binCount) {
+    m_palette = ColorPalette(binCount);
+    scheduleRegeneration(DirtyColor);
+}
+
+void Scatter::scheduleRegeneration(DirtyFlags flags) {
+    if (m_dirty) {
+        // zmiana dołączona do regeneracji, która i tak jest już zaplanowana
+        m_stats.coalescedCount++;
+    } else {
+        m_pendingSince.start();
+    }
+    m_dirty |= flags;
+    // każda kolejna zmiana przesuwa regenerację o cały okres ciszy, ale przy ciągłych zmianach
+    // (np. przeciąganie suwaka) regeneracja i tak następuje co najwyżej po maxRegenerationLatency
+    if (!m_regenerationTimer.isActive() || m_pendingSince.elapsed() < maxRegenerationLatency) {
+        m_regenerationTimer.start();
+    }
+}
+
+void Scatter::flushScheduledRegeneration() {
+    if (!m_dirty) {
+        return;
+    }
+    const DirtyFlags dirty = m_dirty;
+    m_dirty = {};
+
+    if (m_previewing && firstStage(dirty) != PipelineStage::Sample) {
+        // styl zostanie nałożony na pełne strzałki po zakończeniu próbkowania, a podgląd tylko
+        // przechodzi do nowego trybu renderowania, palety lub poziomu szczegółów
+        displayGlyphs(m_previewGlyphs);
+        return;
+    }
+
+    // tylko zmiany siatki, pola i odcięcia wymagają ponownego próbkowania w tle; pozostałe
+    // korzystają ze strzałek zachowanych z poprzedniego generowania
+    switch (firstStage(dirty)) {
+    case PipelineStage::Sample:
+    case PipelineStage::Statistics:
+    case PipelineStage::Geometry:
+        requestRegeneration();
+        break;
+    case PipelineStage::Style:
+        if (dirty & DirtyBackend) {
+            styleGlyphs(parameters(), m_grid, m_glyphs);
+            uploadGlyphs();
+            m_stats.stage = PipelineStage::Style;
+            Q_EMIT statisticsChanged(m_stats);
+        } else {
+            restyleGlyphs(dirty.testFlag(DirtyColor));
+        }
+        break;
+    case PipelineStage::Upload:
+        uploadGlyphs();
+        m_stats.stage = PipelineStage::Upload;
+        qCInfo(lcPipeline, "upload only: triangles=%lld lod=%d renderMs=%.3f",
+               m_stats.triangleCount, m_stats.detailLevel, m_stats.renderTimeNs / 1.0e6);
+        Q_EMIT statisticsChanged(m_stats);
+        break;
+    }
+}
+
+void Scatter::setRegenerationDelay(int milliseconds) {
+    m_regenerationTimer.setInterval(qMax(0, milliseconds));
 }
 
 void Scatter::setXFirst(const QString &x) {
@@ -158,7 +1010,7 @@ void Scatter::setXFirst(const QString &x) {
     x.toFloat() > m_xRange.second ? m_xRange.first = -horizontalRange : m_xRange.first = x.toFloat();
 
     axis->setRange(m_xRange.first, m_xRange.second);
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setXSecond(const QString &x) {
@@ -167,7 +1019,7 @@ void Scatter::setXSecond(const QString &x) {
     x.toFloat() < m_xRange.first ? m_xRange.second = horizontalRange : m_xRange.second = x.toFloat();
 
     axis->setRange(m_xRange.first, m_xRange.second);
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setYFirst(const QString &y) {
@@ -176,7 +1028,7 @@ void Scatter::setYFirst(const QString &y) {
     y.toFloat() > m_yRange.second ? m_yRange.first = -horizontalRange : m_yRange.first = y.toFloat();
 
     axis->setRange(m_yRange.first, m_yRange.second);
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setYSecond(const QString &y) {
@@ -185,7 +1037,7 @@ void Scatter::setYSecond(const QString &y) {
     y.toFloat() < m_yRange.first ? m_yRange.second = horizontalRange : m_yRange.second = y.toFloat();
 
     axis->setRange(m_yRange.first, m_yRange.second);
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setZFirst(const QString &z) {
@@ -194,7 +1046,7 @@ void Scatter::setZFirst(const QString &z) {
     z.toFloat() > m_zRange.second ? m_zRange.first = -horizontalRange : m_zRange.first = z.toFloat();
 
     axis->setRange(m_zRange.first, m_zRange.second);
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setZSecond(const QString &z) {
@@ -203,7 +1055,7 @@ void Scatter::setZSecond(const QString &z) {
     z.toFloat() < m_zRange.first ? m_zRange.second = horizontalRange : m_zRange.second = z.toFloat();
 
     axis->setRange(m_zRange.first, m_zRange.second);
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setXRange(const QString &x) {
@@ -212,7 +1064,7 @@ void Scatter::setXRange(const QString &x) {
     !x.isEmpty() && x.toInt() > 0
     ? axis->setSegmentCount(x.toInt())
     : axis->setSegmentCount(static_cast<int>(horizontalRange));
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setYRange(const QString &y) {
@@ -221,7 +1073,7 @@ void Scatter::setYRange(const QString &y) {
     !y.isEmpty() && y.toInt() > 0
     ? axis->setSegmentCount(y.toInt())
     : axis->setSegmentCount(static_cast<int>(horizontalRange));
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setZRange(const QString &z) {
@@ -230,33 +1082,161 @@ void Scatter::setZRange(const QString &z) {
     !z.isEmpty() && z.toInt() > 0
     ? axis->setSegmentCount(z.toInt())
     : axis->setSegmentCount(static_cast<int>(horizontalRange));
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyGrid);
 }
 
 void Scatter::setArrowsLength(int arrowLength) {
     m_arrowLength = arrowLength;
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyStyle);
 }
 
 void Scatter::functionboxItemChanged(int index) {
-    if (index == 0)
-        m_function = [](const QVector3D &&vec, float a = 1, float b = 1, float c = 1) {
-            return QVector3D(a * vec.x(), b * vec.y(), c * vec.z());
-        };
-    else if (index == 1)
-        m_function = [](const QVector3D &&vec, float a = 1, float b = 1, float c = 1) {
-            return QVector3D(a * vec.y() * vec.z(), b * vec.x() * vec.z(), c * vec.x() * vec.y());
-        };
-    else if (index == 2) {
-        m_function = [](const QVector3D &&vec, float a = 1, float b = 1, float c = 1) {
-            return QVector3D(qSin(a * vec.x()), b * qSin(vec.y()), c * qSin(vec.z()));
-        };
-    } else if (index == 3) {
-        m_function = [](const QVector3D &&vec, float a = 1, float b = 1, float c = 1) {
-            return QVector3D(a * qTan(vec.x()), b * qTan(vec.y()), c * qTan(vec.z()));
-        };
+    m_customField = index == customFieldIndex;
+    m_fileField = index == fileFieldIndex;
+    if (index >= static_cast<int>(FieldKind::Linear) && index <= static_cast<int>(FieldKind::Tan))
+        m_fieldKind = static_cast<FieldKind>(index);
+    scheduleRegeneration(DirtyField);
+}
+
+void Scatter::setCustomP(const QString &p) {
+    m_expressionSource[0] = p.isEmpty() ? QStringLiteral("a*x") : p;
+    compileExpression();
+}
+
+void Scatter::setCustomQ(const QString &q) {
+    m_expressionSource[1] = q.isEmpty() ? QStringLiteral("b*y") : q;
+    compileExpression();
+}
+
+void Scatter::setCustomR(const QString &r) {
+    m_expressionSource[2] = r.isEmpty() ? QStringLiteral("c*z") : r;
+    compileExpression();
+}
+
+void Scatter::compileExpression() {
+    std::string error;
+    auto expression = FieldExpression::compile(m_expressionSource[0].toStdString(),
+                                               m_expressionSource[1].toStdString(),
+                                               m_expressionSource[2].toStdString(), &error);
+    if (!expression) {
+        // poprzednie poprawne wyrażenie pozostaje w użyciu, dopóki użytkownik nie poprawi błędu
+        Q_EMIT expressionError(QString::fromStdString(error));
+        return;
+    }
+    m_expression = expression;
+    m_native.reset();
+    Q_EMIT expressionError(QString());
+    if (m_nativeExpressions) {
+        scheduleNativeCompile();
+    }
+    if (m_customField) {
+        scheduleRegeneration(DirtyField);
     }
-    generateAndRenderVectors();
+}
+
+void Scatter::setNativeExpressions(bool enabled) {
+    m_nativeExpressions = enabled;
+    if (enabled) {
+        scheduleNativeCompile();
+    } else {
+        m_nativeCompileTimer.stop();
+        m_native.reset();
+        if (m_customField) {
+            scheduleRegeneration(DirtyField);
+        }
+    }
+}
+
+bool Scatter::loadFieldFile(const QString &fileName) {
+    QElapsedTimer timer;
+    timer.start();
+    QString error;
+    std::shared_ptr<const SampledField> field = SampledField::open(fileName, &error);
+    if (!field) {
+        qCWarning(lcPipeline, "cannot load field file: %s", qPrintable(error));
+        Q_EMIT fieldFileChanged(error);
+        return false;
+    }
+    m_sampledField = field;
+    const qint64 openTimeNs = timer.nsecsElapsed();
+    qCInfo(lcPipeline, "mapped field file %s: %dx%dx%d samples, %lld bytes in %.2f ms", qPrintable(fileName),
+           field->countX(), field->countY(), field->countZ(), field->fileSize(), openTimeNs / 1.0e6);
+
+    // oś z jedną próbką (pole stałe wzdłuż niej) dostaje domyślny przedział
+    const QVector3D lower = field->lower();
+    const QVector3D upper = field->upper();
+    auto domain = [](float first, float second) {
+        return first < second ? qMakePair(first, second) : qMakePair(-horizontalRange, horizontalRange);
+    };
+    m_xRange = domain(lower.x(), upper.x());
+    m_yRange = domain(lower.y(), upper.y());
+    m_zRange = domain(lower.z(), upper.z());
+    m_graph->axisX()->setRange(m_xRange.first, m_xRange.second);
+    m_graph->axisY()->setRange(m_yRange.first, m_yRange.second);
+    m_graph->axisZ()->setRange(m_zRange.first, m_zRange.second);
+
+    Q_EMIT fieldFileChanged(tr("%1×%2×%3 próbek, %4 MB (otwarcie %5 ms)")
+                            .arg(field->countX()).arg(field->countY()).arg(field->countZ())
+                            .arg(field->fileSize() / (1024.0 * 1024.0), 0, 'f', 1)
+                            .arg(openTimeNs / 1.0e6, 0, 'f', 2));
+    scheduleRegeneration(DirtyField | DirtyGrid);
+    return true;
+}
+
+void Scatter::scheduleNativeCompile() {
+    // każda zmiana wyrażenia przesuwa kompilację, kompilowane jest dopiero wyrażenie, przy którym użytkownik przerwał
+    m_nativeCompileTimer.start();
+}
+
+void Scatter::compileNativeExpression() {
+    using NativeResult = QPair<std::shared_ptr<const NativeField>, QString>;
+    if (!m_nativeExpressions || m_native || m_nativeCompiling == m_expression) {
+        return;
+    }
+    // trwa kompilacja starszego wyrażenia - kompilator nie jest przerywany, najnowsze wyrażenie czeka na swoją kolej
+    if (m_nativeCompiling) {
+        m_nativeCompilePending = true;
+        return;
+    }
+    const std::shared_ptr<const FieldExpression> expression = m_expression;
+    m_nativeCompiling = expression;
+
+    auto watcher = new QFutureWatcher<NativeResult>(this);
+    connect(watcher, &QFutureWatcher<NativeResult>::finished, this, [this, watcher, expression]() {
+        const NativeResult result = watcher->result();
+        watcher->deleteLater();
+        m_nativeCompiling.reset();
+        const bool pending = m_nativeCompilePending;
+        m_nativeCompilePending = false;
+        // wynik dla wyrażenia, które zostało już zastąpione nowszym, jest pomijany, a w jego miejsce
+        // kompilowane jest najnowsze wyrażenie, jeśli zażądano tego w trakcie tej kompilacji
+        if (!m_nativeExpressions || expression != m_expression) {
+            if (pending) {
+                compileNativeExpression();
+            }
+            return;
+        }
+        if (!result.first) {
+            qCWarning(lcPipeline, "native expression unavailable, using the interpreter: %s", qPrintable(result.second));
+            Q_EMIT nativeExpressionChanged(tr("Maszyna wirtualna (%1)").arg(result.second));
+            return;
+        }
+        m_native = result.first;
+        qCInfo(lcPipeline, "native expression %s in %.1f ms: %s",
+               m_native->fromCache() ? "loaded from cache" : "compiled",
+               m_native->compileTimeNs() / 1.0e6, qPrintable(m_native->libraryPath()));
+        Q_EMIT nativeExpressionChanged(m_native->fromCache()
+                                       ? tr("Kod natywny (z pamięci podręcznej)")
+                                       : tr("Kod natywny (kompilacja %1 ms)").arg(m_native->compileTimeNs() / 1000000));
+        if (m_customField) {
+            scheduleRegeneration(DirtyField);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(&m_nativeCompilePool, [expression]() {
+        QString error;
+        std::shared_ptr<const NativeField> native = NativeField::load(*expression, &error);
+        return NativeResult(native, error);
+    }));
 }
 
 void Scatter::themeboxItemChanged(int index) {
@@ -266,65 +1246,164 @@ void Scatter::themeboxItemChanged(int index) {
         m_graph->activeTheme()->setType(Q3DTheme::ThemeEbony);
 }
 
+void Scatter::renderBackendChanged(int index) {
+    m_renderBackend = static_cast<RenderBackend>(qBound(0, index, static_cast<int>(RenderBackend::MergedMesh)));
+    DirtyFlags flags = DirtyBackend;
+    if (m_governorEnabled) {
+        // koszt przekazania strzałek do wykresu zależy od trybu, więc ograniczona siatka może być inna
+        flags |= DirtyGrid;
+    }
+    scheduleRegeneration(flags);
+}
+
 void Scatter::setA(const QString &a) {
-    m_a = a.toInt();
-    generateAndRenderVectors();
+    m_a = a.toFloat();
+    scheduleRegeneration(DirtyField);
 }
 
 void Scatter::setB(const QString &b) {
-    m_b = b.toInt();
-    generateAndRenderVectors();
+    m_b = b.toFloat();
+    scheduleRegeneration(DirtyField);
 }
 
 void Scatter::setC(const QString &c) {
-    m_c = c.toInt();
-    generateAndRenderVectors();
+    m_c = c.toFloat();
+    scheduleRegeneration(DirtyField);
 }
 
 void Scatter::lengthboxItemChanged(int index) {
     m_lenghtOption = index;
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyStyle);
 }
 
 void Scatter::setCutByPlain(bool checked) {
     m_cutByPlain = checked;
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyClip);
 }
 
 void Scatter::setPlainA(const QString &A) {
     m_plainA = A.toFloat();
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyClip);
 }
 
 void Scatter::setPlainB(const QString &B) {
     m_plainB = B.toFloat();
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyClip);
 }
 
 void Scatter::setPlainC(const QString &C) {
     m_plainC = C.toFloat();
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyClip);
 }
 
 void Scatter::setPlainD(const QString &D) {
     m_plainD = D.toFloat();
-    generateAndRenderVectors();
+    scheduleRegeneration(DirtyClip);
 }
 
-bool Scatter::isAbovePlain(float x, float y, float z) {
-    return ((-m_plainD - (m_plainA * x) - (m_plainB * y)) / m_plainC) < z;
+void Scatter::setExportResolution(int index) {
+    m_exportResolution = index;
+}
+
+void Scatter::exportPoster(const QString &fileName) {
+    const QSize window = m_graph->size();
+    const double scale = static_cast<double>(posterLongSide) / qMax(1, qMax(window.width(), window.height()));
+    PosterOptions options;
+    options.size = QSize(qRound(window.width() * scale), qRound(window.height() * scale));
+    if (!m_graph->isOrthoProjection()) {
+        // kafelki są dokładnym wycinkiem widoku tylko w rzucie prostokątnym, więc plakat różniłby się od widoku
+        const QMessageBox::StandardButton answer = QMessageBox::question(
+                nullptr, tr("Plakat w rzucie prostokątnym"),
+                tr("Wykres jest w rzucie perspektywicznym, a plakat można złożyć z kafelków tylko w rzucie "
+                   "prostokątnym, więc będzie się różnił od widoku. Zapisać plakat w rzucie prostokątnym?"));
+        if (answer != QMessageBox::Yes) {
+            Q_EMIT exportFinished(QStringLiteral("Nie zapisano plakatu %1: widok jest w rzucie perspektywicznym")
+                                  .arg(QFileInfo(fileName).fileName()));
+            return;
+        }
+        options.allowOrthoSwitch = true;
+    }
+
+    m_exportingPoster = true;
+    PosterExporter exporter(m_graph);
+    // bez przetwarzania zdarzeń między kafelkami: timery regeneracji, wyniki zleceń w tle i kolejka zapisu
+    // mogłyby zmienić strzałki lub przechwycić widok kamery ustawionej na kafelek
+    const PosterResult result = exporter.exportPng(fileName, options, [this](int finished, int total) {
+        Q_EMIT exportProgress(finished, total);
+    });
+    m_exportingPoster = false;
+    Q_EMIT exportProgress(0, 0);
+
+    qCInfo(lcPipeline, "poster: file=%s ok=%d size=%dx%d tiles=%dx%d calibrationMs=%.1f renderMs=%.1f alignMs=%.1f "
+                       "encodeMs=%.1f bufferPeakBytes=%lld processPeakBytes=%lld processPeakBeforeBytes=%lld "
+                       "maxCorrection=%d projectionChanged=%d bytes=%lld",
+            qPrintable(fileName), result.ok, options.size.width(), options.size.height(), result.tiles, result.tiles,
+            result.calibrationTimeNs / 1.0e6, result.renderTimeNs / 1.0e6, result.alignTimeNs / 1.0e6,
+            result.encodeTimeNs / 1.0e6, result.bufferPeakBytes, result.processPeakBytes,
+            result.processPeakBeforeBytes, result.maxCorrection, result.projectionChanged, result.bytes);
+    if (!result.ok) {
+        Q_EMIT exportFinished(QStringLiteral("Nie zapisano plakatu %1: %2").arg(fileName, result.error));
+        return;
+    }
+    constexpr double mebibyte = 1024.0 * 1024.0;
+    Q_EMIT exportFinished(QStringLiteral("Zapisano plakat %1 (%2×%3, %4×%4 kafelków, %5 MiB): renderowanie %6 ms, "
+                                         "kodowanie %7 ms; bufory %8 MiB, szczytowa pamięć procesu %9 MiB "
+                                         "(przed zapisem %10 MiB)")
+                                  .arg(QFileInfo(fileName).fileName())
+                                  .arg(options.size.width()).arg(options.size.height()).arg(result.tiles)
+                                  .arg(result.bytes / mebibyte, 0, 'f', 1)
+                                  .arg((result.calibrationTimeNs + result.renderTimeNs + result.alignTimeNs) / 1.0e6,
+                                       0, 'f', 0)
+                                  .arg(result.encodeTimeNs / 1.0e6, 0, 'f', 0)
+                                  .arg(result.bufferPeakBytes / mebibyte, 0, 'f', 0)
+                                  .arg(result.processPeakBytes / mebibyte, 0, 'f', 0)
+                                  .arg(result.processPeakBeforeBytes / mebibyte, 0, 'f', 0)
+                          + (result.projectionChanged
+                             ? QStringLiteral("; rzut prostokątny zamiast perspektywicznego z widoku") : QString()));
 }
 
 void Scatter::handleButton() {
     QWidget w;
+    QString selectedFilter;
     QString fileName = QFileDialog::getSaveFileName(&w,
            tr("Save graph"), "",
-           tr("PNG (*.png);;All Files (*)"));
+           tr("PNG (*.png);;JPEG (*.jpg);;PNG + JPEG (*.png *.jpg);;All Files (*)"), &selectedFilter);
 
     if(fileName.isEmpty()) {
         QMessageBox::information(&w, tr("Unable to save file"), "No file name specified!");
         return;
     }
-    QPixmap pixmap;
-    m_graph->renderToImage(8).save(fileName, "png", 100);
+
+    if (m_exportResolution == posterResolution) {
+        exportPoster(fileName.endsWith(QStringLiteral(".png"), Qt::CaseInsensitive) ? fileName
+                                                                                   : fileName + QStringLiteral(".png"));
+        return;
+    }
+
+    // rozszerzenie wybiera format, a przy zapisie w kilku formatach lub rozmiarach jest zastępowane
+    const QByteArray fileFormat = ExportQueue::formatForFile(fileName);
+    QString baseName = fileName;
+    if (!fileFormat.isEmpty()) {
+        baseName.chop(QFileInfo(fileName).suffix().size() + 1);
+    }
+    QVector<QByteArray> formats;
+    if (selectedFilter == tr("PNG + JPEG (*.png *.jpg)")) {
+        formats = {"png", "jpg"};
+    } else {
+        formats = {fileFormat.isEmpty() ? QByteArray("png") : fileFormat};
+    }
+
+    QVector<ExportTarget> targets;
+    for (int scale : exportScales(m_exportResolution)) {
+        for (const QByteArray &format : formats) {
+            ExportTarget target;
+            target.fileName = baseName + (scale > 1 ? QStringLiteral("_%1x").arg(scale) : QString())
+                              + '.' + QString::fromLatin1(format);
+            target.format = format;
+            target.size = m_graph->size() * scale;
+            target.quality = format == "png" ? exportPngQuality : exportJpegQuality;
+            targets.append(target);
+        }
+    }
+    m_exportQueue.enqueue(targets);
 }
@@ -1,11 +1,39 @@
 #pragma once
 
 #include <QtDataVisualization/q3dscatter.h>
+#include <QtDataVisualization/qcustom3ditem.h>
 #include <QtDataVisualization/qscatterdataproxy.h>
+#include <QtDataVisualization/qscatter3dseries.h>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QThreadPool>
 #include <QtCore/QTimer>
 
+#include <atomic>
+#include <memory>
+
+#include "colorpalette.h"
+#include "exportqueue.h"
+#include "fieldpipeline.h"
+#include "framebudgetgovernor.h"
+#include "glyphmesh.h"
+#include "lockfreequeue.h"
+#include "meshregistry.h"
+#include "pipelinestats.h"
+
 using namespace QtDataVisualization;
 
+/**
+ * @brief RenderBackend - sposób przekazywania strzałek do renderera
+ */
+
+enum class RenderBackend
+{
+    CustomItems = 0,   ///< jeden obiekt QCustom3DItem (i jedno wywołanie rysowania) na strzałkę
+    ScatterSeries = 1, ///< strzałki przekazywane paczkami jako punkty serii QScatter3DSeries
+    MergedMesh = 2     ///< wszystkie strzałki połączone w jedną siatkę jednego obiektu QCustom3DItem
+};
+
 /**
  * @brief Scatter - klasa której instancja służy do wizualizacji wykresów w przestrzeni 3D
  */
@@ -14,6 +42,22 @@ class Scatter : public QObject
 {
     Q_OBJECT
 public:
+    /**
+     * @brief DirtyFlag - grupy parametrów zmienionych od ostatniej regeneracji
+     */
+
+    enum DirtyFlag
+    {
+        DirtyGrid = 0x01,    ///< przedziały zmienności lub liczba podprzedziałów - od etapu Sample
+        DirtyField = 0x02,   ///< funkcja lub stałe a, b, c - od etapu Sample
+        DirtyClip = 0x04,    ///< płaszczyzna odcinająca - od etapu Sample
+        DirtyStyle = 0x08,   ///< tryb i długość strzałek - etap Style na istniejących strzałkach
+        DirtyBackend = 0x10, ///< tryb renderowania - etap Upload z istniejących strzałek
+        DirtyColor = 0x20,   ///< paleta kolorów - etap Style na istniejących strzałkach
+        DirtyDetail = 0x40   ///< poziom szczegółów siatki strzałek - etap Upload z istniejących strzałek
+    };
+    Q_DECLARE_FLAGS(DirtyFlags, DirtyFlag)
+
     /**
      * @brief Scatter - konstruktor klasy scatter
      * @param scatter [Q3DScatter*] - wskaźnik na obiekt typu Q3DScatter, który dostarcza metody pozwalające na wizualizacę danch w przestrzeni.
@@ -28,10 +72,173 @@ public:
 
     /**
      * @brief generateAndRenderVectors funkcja, która generuje dane na podstawie parametrów wejściowych, potrzebne do przedstawienia ich w przestrzeni.
+     * Działa synchronicznie w wątku wywołującym i przerywa trwające generowanie w tle.
      */
 
     void generateAndRenderVectors();
 
+    /**
+     * @brief requestRegeneration - zleca wygenerowanie strzałek w wątku roboczym na podstawie kopii bieżących parametrów.
+     * Nowe zlecenie przerywa poprzednie, a do wykresu trafia tylko wynik najnowszego. Przy stopniowym wyświetlaniu
+     * duża siatka pojawia się najpierw w wersji rzadkiej, uzupełnianej fragmentami aż do pełnej.
+     */
+
+    void requestRegeneration();
+
+    /**
+     * @brief scheduleRegeneration - oznacza parametry jako zmienione i planuje jedną regenerację po okresie ciszy.
+     * Seria zmian następujących szybciej niż okres ciszy (np. wpisywanie liczby) daje tylko jedną regenerację.
+     * @param flags - zmienione grupy parametrów
+     */
+
+    void scheduleRegeneration(DirtyFlags flags);
+
+    /**
+     * @brief setRegenerationDelay - ustawia okres ciszy, po którym wykonywana jest zaplanowana regeneracja
+     * @param milliseconds - czas w milisekundach, 0 - regeneracja przy najbliższym obiegu pętli zdarzeń
+     */
+
+    void setRegenerationDelay(int milliseconds);
+
+    /**
+     * @brief statistics - zwraca liczniki ostatniego generowania strzałek
+     */
+
+    const PipelineStats& statistics() const { return m_stats; }
+
+    /**
+     * @brief setColorBinCount - zmienia liczbę przedziałów kolorów, na które dzielone są strzałki
+     * @param binCount - nowa liczba przedziałów
+     */
+
+    void setColorBinCount(int binCount);
+
+    /**
+     * @brief setTargetFrameRate - włącza tryb ruchu kamery: w czasie obracania lub przybliżania wykresu wyświetlany
+     * jest tylko podzbiór strzałek, dobierany tak, aby osiągnąć podaną liczbę klatek na sekundę; po zatrzymaniu
+     * kamery przywracane są wszystkie strzałki
+     * @param fps - docelowa liczba klatek na sekundę, 0 - zawsze wszystkie strzałki
+     */
+
+    void setTargetFrameRate(int fps);
+
+    /**
+     * @brief setProgressiveRendering - włącza stopniowe wyświetlanie dużych siatek: najpierw strzałki siatki rzadkiej,
+     * a potem kolejnych gęstszych poziomów, zanim zostanie spróbkowana cała siatka
+     * @param enabled - true - stopniowe wyświetlanie (domyślnie), false - strzałki pojawiają się po spróbkowaniu całości
+     */
+
+    void setProgressiveRendering(bool enabled);
+
+    /**
+     * @brief setGovernorEnabled - włącza automatyczne ograniczanie siatki: liczba podprzedziałów osi i poziom
+     * szczegółów strzałek dobierane są na podstawie zmierzonych czasów tak, aby regeneracja i klatka mieściły się
+     * w budżetach czasu; uzasadnienie wyboru wysyłane jest sygnałem governorChanged
+     * @param enabled - true - siatka ograniczana, false - próbkowana jest siatka osi
+     */
+
+    void setGovernorEnabled(bool enabled);
+
+    /**
+     * @brief setGovernorBudgets - zmienia budżety czasu używane przy automatycznym ograniczaniu siatki
+     * @param regenerationMs - największy czas od zmiany parametrów do wyświetlenia strzałek
+     * @param frameMs - największy czas klatki
+     */
+
+    void setGovernorBudgets(int regenerationMs, int frameMs);
+
+    /**
+     * @brief setValidateGlyphCount - włącza tryb kontrolny, w którym niezgodność liczby strzałek z liczbą
+     * widocznych próbek lub równoległych statystyk siatki z sekwencyjnymi kończy program (qFatal) również w wersji release. Domyślnie włączony, gdy ustawiona
+     * jest zmienna środowiskowa VFV_VALIDATE_GLYPHS.
+     * @param enabled - true - sprawdzanie włączone
+     */
+
+    void setValidateGlyphCount(bool enabled);
+
+    /**
+     * @brief setThreadCount - zmienia liczbę wątków próbkujących siatkę. Domyślna wartość pochodzi ze zmiennej
+     * środowiskowej VFV_THREADS, a gdy jej brak - z liczby rdzeni procesora.
+     * @param threadCount - liczba wątków, 0 - tyle ile rdzeni procesora, 1 - obliczenia sekwencyjne
+     */
+
+    void setThreadCount(int threadCount);
+
+    /**
+     * @brief parameters - tworzy kopię parametrów generowania, którą można bezpiecznie przekazać do innego wątku
+     */
+
+    FieldParameters parameters() const;
+
+    /**
+     * @brief sampledField - pole wczytane ostatnio z pliku (loadFieldFile), nullptr - nie wczytano żadnego
+     */
+
+    std::shared_ptr<const SampledField> sampledField() const { return m_sampledField; }
+
+    /**
+     * @brief showPreparedGlyphs - przekazuje do wykresu strzałki przygotowane przez prepareGlyphs poza obiektem
+     * Scatter (np. dla klatek animacji, ParameterSweep); przerywa generowanie w tle i zaplanowaną regenerację.
+     * Długość strzałek, która zmieniła się od wykonania kopii parametrów, jest nakładana na przygotowane strzałki.
+     * @param prepared - wynik prepareGlyphs dla kopii parametrów z parameters()
+     */
+
+    void showPreparedGlyphs(PreparedGlyphs&& prepared);
+
+Q_SIGNALS:
+
+    /**
+     * @brief statisticsChanged - sygnał wysyłany po każdym generowaniu strzałek
+     * @param stats - nowe wartości liczników
+     */
+
+    void statisticsChanged(const PipelineStats& stats);
+
+    /**
+     * @brief expressionError - sygnał wysyłany po każdej kompilacji wyrażeń pola użytkownika
+     * @param message - opis błędu, pusty gdy kompilacja się powiodła
+     */
+
+    void expressionError(const QString& message);
+
+    /**
+     * @brief nativeExpressionChanged - sygnał wysyłany po próbie skompilowania pola użytkownika do kodu natywnego
+     * @param message - opis wyniku (czas kompilacji, katalog podręczny lub przyczyna powrotu do maszyny wirtualnej)
+     */
+
+    void nativeExpressionChanged(const QString& message);
+
+    /**
+     * @brief fieldFileChanged - sygnał wysyłany po każdej próbie wczytania pola z pliku
+     * @param message - wymiary i rozmiar wczytanych danych albo przyczyna błędu
+     */
+
+    void fieldFileChanged(const QString& message);
+
+    /**
+     * @brief governorChanged - sygnał wysyłany przy każdym wyborze liczby podprzedziałów osi przez automatyczne
+     * ograniczanie siatki
+     * @param explanation - uzasadnienie wyboru (budżet, który go wymusił, i przewidywane czasy), pusty gdy
+     * ograniczanie jest wyłączone
+     */
+
+    void governorChanged(const QString& explanation);
+
+    /**
+     * @brief exportProgress - sygnał wysyłany po zleceniu zapisu i po zapisaniu każdego pliku
+     * @param finished - liczba zapisanych plików
+     * @param total - liczba zleconych plików, 0 gdy kolejka zapisu jest pusta
+     */
+
+    void exportProgress(int finished, int total);
+
+    /**
+     * @brief exportFinished - sygnał wysyłany po zapisaniu każdego pliku
+     * @param message - nazwa pliku i czasy zapisu albo przyczyna błędu
+     */
+
+    void exportFinished(const QString& message);
+
 public Q_SLOTS:
 
     /**
@@ -127,11 +334,52 @@ public Q_SLOTS:
 
     /**
      * @brief functionboxItemChanged - metoda która pozwala zmienić funkcję, za pomocą której wyznaczane są wektory
-     * @param index - indeks nowej funkcji
+     * @param index - indeks nowej funkcji, 4 - pole podane przez użytkownika (setCustomP, setCustomQ, setCustomR),
+     * 5 - pole wczytane z pliku (loadFieldFile)
      */
 
     void functionboxItemChanged(int index);
 
+    /**
+     * @brief setCustomP - ustawia wyrażenie składowej x pola użytkownika
+     * @param p - wyrażenie zależne od x, y, z, a, b, c
+     */
+
+    void setCustomP(const QString& p);
+
+    /**
+     * @brief setCustomQ - ustawia wyrażenie składowej y pola użytkownika
+     * @param q - wyrażenie zależne od x, y, z, a, b, c
+     */
+
+    void setCustomQ(const QString& q);
+
+    /**
+     * @brief setCustomR - ustawia wyrażenie składowej z pola użytkownika
+     * @param r - wyrażenie zależne od x, y, z, a, b, c
+     */
+
+    void setCustomR(const QString& r);
+
+    /**
+     * @brief setNativeExpressions - włącza kompilację pola użytkownika do kodu natywnego kompilatorem systemowym.
+     * Do czasu zakończenia kompilacji, a także gdy kompilator jest niedostępny, pole wyznacza maszyna wirtualna.
+     * Domyślnie włączone, gdy ustawiona jest zmienna środowiskowa VFV_NATIVE_EXPRESSIONS.
+     * @param enabled - true - kompilacja włączona
+     */
+
+    void setNativeExpressions(bool enabled);
+
+    /**
+     * @brief loadFieldFile - odwzorowuje w pamięć plik pola wektorowego (.vfv, format opisany w SampledField)
+     * i ustawia przedziały osi na obszar danych. Wczytywany jest tylko nagłówek, więc otwarcie nawet bardzo dużego
+     * pliku jest natychmiastowe; pole wyświetlane jest po wybraniu funkcji 5 - dane z pliku.
+     * @param fileName - ścieżka pliku
+     * @return false, gdy pliku nie udało się otworzyć; poprzednie pole pozostaje wtedy w użyciu
+     */
+
+    bool loadFieldFile(const QString& fileName);
+
     /**
      * @brief lengthboxItemChanged - metoda która zmienia tryb wyznaczania długości wektorów.
      * @param index - indeks trybu
@@ -146,6 +394,13 @@ public Q_SLOTS:
 
     void themeboxItemChanged(int index);
 
+    /**
+     * @brief renderBackendChanged - metoda która zmienia sposób renderowania strzałek
+     * @param index - indeks trybu, zgodny z wartościami RenderBackend
+     */
+
+    void renderBackendChanged(int index);
+
     /**
      * @brief setCutByPlain - metoda który pozwala na odcięcie wektorów powyżej zdefiniowanej płaszczyzny
      * @param checked - true - wektory będą odcinane, false - brak odcinania
@@ -182,7 +437,16 @@ public Q_SLOTS:
     void setPlainD(const QString& D);
 
     /**
-     * @brief handleButton - metoda która obsługuje kliknięcie przycisku zapis do pliku
+     * @brief setExportResolution - wybiera rozmiary plików zapisywanych przez handleButton
+     * @param index - 0 - rozmiar okna, 1 - dwukrotny rozmiar okna, 2 - rozmiar okna, dwukrotny i czterokrotny,
+     * 3 - plakat PNG renderowany z kafelków (exportPoster)
+     */
+
+    void setExportResolution(int index);
+
+    /**
+     * @brief handleButton - metoda która obsługuje kliknięcie przycisku zapis do pliku. Klatka przechwytywana
+     * jest w wątku GUI, a kodowanie i zapis plików odbywają się w tle (m_exportQueue)
      */
 
     void handleButton();
@@ -192,20 +456,509 @@ private:
 private:
 
     /**
-     * @brief isAbovePlain - metoda która determinuje czy wektor znajduje się nad płaszczyną
-     * @param x - parametr x testowanego wektora
-     * @param y - parametr y testowanego wektora
-     * @param z - parametr z testowanego wektora
-     * @return true -> wektor nad płaszczyną, false -> wektor pod płaszczyzną
+     * @brief exportPoster - zapisuje plakat PNG o dłuższym boku 16384 pikseli, składany z kafelków
+     * (PosterExporter). Renderowanie wymaga kontekstu OpenGL wykresu, więc odbywa się w wątku GUI bez
+     * przetwarzania zdarzeń aż do końca zapisu; postęp wysyłany jest sygnałem exportProgress po każdym kafelku
+     */
+
+    void exportPoster(const QString& fileName);
+
+    /**
+     * @brief compileExpression - kompiluje wyrażenia pola użytkownika i zgłasza ewentualny błąd sygnałem expressionError
+     */
+
+    void compileExpression();
+
+    /**
+     * @brief updateArrowDetail - wybiera poziom szczegółów strzałek dla bieżącego przybliżenia kamery,
+     * zmiana poziomu wymienia tylko siatki strzałek na wykresie, bez ponownego próbkowania pola
+     */
+
+    void updateArrowDetail();
+
+    /**
+     * @brief currentArrowDetail - poziom szczegółów strzałek dla podanej liczby strzałek i bieżącego przybliżenia
+     * kamery; przy włączonym ograniczaniu siatki budżet trójkątów wynika ze zmierzonego czasu klatki
+     */
+
+    ArrowDetail currentArrowDetail(int glyphCount) const;
+
+    /**
+     * @brief applyGovernor - wyznacza liczbę podprzedziałów osi dla kolejnego próbkowania i zgłasza zmianę
+     * sygnałem governorChanged
+     */
+
+    void applyGovernor();
+
+    /**
+     * @brief drainGlyphChunks - przenosi do podglądu fragmenty strzałek przygotowane przez wątek roboczy
+     * i wyświetla podgląd, jeśli przybyły nowe
+     */
+
+    void drainGlyphChunks();
+
+    /**
+     * @brief displayGlyphs - przekazuje strzałki do wykresu w bieżącym trybie renderowania
+     * @param glyphs - strzałki do wyświetlenia, m_glyphs lub podgląd m_previewGlyphs
+     */
+
+    void displayGlyphs(const QVector<Glyph>& glyphs);
+
+    /**
+     * @brief cameraMoved - wywoływana przy każdej zmianie kamery; rozpoczyna tryb ruchu kamery
+     * i odkłada jego zakończenie o cameraSettleDelay
+     */
+
+    void cameraMoved();
+
+    /**
+     * @brief settleCamera - kończy tryb ruchu kamery i przywraca wszystkie strzałki
+     */
+
+    void settleCamera();
+
+    /**
+     * @brief frameRateMeasured - zapisuje zmierzony czas klatki i w trybie ruchu kamery dopasowuje do niego podział
+     * @param fps - liczba klatek na sekundę zmierzona przez wykres
+     */
+
+    void frameRateMeasured(qreal fps);
+
+    /**
+     * @brief showInteractionSubset - w trybie ruchu kamery wyświetla co m_interactionStride-tą (średnio) strzałkę
+     * z m_glyphs, poza nim wszystkie; obiekty z puli są tylko ukrywane
+     */
+
+    void showInteractionSubset();
+
+    /**
+     * @brief glyphSpace - odwzorowanie bieżących przedziałów osi na współrzędne sceny wykresu
+     */
+
+    GlyphSpace glyphSpace() const;
+
+    /**
+     * @brief clearSubsetMesh - usuwa plik połączonej siatki podzbioru strzałek
+     */
+
+    void clearSubsetMesh();
+
+    /**
+     * @brief scheduleNativeCompile - planuje kompilację m_expression do kodu natywnego po okresie ciszy
+     * nativeCompileDelay, dzięki czemu pisanie wyrażenia nie uruchamia kompilatora po każdym znaku
+     */
+
+    void scheduleNativeCompile();
+
+    /**
+     * @brief compileNativeExpression - w wątku m_nativeCompilePool kompiluje m_expression do kodu natywnego,
+     * wynik trafia do m_native, o ile wyrażenie nie zmieniło się w międzyczasie. Jeśli kompilacja już trwa,
+     * zapamiętuje tylko, że po niej trzeba skompilować najnowsze wyrażenie.
+     */
+
+    void compileNativeExpression();
+
+    /**
+     * @brief flushScheduledRegeneration - wykonuje zaplanowaną regenerację, jeśli jakiś parametr został zmieniony
+     */
+
+    void flushScheduledRegeneration();
+
+    /**
+     * @brief firstStage - pierwszy etap, który trzeba wykonać po zmianie parametrów z grupy flags
+     */
+
+    static PipelineStage firstStage(DirtyFlags flags);
+
+    /**
+     * @brief restyleGlyphs - etap Style: zmienia skalowanie i kolor strzałek z m_glyphs na podstawie zachowanej siatki
+     * i aktualizuje istniejące obiekty wykresu, bez próbkowania pola i bez tworzenia obiektów od nowa
+     * @param paletteChanged - czy zmieniła się paleta, czyli tekstury lub podział na serie
+     */
+
+    void restyleGlyphs(bool paletteChanged);
+
+    /**
+     * @brief uploadGlyphs - etap Upload: usuwa strzałki z wykresu i przekazuje do niego m_glyphs w bieżącym trybie renderowania
+     */
+
+    void uploadGlyphs();
+
+    /**
+     * @brief seriesItemSize - rozmiar punktu serii dla średniej długości strzałek przedziału palety
+     */
+
+    static float seriesItemSize(float meanLength);
+
+    /**
+     * @brief applyPreparedGlyphs - przekazuje do wykresu strzałki przygotowane przez prepareGlyphs, pomijając wyniki nieaktualne
+     * @param prepared - wynik przygotowania strzałek
+     */
+
+    void applyPreparedGlyphs(PreparedGlyphs&& prepared);
+
+    /**
+     * @brief checkGlyphCount - sprawdza, czy liczba zbudowanych strzałek równa się liczbie widocznych próbek
+     */
+
+    void checkGlyphCount() const;
+
+    /**
+     * @brief clearGlyphs - usuwa z wykresu wszystkie strzałki niezależnie od użytego trybu renderowania
+     */
+
+    void clearGlyphs();
+
+    /**
+     * @brief destroyGlyphItems - usuwa z wykresu i z puli count ostatnich obiektów strzałek
+     */
+
+    void destroyGlyphItems(int count);
+
+    /**
+     * @brief clearGlyphSeries - usuwa z wykresu serie utworzone przez renderScatterSeries
+     */
+
+    void clearGlyphSeries();
+
+    /**
+     * @brief renderCustomItems - wyświetla strzałki jako osobne obiekty QCustom3DItem z puli m_glyphItems.
+     * Istniejące obiekty są używane ponownie i zmieniane są w nich tylko właściwości różne od wyświetlanych,
+     * tworzone lub usuwane są jedynie obiekty brakujące lub nadmiarowe.
+     * @param glyphs - strzałki do wyświetlenia
+     * @return liczba obiektów, które zmieniły wygląd lub zostały utworzone
+     */
+
+    int renderCustomItems(const QVector<Glyph>& glyphs);
+
+    /**
+     * @brief renderScatterSeries - wyświetla strzałki jako serie QScatter3DSeries, po jednej serii na przedział palety
+     * @param glyphs - strzałki do wyświetlenia
+     */
+
+    void renderScatterSeries(const QVector<Glyph>& glyphs);
+
+    /**
+     * @brief renderMergedMesh - łączy strzałki w jedną siatkę i wyświetla ją jako jeden obiekt m_meshItem
+     * @param glyphs - strzałki do wyświetlenia
+     */
+
+    void renderMergedMesh(const QVector<Glyph>& glyphs);
+
+    /**
+     * @brief clearMergedMesh - usuwa z wykresu połączoną siatkę strzałek i jej plik
+     */
+
+    void clearMergedMesh();
+
+    /**
+     * @brief m_grid - próbki pola z ostatniego generowania, zachowywane do ponownego stylizowania strzałek
+     */
+
+    FieldGrid m_grid;
+
+    /**
+     * @brief m_basis - baza pola z ostatniego generowania, pozwala zmieniać stałe a, b, c bez ponownego próbkowania
+     */
+
+    std::shared_ptr<const FieldBasis> m_basis;
+
+    /**
+     * @brief m_glyphs - strzałki wyświetlane na wykresie, zbudowane z m_grid
+     */
+
+    QVector<Glyph> m_glyphs;
+
+    /**
+     * @brief m_glyphItems - pula obiektów wykresu, zachowywana między generowaniami; i-ty obiekt wyświetla i-tą strzałkę
+     * z m_glyphs (tryb CustomItems)
+     */
+
+    QVector<QCustom3DItem*> m_glyphItems;
+
+    /**
+     * @brief m_itemGlyphs - strzałki, których położenie, obrót, skalowanie i kolor ustawiono w obiektach m_glyphItems
+     */
+
+    QVector<Glyph> m_itemGlyphs;
+
+    /**
+     * @brief m_itemPaletteBins - liczba przedziałów palety, z której pochodzą tekstury obiektów m_glyphItems
+     */
+
+    int m_itemPaletteBins = 0;
+
+    /**
+     * @brief m_itemMesh - siatka ustawiona w obiektach m_glyphItems
+     */
+
+    MeshId m_itemMesh = MeshId::Arrow;
+
+    /**
+     * @brief m_arrowDetail - poziom szczegółów strzałek wybrany dla liczby strzałek i przybliżenia kamery
+     */
+
+    ArrowDetail m_arrowDetail;
+
+    /**
+     * @brief m_glyphSeriesBins - przedział palety każdej serii z m_glyphSeries
+     */
+
+    QVector<int> m_glyphSeriesBins;
+
+    /**
+     * @brief m_meshItem - obiekt wyświetlający połączoną siatkę strzałek (tryb MergedMesh)
+     */
+
+    QCustom3DItem* m_meshItem = nullptr;
+
+    /**
+     * @brief m_meshDirectory - katalog tymczasowy na pliki OBJ połączonych siatek, usuwany razem z obiektem
+     */
+
+    QTemporaryDir m_meshDirectory;
+
+    /**
+     * @brief m_meshFile - plik OBJ wyświetlanej połączonej siatki
+     */
+
+    QString m_meshFile;
+
+    /**
+     * @brief m_meshFileCount - liczba zapisanych plików połączonych siatek, wyznacza nazwę kolejnego pliku
+     */
+
+    int m_meshFileCount = 0;
+
+    /**
+     * @brief m_subsetMeshFile - plik połączonej siatki podzbioru strzałek wyświetlanego w trakcie ruchu kamery
+     */
+
+    QString m_subsetMeshFile;
+
+    /**
+     * @brief m_subsetMeshStride - podział, dla którego zapisano m_subsetMeshFile, 0 - brak pliku
+     */
+
+    int m_subsetMeshStride = 0;
+
+    /**
+     * @brief m_targetFrameRate - docelowa liczba klatek na sekundę w trakcie ruchu kamery, 0 - tryb wyłączony
+     */
+
+    int m_targetFrameRate = 0;
+
+    /**
+     * @brief m_settleTimer - odmierza czas od ostatniej zmiany kamery, po którym kamera uznawana jest za zatrzymaną
+     */
+
+    QTimer m_settleTimer;
+
+    /**
+     * @brief m_interacting - czy kamera jest w ruchu i wyświetlany jest podzbiór strzałek
+     */
+
+    bool m_interacting = false;
+
+    /**
+     * @brief m_measureFpsBeforeInteraction - stan pomiaru klatek wykresu sprzed ruchu kamery
+     */
+
+    bool m_measureFpsBeforeInteraction = false;
+
+    /**
+     * @brief m_interactionStride - średnio co która strzałka jest wyświetlana w trakcie ruchu kamery, 0 - jeszcze
+     * nie wyznaczono dla bieżących strzałek
+     */
+
+    int m_interactionStride = 0;
+
+    /**
+     * @brief m_governor - pomiary kosztu regeneracji i klatki, na których opiera się ograniczanie siatki
+     */
+
+    FrameBudgetGovernor m_governor;
+
+    /**
+     * @brief m_governorEnabled - czy liczba podprzedziałów osi ograniczana jest budżetami czasu
+     */
+
+    bool m_governorEnabled = false;
+
+    /**
+     * @brief m_governorDecision - ostatnio wybrana liczba podprzedziałów osi
+     */
+
+    GovernorDecision m_governorDecision;
+
+    /**
+     * @brief m_progressiveRendering - czy duże siatki wyświetlane są stopniowo
+     */
+
+    bool m_progressiveRendering = true;
+
+    /**
+     * @brief m_chunkQueue - fragmenty strzałek przekazywane bez blokad z wątku roboczego do wątku GUI
+     */
+
+    std::shared_ptr<LockFreeQueue<GlyphChunk>> m_chunkQueue;
+
+    /**
+     * @brief m_chunkTimer - okresowo opróżnia m_chunkQueue, dopóki trwa stopniowe próbkowanie
      */
 
-    bool isAbovePlain(float x, float y, float z);
+    QTimer m_chunkTimer;
 
     /**
-     * @brief m_function - zmienna która przechowuje funkcje według której aktualnie wyznaczane są wektory
+     * @brief m_previewGlyphs - strzałki poziomów siatki odebrane dotąd z m_chunkQueue
      */
 
-    std::function<QVector3D(const QVector3D&&, float, float, float)> m_function;
+    QVector<Glyph> m_previewGlyphs;
+
+    /**
+     * @brief m_previewGeneration - numer zlecenia, z którego pochodzi m_previewGlyphs
+     */
+
+    quint64 m_previewGeneration = 0;
+
+    /**
+     * @brief m_previewing - czy na wykresie jest podgląd zamiast m_glyphs
+     */
+
+    bool m_previewing = false;
+
+    /**
+     * @brief m_regenerationClock - czas od ostatniego zlecenia generowania
+     */
+
+    QElapsedTimer m_regenerationClock;
+
+    /**
+     * @brief m_latestGeneration - numer najnowszego zlecenia generowania, współdzielony z wątkami roboczymi
+     */
+
+    std::shared_ptr<std::atomic<quint64>> m_latestGeneration;
+
+    /**
+     * @brief m_pool - pula wątków używana przez zlecenia generowania
+     */
+
+    std::shared_ptr<WorkStealingPool> m_pool;
+
+    /**
+     * @brief m_regenerationTimer - odmierza okres ciszy przed zaplanowaną regeneracją
+     */
+
+    QTimer m_regenerationTimer;
+
+    /**
+     * @brief m_dirty - grupy parametrów zmienione od ostatniej regeneracji
+     */
+
+    DirtyFlags m_dirty;
+
+    /**
+     * @brief m_pendingSince - czas od pierwszej zmiany, która nie została jeszcze uwzględniona
+     */
+
+    QElapsedTimer m_pendingSince;
+
+    /**
+     * @brief m_renderBackend - aktualnie używany sposób renderowania strzałek
+     */
+
+    RenderBackend m_renderBackend = RenderBackend::CustomItems;
+
+    /**
+     * @brief m_glyphSeries - serie utworzone przez renderScatterSeries, usuwane przy kolejnym generowaniu
+     */
+
+    QVector<QScatter3DSeries*> m_glyphSeries;
+
+    /**
+     * @brief m_palette - kolory i współdzielone tekstury przedziałów długości wektorów
+     */
+
+    ColorPalette m_palette;
+
+    /**
+     * @brief m_stats - liczniki ostatniego generowania strzałek
+     */
+
+    PipelineStats m_stats;
+
+    /**
+     * @brief m_fieldKind - pole według którego aktualnie wyznaczane są wektory
+     */
+
+    FieldKind m_fieldKind = FieldKind::Linear;
+
+    /**
+     * @brief m_customField - czy wektory wyznaczane są z wyrażeń podanych przez użytkownika
+     */
+
+    bool m_customField = false;
+
+    /**
+     * @brief m_fileField - czy wektory wyznaczane są z danych wczytanych z pliku (m_sampledField)
+     */
+
+    bool m_fileField = false;
+
+    /**
+     * @brief m_sampledField - pole wczytane z pliku
+     */
+
+    std::shared_ptr<const SampledField> m_sampledField;
+
+    /**
+     * @brief m_expressionSource - wyrażenia składowych P, Q, R pola użytkownika
+     */
+
+    QString m_expressionSource[3];
+
+    /**
+     * @brief m_expression - ostatnie poprawnie skompilowane pole użytkownika
+     */
+
+    std::shared_ptr<const FieldExpression> m_expression;
+
+    /**
+     * @brief m_nativeExpressions - czy pole użytkownika ma być kompilowane do kodu natywnego
+     */
+
+    bool m_nativeExpressions;
+
+    /**
+     * @brief m_native - m_expression skompilowane do kodu natywnego, nullptr - pole wyznacza maszyna wirtualna
+     */
+
+    std::shared_ptr<const NativeField> m_native;
+
+    /**
+     * @brief m_nativeCompileTimer - odmierza okres ciszy przed kompilacją wyrażenia do kodu natywnego
+     */
+
+    QTimer m_nativeCompileTimer;
+
+    /**
+     * @brief m_nativeCompilePool - jednowątkowa pula kompilacji; kompilator nie zajmuje wątków globalnej puli,
+     * w której przygotowywane są strzałki
+     */
+
+    QThreadPool m_nativeCompilePool;
+
+    /**
+     * @brief m_nativeCompiling - wyrażenie kompilowane w tej chwili, nullptr - żadna kompilacja nie trwa
+     */
+
+    std::shared_ptr<const FieldExpression> m_nativeCompiling;
+
+    /**
+     * @brief m_nativeCompilePending - czy po bieżącej kompilacji trzeba skompilować nowsze wyrażenie
+     */
+
+    bool m_nativeCompilePending = false;
 
     /**
      * @brief m_xRange - przedział zmienności X
@@ -279,9 +1032,36 @@ private:
 
     bool m_cutByPlain = false;
 
+    /**
+     * @brief m_validateGlyphCount - czy niezgodna liczba strzałek ma przerywać działanie programu
+     */
+
+    bool m_validateGlyphCount;
+
     /**
      * @brief m_arrowLength - aktualna długość wektorów
      */
 
     int m_arrowLength;
+
+    /**
+     * @brief m_exportResolution - indeks rozmiarów zapisywanych plików (setExportResolution)
+     */
+
+    int m_exportResolution = 0;
+
+    /**
+     * @brief m_exportQueue - kolejka zapisu wykresu do plików z kodowaniem w osobnych wątkach
+     */
+
+    ExportQueue m_exportQueue;
+
+    /**
+     * @brief m_exportingPoster - czy trwa zapis plakatu; zmiany kamery wykonywane przez PosterExporter nie
+     * zmieniają wtedy podzbioru ani siatki strzałek
+     */
+
+    bool m_exportingPoster = false;
 };
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(Scatter::DirtyFlags)
@@ -0,0 +1,113 @@
+#include "videostreamwriter.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QFileInfo>
+#include <QtCore/QIODevice>
+
+// współczynniki przejścia z RGB na pełny zakres YCbCr (BT.601, jak w JPEG) w arytmetyce stałoprzecinkowej 16.16
+constexpr int lumaRed = 19595;
+constexpr int lumaGreen = 38470;
+constexpr int lumaBlue = 7471;
+constexpr int blueDifferenceRed = -11059;
+constexpr int blueDifferenceGreen = -21709;
+constexpr int redDifferenceGreen = -27439;
+constexpr int redDifferenceBlue = -5329;
+constexpr int half = 32768;
+constexpr int chromaOffset = (128 << 16) + half;
+
+VideoStreamWriter::VideoStreamWriter(QIODevice *device)
+        : m_device(device) {
+}
+
+VideoFormat VideoStreamWriter::formatForFile(const QString &fileName, bool *ok) {
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    *ok = true;
+    if (suffix == QLatin1String("y4m")) {
+        return VideoFormat::Y4m;
+    }
+    if (suffix == QLatin1String("rgb") || suffix == QLatin1String("raw")) {
+        return VideoFormat::RawRgb;
+    }
+    *ok = false;
+    return VideoFormat::Y4m;
+}
+
+bool VideoStreamWriter::write(const char *data, qint64 size) {
+    if (m_device->write(data, size) != size) {
+        m_error = m_device->errorString();
+        return false;
+    }
+    m_bytes += size;
+    return true;
+}
+
+bool VideoStreamWriter::begin(VideoFormat format, int width, int height, int framesPerSecond) {
+    if (width <= 0 || height <= 0 || framesPerSecond <= 0) {
+        m_error = QStringLiteral("Niepoprawny rozmiar klatki %1×%2 lub liczba klatek na sekundę %3")
+                  .arg(width).arg(height).arg(framesPerSecond);
+        return false;
+    }
+    m_format = format;
+    m_width = width;
+    m_height = height;
+    m_frameCount = 0;
+    m_bytes = 0;
+    m_frame.resize(width * height * 3);
+    if (format != VideoFormat::Y4m) {
+        return true;
+    }
+    const QByteArray header = QStringLiteral("YUV4MPEG2 W%1 H%2 F%3:1 Ip A1:1 C444 XCOLORRANGE=FULL\n")
+                              .arg(width).arg(height).arg(framesPerSecond).toLatin1();
+    return write(header.constData(), header.size());
+}
+
+bool VideoStreamWriter::writeFrame(const QImage &frame) {
+    if (frame.size() != QSize(m_width, m_height)) {
+        m_error = QStringLiteral("Klatka %1×%2 ma inny rozmiar niż strumień %3×%4")
+                  .arg(frame.width()).arg(frame.height()).arg(m_width).arg(m_height);
+        return false;
+    }
+    const bool packed = frame.format() == QImage::Format_RGB32 || frame.format() == QImage::Format_ARGB32
+                        || frame.format() == QImage::Format_ARGB32_Premultiplied;
+    const QImage source = packed ? frame : frame.convertToFormat(QImage::Format_RGB32);
+
+    const int planeSize = m_width * m_height;
+    uchar *out = m_frame.data();
+    for (int y = 0; y < m_height; y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(source.constScanLine(y));
+        if (m_format == VideoFormat::RawRgb) {
+            uchar *rgb = out + y * m_width * 3;
+            for (int x = 0; x < m_width; x++) {
+                rgb[3 * x] = static_cast<uchar>(qRed(line[x]));
+                rgb[3 * x + 1] = static_cast<uchar>(qGreen(line[x]));
+                rgb[3 * x + 2] = static_cast<uchar>(qBlue(line[x]));
+            }
+            continue;
+        }
+        // Y4M przechowuje płaszczyzny Y, Cb i Cr jedna po drugiej
+        uchar *luma = out + y * m_width;
+        uchar *blue = luma + planeSize;
+        uchar *red = blue + planeSize;
+        for (int x = 0; x < m_width; x++) {
+            const int r = qRed(line[x]);
+            const int g = qGreen(line[x]);
+            const int b = qBlue(line[x]);
+            luma[x] = static_cast<uchar>((lumaRed * r + lumaGreen * g + lumaBlue * b + half) >> 16);
+            // współczynnik 0.5 przy własnej składowej to 1 << 15; dla czystego niebieskiego i czerwonego
+            // zaokrąglona różnica wynosi 256, więc wynik jest ograniczany do zakresu bajtu
+            blue[x] = static_cast<uchar>(qBound(0, (blueDifferenceRed * r + blueDifferenceGreen * g + (b << 15)
+                                                    + chromaOffset) >> 16, 255));
+            red[x] = static_cast<uchar>(qBound(0, ((r << 15) + redDifferenceGreen * g + redDifferenceBlue * b
+                                                   + chromaOffset) >> 16, 255));
+        }
+    }
+
+    static const char frameHeader[] = "FRAME\n";
+    if (m_format == VideoFormat::Y4m && !write(frameHeader, sizeof(frameHeader) - 1)) {
+        return false;
+    }
+    if (!write(reinterpret_cast<const char*>(m_frame.constData()), m_frame.size())) {
+        return false;
+    }
+    m_frameCount++;
+    return true;
+}
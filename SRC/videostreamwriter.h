@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+
+class QIODevice;
+
+/**
+ * @brief VideoFormat - format nieskompresowanego pliku wideo zapisywanego przez VideoStreamWriter
+ */
+
+enum class VideoFormat
+{
+    Y4m = 0,   ///< YUV4MPEG2 z pełnym zakresem YCbCr 4:4:4 (BT.601), czytany bezpośrednio przez ffmpeg i mpv
+    RawRgb = 1 ///< same piksele RGB24 bez nagłówka; rozmiar i liczbę klatek na sekundę trzeba podać odtwarzaczowi
+};
+
+/**
+ * @brief VideoStreamWriter - zapisuje kolejne klatki jako nieskompresowany strumień wideo. Każda klatka zapisywana
+ * jest od razu po przekazaniu, więc w pamięci jest tylko bufor jednej klatki, a plik można odtwarzać lub kodować
+ * (np. ffmpeg -i animacja.y4m) bez pośrednich plików PNG.
+ */
+
+class VideoStreamWriter
+{
+public:
+    /**
+     * @brief VideoStreamWriter - tworzy koder zapisujący do otwartego urządzenia
+     * @param device - urządzenie do zapisu; musi istnieć do zakończenia zapisu
+     */
+
+    explicit VideoStreamWriter(QIODevice *device);
+
+    /**
+     * @brief begin - zapisuje nagłówek strumienia (tylko Y4M)
+     * @param format - format pliku
+     * @param width, height - rozmiar klatek w pikselach
+     * @param framesPerSecond - liczba klatek na sekundę zapisywana w nagłówku Y4M
+     * @return false w przypadku błędu zapisu
+     */
+
+    bool begin(VideoFormat format, int width, int height, int framesPerSecond);
+
+    /**
+     * @brief writeFrame - zapisuje kolejną klatkę
+     * @param frame - obraz o rozmiarze podanym w begin
+     * @return false w przypadku błędu zapisu lub innego rozmiaru klatki
+     */
+
+    bool writeFrame(const QImage& frame);
+
+    /**
+     * @brief errorString - opis ostatniego błędu
+     */
+
+    QString errorString() const { return m_error; }
+
+    /**
+     * @brief frameCount - liczba zapisanych klatek
+     */
+
+    int frameCount() const { return m_frameCount; }
+
+    /**
+     * @brief bytesWritten - liczba bajtów zapisanych od wywołania begin
+     */
+
+    qint64 bytesWritten() const { return m_bytes; }
+
+    /**
+     * @brief formatForFile - format odpowiadający rozszerzeniu pliku (.y4m, .rgb lub .raw)
+     * @param ok - ustawiane na false, gdy rozszerzenie nie jest obsługiwane
+     */
+
+    static VideoFormat formatForFile(const QString& fileName, bool *ok);
+
+private:
+
+    /**
+     * @brief write - zapisuje dane i zapamiętuje opis błędu
+     */
+
+    bool write(const char *data, qint64 size);
+
+    QIODevice *m_device;
+    QString m_error;
+    VideoFormat m_format = VideoFormat::Y4m;
+    int m_width = 0;
+    int m_height = 0;
+    int m_frameCount = 0;
+    qint64 m_bytes = 0;
+
+    /**
+     * @brief m_frame - bufor jednej klatki w formacie pliku
+     */
+
+    QVector<uchar> m_frame;
+};
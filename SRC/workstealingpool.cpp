@@ -0,0 +1,122 @@
+#include "workstealingpool.h"
+
+WorkStealingPool::WorkStealingPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    // wątek wywołujący parallelFor pracuje razem z pulą, dlatego pula ma o jeden wątek mniej
+    const int workerCount = threadCount > 1 ? threadCount - 1 : 0;
+    for (int i = 0; i < workerCount; i++) {
+        m_queues.emplace_back(new Queue);
+    }
+    for (int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+    if (end <= begin) {
+        return;
+    }
+    grain = grain > 0 ? grain : 1;
+    const int chunkCount = (end - begin + grain - 1) / grain;
+    if (m_workers.empty() || chunkCount == 1) {
+        body(begin, end);
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->body = body;
+    job->remaining = chunkCount;
+
+    const int queueCount = static_cast<int>(m_queues.size());
+    const unsigned firstQueue = m_nextQueue.fetch_add(1);
+    for (int chunk = 0; chunk < chunkCount; chunk++) {
+        const int first = begin + chunk * grain;
+        const int last = first + grain < end ? first + grain : end;
+        Queue &queue = *m_queues[(firstQueue + chunk) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(Task{job, first, last});
+    }
+    m_pending += chunkCount;
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_all();
+
+    // wątek wywołujący pomaga w obliczeniach, dopóki są zadania do podebrania
+    Task task;
+    while (job->remaining > 0 && stealTask(-1, task)) {
+        runTask(task);
+    }
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->done.wait(lock, [&job]() { return job->remaining == 0; });
+}
+
+void WorkStealingPool::workerLoop(int index) {
+    Task task;
+    for (;;) {
+        if (popTask(index, task) || stealTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() { return m_stopping || m_pending > 0; });
+        if (m_stopping) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::popTask(int index, Task &task) {
+    Queue &queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    m_pending--;
+    return true;
+}
+
+bool WorkStealingPool::stealTask(int thief, Task &task) {
+    const int queueCount = static_cast<int>(m_queues.size());
+    for (int offset = 1; offset <= queueCount; offset++) {
+        const int victim = (thief + offset + queueCount) % queueCount;
+        if (victim == thief) {
+            continue;
+        }
+        Queue &queue = *m_queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        // podbieranie z przeciwnego końca niż właściciel kolejki
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        m_pending--;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::runTask(Task &task) {
+    task.job->body(task.first, task.last);
+    if (--task.job->remaining == 0) {
+        std::lock_guard<std::mutex> lock(task.job->mutex);
+        task.job->done.notify_all();
+    }
+    task.job.reset();
+}
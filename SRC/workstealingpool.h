@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief WorkStealingPool - pula wątków z osobną kolejką zadań dla każdego wątku. Wątek, któremu skończyły się
+ * zadania, podbiera je z końca kolejek pozostałych wątków, dzięki czemu nierówne porcje pracy (np. warstwy
+ * siatki o różnej liczbie odciętych węzłów) nie zostawiają bezczynnych rdzeni.
+ */
+
+class WorkStealingPool
+{
+public:
+    /**
+     * @brief WorkStealingPool - tworzy pulę i uruchamia wątki robocze
+     * @param threadCount - liczba wątków, 0 - tyle ile rdzeni procesora
+     */
+
+    explicit WorkStealingPool(int threadCount = 0);
+
+    /**
+     * @brief destruktor - czeka na zakończenie wątków roboczych
+     */
+
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * @brief threadCount - liczba wątków wykonujących zadania, łącznie z wątkiem wywołującym parallelFor
+     */
+
+    int threadCount() const { return static_cast<int>(m_workers.size()) + 1; }
+
+    /**
+     * @brief parallelFor - wykonuje body dla wszystkich indeksów z przedziału [begin, end), podzielonego na porcje
+     * po grain indeksów. Wątek wywołujący również wykonuje zadania i wraca dopiero po zakończeniu wszystkich porcji.
+     * Można wywoływać jednocześnie z wielu wątków.
+     * @param begin - pierwszy indeks
+     * @param end - indeks za ostatnim
+     * @param grain - liczba indeksów w jednej porcji
+     * @param body - funkcja wywoływana dla porcji [first, last)
+     */
+
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+private:
+    struct Job
+    {
+        std::function<void(int, int)> body;
+        std::atomic<int> remaining{0};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    struct Task
+    {
+        std::shared_ptr<Job> job;
+        int first;
+        int last;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(int index);
+
+    bool popTask(int index, Task& task);
+
+    bool stealTask(int thief, Task& task);
+
+    static void runTask(Task& task);
+
+    std::vector<std::thread> m_workers;
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+
+    std::mutex m_sleepMutex;
+
+    std::condition_variable m_wake;
+
+    std::atomic<int> m_pending{0};
+
+    std::atomic<bool> m_stopping{false};
+
+    std::atomic<unsigned> m_nextQueue{0};
+};